@@ -0,0 +1,45 @@
+#version 330
+layout( location = 0 ) in vec3 vert_modelSpace;
+layout( location = 1 ) in vec3 vert_color;
+// one per mass, the glyph is drawn around it
+layout( location = 2 ) in vec3 instance_worldSpace;
+
+uniform mat4 MVP;
+uniform mat4 M;
+uniform mat4 V;
+
+// matches what phong_gs.glsl hands to phong_fs.glsl, the glyph is flat so
+// its normal is known without a geometry shader
+out VertexData
+{
+	vec3 position_worldSpace;
+	vec3 normal_cameraSpace;
+	vec3 eyeDirection_cameraSpace;
+	vec3 lightDirection_cameraSpace;
+	vec3 color;
+} outVertex;
+
+void main()
+{
+	const vec3 light_worldSpace = vec3(10, 50, 50);
+	// glyphs lie in the xy plane
+	const vec3 norm_modelSpace = vec3(0, 0, 1);
+
+	vec4 vert = vec4( vert_modelSpace + instance_worldSpace, 1.0 );
+
+	gl_Position = MVP * vert;
+
+	outVertex.position_worldSpace = (M * vert).xyz;
+
+	vec3 vert_cameraSpace = (V * M * vert).xyz;
+	outVertex.eyeDirection_cameraSpace = -vert_cameraSpace;
+
+	vec3 light_cameraSpace = (V * vec4( light_worldSpace, 1 )).xyz;
+	outVertex.lightDirection_cameraSpace =
+		light_cameraSpace + outVertex.eyeDirection_cameraSpace;
+
+	// No scaling so OK, but use inverse-transpose of MV otherwise
+	outVertex.normal_cameraSpace = (V * M * vec4( norm_modelSpace, 0.0 )).xyz;
+
+	outVertex.color = vert_color;
+}
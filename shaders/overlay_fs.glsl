@@ -0,0 +1,10 @@
+#version 330 core
+
+uniform vec3 inputColor;
+
+out vec3 color;
+
+void main()
+{
+	color = inputColor;
+}
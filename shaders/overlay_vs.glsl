@@ -0,0 +1,12 @@
+#version 330
+layout( location = 0 ) in vec2 vert_pixel;
+
+uniform vec2 viewSize; // framebuffer pixels
+uniform vec2 offset;   // pixels, for the shadow
+
+void main()
+{
+	// pixels from the top left to normalized device coordinates
+	vec2 p = ( vert_pixel + offset ) / viewSize * 2.0 - 1.0;
+	gl_Position = vec4( p.x, -p.y, 0.0, 1.0 );
+}
@@ -0,0 +1,41 @@
+#version 330 core
+
+// one line per spring, its two masses
+layout( lines ) in;
+layout( line_strip, max_vertices = 2 ) out;
+
+// rest length of every spring, in the order of the index buffer
+uniform samplerBuffer restLengths;
+uniform bool colorByStrain;
+// strain drawn in full color
+uniform float strainScale;
+
+in vec3 position_worldSpace[];
+
+out vec3 interpolateColor;
+
+void main()
+{
+	vec3 color = vec3( 0.6, 0.6, 0.6 );
+
+	if( colorByStrain )
+	{
+		float rest = max( texelFetch( restLengths, gl_PrimitiveIDIn ).r, 1e-6 );
+		float len = length( position_worldSpace[1] - position_worldSpace[0] );
+		float strain = clamp( (len - rest) / (rest * strainScale), -1.0, 1.0 );
+
+		// blue compressed, white at rest, red stretched
+		color = strain > 0.0 ? mix( vec3( 1.0 ), vec3( 1.0, 0.0, 0.0 ), strain )
+			: mix( vec3( 1.0 ), vec3( 0.0, 0.0, 1.0 ), -strain );
+	}
+
+	gl_Position = gl_in[0].gl_Position;
+	interpolateColor = color;
+	EmitVertex();
+
+	gl_Position = gl_in[1].gl_Position;
+	interpolateColor = color;
+	EmitVertex();
+
+	EndPrimitive();
+}
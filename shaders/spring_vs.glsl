@@ -0,0 +1,13 @@
+#version 330
+// mass positions, shared with the mass glyph instances
+layout( location = 0 ) in vec3 vert_worldSpace;
+
+uniform mat4 MVP;
+
+out vec3 position_worldSpace;
+
+void main()
+{
+	gl_Position = MVP * vec4( vert_worldSpace, 1.0 );
+	position_worldSpace = vert_worldSpace;
+}
@@ -0,0 +1,94 @@
+//
+//  AttributeArray.h
+//
+//	One attribute array of a ParticleSystem. Normally a std::vector, but it
+//	can also point at memory owned by someone else (a mapped scene file) so
+//	a loaded scene is simulated in place without being copied. The first
+//	change of size copies external data into a vector of its own; writing
+//	elements through data() never does.
+
+#ifndef ATTRIBUTE_ARRAY_H
+#define ATTRIBUTE_ARRAY_H
+
+#include <vector>
+#include <cstddef>
+#include <utility>
+
+template <typename T> class AttributeArray {
+public:
+  AttributeArray() : m_external(nullptr), m_externalSize(0) {}
+  // Copies always own their data
+  AttributeArray(AttributeArray const &other)
+      : m_owned(other.begin(), other.end()), m_external(nullptr),
+        m_externalSize(0) {}
+  AttributeArray(AttributeArray &&other) = default;
+
+  AttributeArray &operator=(AttributeArray const &other) {
+    if (this != &other)
+      assign(std::vector<T>(other.begin(), other.end()));
+    return *this;
+  }
+  AttributeArray &operator=(AttributeArray &&other) = default;
+
+  size_t size() const { return m_external ? m_externalSize : m_owned.size(); }
+  bool empty() const { return size() == 0; }
+
+  T *data() { return m_external ? m_external : m_owned.data(); }
+  T const *data() const { return m_external ? m_external : m_owned.data(); }
+  T *begin() { return data(); }
+  T *end() { return data() + size(); }
+  T const *begin() const { return data(); }
+  T const *end() const { return data() + size(); }
+
+  T &operator[](size_t i) { return data()[i]; }
+  T const &operator[](size_t i) const { return data()[i]; }
+
+  void clear() {
+    m_owned.clear();
+    m_external = nullptr;
+    m_externalSize = 0;
+  }
+  void reserve(size_t count) {
+    detach();
+    m_owned.reserve(count);
+  }
+  void push_back(T const &value) {
+    detach();
+    m_owned.push_back(value);
+  }
+  template <typename... Args> void emplace_back(Args &&... args) {
+    detach();
+    m_owned.emplace_back(std::forward<Args>(args)...);
+  }
+
+  // Takes over the contents of values
+  void assign(std::vector<T> &&values) {
+    m_owned = std::move(values);
+    m_external = nullptr;
+    m_externalSize = 0;
+  }
+  // Uses count elements at data in place, the memory must outlive this
+  // array (or its next change of size)
+  void adopt(T *data, size_t count) {
+    m_owned.clear();
+    m_owned.shrink_to_fit();
+    m_external = count > 0 ? data : nullptr;
+    m_externalSize = count;
+  }
+  bool isExternal() const { return m_external != nullptr; }
+
+private:
+  void detach() {
+    if (m_external) {
+      m_owned.assign(m_external, m_external + m_externalSize);
+      m_external = nullptr;
+      m_externalSize = 0;
+    }
+  }
+
+  std::vector<T> m_owned;
+  T *m_external;
+  size_t m_externalSize;
+};
+
+#endif // ATTRIBUTE_ARRAY_H
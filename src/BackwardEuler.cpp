@@ -0,0 +1,294 @@
+#include "BackwardEuler.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+double dot(Vec3f const *a, Vec3f const *b, size_t count, ThreadPool &pool) {
+  return pool.parallelSum(count, [&](size_t begin, size_t end) {
+    double sum = 0;
+    for (size_t i = begin; i < end; ++i)
+      sum += a[i] * b[i];
+    return sum;
+  });
+}
+
+} // namespace
+
+// ======================== CONSTRUCTORS ============================//
+BackwardEulerSolver::BackwardEulerSolver()
+    : m_tolerance(1e-4f), m_maxIterations(100), m_lastIterations(0),
+      m_lastResidual(0), m_adjTopology(0), m_adjBuilt(false), m_h2(0),
+      m_keepWarmStart(false) {}
+// ==========================================================================//
+
+void BackwardEulerSolver::reset() {
+  m_adjBuilt = false;
+  m_dv.clear();
+  m_keepWarmStart = false;
+}
+
+void BackwardEulerSolver::setWarmStart(Vec3f const *dv, size_t count) {
+  m_dv.assign(dv, dv + count);
+  m_keepWarmStart = true;
+}
+
+void BackwardEulerSolver::step(ParticleSystem &system, float dt,
+                               ThreadPool &pool) {
+  size_t count = system.massCount();
+
+  if (!m_adjBuilt || m_adjTopology != system.topologyVersion()) {
+    buildAdjacency(system);
+    if (!m_keepWarmStart || m_dv.size() != count)
+      m_dv.assign(count, Vec3f());
+  }
+  m_keepWarmStart = false;
+
+  m_rhs.resize(count);
+  m_r.resize(count);
+  m_z.resize(count);
+  m_p.resize(count);
+  m_Ap.resize(count);
+  m_invDiag.resize(count);
+  m_massDiag.resize(count);
+
+  computeSpringTerms(system, dt, pool);
+  solve(pool);
+
+  Vec3f *pos = system.positions();
+  Vec3f *vel = system.velocities();
+  float const *invMass = system.inverseMasses();
+  Vec3f const *dv = m_dv.data();
+
+  pool.parallelFor(count, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      if (invMass[i] == 0.f)
+        continue;
+
+      vel[i] += dv[i];
+      pos[i] += vel[i] * dt;
+    }
+  });
+}
+
+// Counting sort of the spring ends by mass
+void BackwardEulerSolver::buildAdjacency(ParticleSystem const &system) {
+  size_t massCount = system.massCount();
+  size_t springCount = system.springCount();
+  ParticleSystem::SpringEnds const *ends = system.springEnds();
+
+  m_adjOffset.assign(massCount + 1, 0);
+  for (size_t s = 0; s < springCount; ++s) {
+    ++m_adjOffset[ends[s].a + 1];
+    ++m_adjOffset[ends[s].b + 1];
+  }
+  for (size_t i = 0; i < massCount; ++i)
+    m_adjOffset[i + 1] += m_adjOffset[i];
+
+  m_adjSpring.resize(2 * springCount);
+  m_adjOther.resize(2 * springCount);
+  std::vector<unsigned> fill(m_adjOffset.begin(), m_adjOffset.end() - 1);
+  for (size_t s = 0; s < springCount; ++s) {
+    unsigned a = ends[s].a;
+    unsigned b = ends[s].b;
+
+    m_adjSpring[fill[a]] = s;
+    m_adjOther[fill[a]++] = b;
+    m_adjSpring[fill[b]] = s;
+    m_adjOther[fill[b]++] = a;
+  }
+
+  m_springK.resize(springCount);
+  m_springF.resize(springCount);
+
+  m_adjTopology = system.topologyVersion();
+  m_adjBuilt = true;
+}
+
+// Per spring force and stiffness block, then per mass right hand side and
+// preconditioner. The transverse part of the block is clamped at 0 for
+// compressed springs, so the system stays positive definite.
+void BackwardEulerSolver::computeSpringTerms(ParticleSystem &system, float dt,
+                                             ThreadPool &pool) {
+  ParticleSystem::SpringEnds const *ends = system.springEnds();
+  float const *stiffness = system.stiffnesses();
+  float const *restLength = system.restLengths();
+  Vec3f const *pos = system.positions();
+  Vec3f const *vel = system.velocities();
+  float const *invMass = system.inverseMasses();
+  Vec3f *force = system.forces();
+
+  SymMat3 *springK = m_springK.data();
+  Vec3f *springF = m_springF.data();
+
+  pool.parallelFor(system.springCount(), [&](size_t begin, size_t end) {
+    for (size_t s = begin; s < end; ++s) {
+      float k = stiffness[s];
+      Vec3f d = pos[ends[s].b] - pos[ends[s].a];
+      float len = d.length();
+
+      if (len <= 0.f) {
+        springK[s] = SymMat3{k, 0, 0, k, 0, k};
+        springF[s] = Vec3f();
+        continue;
+      }
+
+      Vec3f n = d / len;
+      float t = std::max(1.f - restLength[s] / len, 0.f);
+      float kn = k * (1.f - t);
+      float kt = k * t;
+
+      springK[s] = SymMat3{kt + kn * n.x() * n.x(), kn * n.x() * n.y(),
+                           kn * n.x() * n.z(),      kt + kn * n.y() * n.y(),
+                           kn * n.y() * n.z(),      kt + kn * n.z() * n.z()};
+      springF[s] = n * (k * (len - restLength[s]));
+    }
+  });
+
+  float const h = dt;
+  float const h2 = dt * dt;
+  float const damping = system.damping();
+  Vec3f const gravity = system.gravity();
+  m_h2 = h2;
+
+  float *massDiag = m_massDiag.data();
+  Vec3f *rhs = m_rhs.data();
+  Vec3f *invDiag = m_invDiag.data();
+
+  pool.parallelFor(system.massCount(), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      Vec3f f;
+      Vec3f Kv; // -K v restricted to row i
+      Vec3f diag;
+
+      for (unsigned e = m_adjOffset[i]; e < m_adjOffset[i + 1]; ++e) {
+        unsigned s = m_adjSpring[e];
+        unsigned j = m_adjOther[e];
+        SymMat3 const &K = springK[s];
+
+        f += ends[s].a == i ? springF[s] : -springF[s];
+        Kv += K * (vel[i] - vel[j]);
+        diag += Vec3f(K.xx, K.yy, K.zz);
+      }
+      force[i] = f;
+
+      if (invMass[i] == 0.f) {
+        massDiag[i] = 0.f;
+        rhs[i] = Vec3f();
+        invDiag[i] = Vec3f();
+        continue;
+      }
+
+      float m = 1.f / invMass[i];
+      massDiag[i] = (1.f + h * damping) * m;
+      rhs[i] = (f - Kv * h + (gravity - vel[i] * damping) * m) * h;
+
+      diag = diag * h2 + Vec3f(massDiag[i], massDiag[i], massDiag[i]);
+      invDiag[i] = Vec3f(1.f / diag.x(), 1.f / diag.y(), 1.f / diag.z());
+    }
+  });
+}
+
+// out = A x, gathered per mass
+void BackwardEulerSolver::multiply(Vec3f const *x, Vec3f *out,
+                                   ThreadPool &pool) const {
+  SymMat3 const *springK = m_springK.data();
+  float const *massDiag = m_massDiag.data();
+  float const h2 = m_h2;
+
+  pool.parallelFor(m_massDiag.size(), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      if (massDiag[i] == 0.f) { // fixed
+        out[i] = Vec3f();
+        continue;
+      }
+
+      Vec3f sum;
+      for (unsigned e = m_adjOffset[i]; e < m_adjOffset[i + 1]; ++e)
+        sum += springK[m_adjSpring[e]] * (x[i] - x[m_adjOther[e]]);
+
+      out[i] = x[i] * massDiag[i] + sum * h2;
+    }
+  });
+}
+
+void BackwardEulerSolver::solve(ThreadPool &pool) {
+  size_t count = m_massDiag.size();
+  Vec3f *x = m_dv.data();
+  Vec3f *r = m_r.data();
+  Vec3f *z = m_z.data();
+  Vec3f *p = m_p.data();
+  Vec3f *Ap = m_Ap.data();
+  Vec3f const *b = m_rhs.data();
+  Vec3f const *invDiag = m_invDiag.data();
+  float const *massDiag = m_massDiag.data();
+
+  m_lastIterations = 0;
+  m_lastResidual = 0;
+
+  double bb = dot(b, b, count, pool);
+  if (bb == 0) {
+    std::fill(m_dv.begin(), m_dv.end(), Vec3f());
+    return;
+  }
+
+  // r = b - A x0, the warm start must not move fixed masses
+  pool.parallelFor(count, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      if (massDiag[i] == 0.f)
+        x[i] = Vec3f();
+    }
+  });
+  multiply(x, Ap, pool);
+
+  auto precondition = [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i)
+      z[i] = invDiag[i].componentwiseMult(r[i]);
+  };
+
+  pool.parallelFor(count, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      r[i] = b[i] - Ap[i];
+      z[i] = invDiag[i].componentwiseMult(r[i]);
+      p[i] = z[i];
+    }
+  });
+
+  double const threshold = double(m_tolerance) * m_tolerance * bb;
+  double rr = dot(r, r, count, pool);
+  double rz = dot(r, z, count, pool);
+
+  int iteration = 0;
+  while (rr > threshold && iteration < m_maxIterations) {
+    multiply(p, Ap, pool);
+
+    double pAp = dot(p, Ap, count, pool);
+    if (pAp <= 0)
+      break; // lost positive definiteness, keep what we have
+    float alpha = float(rz / pAp);
+
+    pool.parallelFor(count, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i) {
+        x[i] += p[i] * alpha;
+        r[i] -= Ap[i] * alpha;
+      }
+      precondition(begin, end);
+    });
+
+    rr = dot(r, r, count, pool);
+    double rzNew = dot(r, z, count, pool);
+    float beta = float(rzNew / rz);
+    rz = rzNew;
+
+    pool.parallelFor(count, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i)
+        p[i] = z[i] + p[i] * beta;
+    });
+
+    ++iteration;
+  }
+
+  m_lastIterations = iteration;
+  m_lastResidual = float(std::sqrt(rr / bb));
+}
@@ -0,0 +1,102 @@
+//
+//  BackwardEuler.h
+//
+//	Implicit (backward) Euler step for stiff spring systems.
+//
+//	Each step solves the spring forces linearized around the current state
+//
+//	  ((1 + h c) M - h^2 K) dv = h (f + h K v + M g - c M v)
+//	  v += dv,  x += h v
+//
+//	with K the spring force Jacobian, c the drag and h the time step. The
+//	system is never assembled: every spring keeps its 3x3 stiffness block
+//	and A * x is gathered per mass through the mass -> spring adjacency, so
+//	the product runs in parallel without write conflicts. It is solved with
+//	conjugate gradient, Jacobi preconditioned and warm started from the dv
+//	of the previous step. Fixed masses are filtered out of the solve.
+
+#ifndef BACKWARD_EULER_H
+#define BACKWARD_EULER_H
+
+#include <vector>
+
+#include "ParticleSystem.h"
+#include "ThreadPool.h"
+
+class BackwardEulerSolver {
+public:
+  // Symmetric 3x3 block
+  struct SymMat3 {
+    float xx, xy, xz, yy, yz, zz;
+
+    Vec3f operator*(Vec3f const &v) const {
+      return Vec3f(xx * v.x() + xy * v.y() + xz * v.z(),
+                   xy * v.x() + yy * v.y() + yz * v.z(),
+                   xz * v.x() + yz * v.y() + zz * v.z());
+    }
+  };
+
+public:
+  BackwardEulerSolver();
+
+  void step(ParticleSystem &system, float dt, ThreadPool &pool);
+
+  // Stop once |r| <= tolerance * |b|
+  float tolerance() const { return m_tolerance; }
+  void setTolerance(float tolerance) { m_tolerance = tolerance; }
+  int maxIterations() const { return m_maxIterations; }
+  void setMaxIterations(int iterations) { m_maxIterations = iterations; }
+
+  // Result of the last solve
+  int lastIterations() const { return m_lastIterations; }
+  float lastResidual() const { return m_lastResidual; }
+
+  // Velocity change of the last step, the next solve starts from it
+  std::vector<Vec3f> &velocityChange() { return m_dv; }
+  std::vector<Vec3f> const &velocityChange() const { return m_dv; }
+  // Forget the warm start and the adjacency
+  void reset();
+  // Starts the next solve from count velocity changes (of a checkpoint),
+  // if the system then stepped has count masses
+  void setWarmStart(Vec3f const *dv, size_t count);
+
+private:
+  void buildAdjacency(ParticleSystem const &system);
+  void computeSpringTerms(ParticleSystem &system, float dt, ThreadPool &pool);
+  void multiply(Vec3f const *x, Vec3f *out, ThreadPool &pool) const;
+  void solve(ThreadPool &pool);
+
+private:
+  float m_tolerance;
+  int m_maxIterations;
+  int m_lastIterations;
+  float m_lastResidual;
+
+  // mass -> springs, m_adjOffset[i] .. m_adjOffset[i + 1] index the springs
+  // of mass i and the mass on their other end
+  unsigned m_adjTopology;
+  bool m_adjBuilt;
+  std::vector<unsigned> m_adjOffset;
+  std::vector<unsigned> m_adjSpring;
+  std::vector<unsigned> m_adjOther;
+
+  // per spring: stiffness block (-dfa/dxa) and force on its a end
+  std::vector<SymMat3> m_springK;
+  std::vector<Vec3f> m_springF;
+
+  // per mass: (1 + h c) m, 0 for fixed masses
+  std::vector<float> m_massDiag;
+  float m_h2;
+
+  // CG vectors
+  std::vector<Vec3f> m_dv;
+  bool m_keepWarmStart; // m_dv was set for the next adjacency
+  std::vector<Vec3f> m_rhs;
+  std::vector<Vec3f> m_r;
+  std::vector<Vec3f> m_z;
+  std::vector<Vec3f> m_p;
+  std::vector<Vec3f> m_Ap;
+  std::vector<Vec3f> m_invDiag;
+};
+
+#endif // BACKWARD_EULER_H
@@ -0,0 +1,222 @@
+#include "Checkpoint.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+
+#include "MappedFile.h"
+#include "SceneFile.h"
+
+static_assert(sizeof(CheckpointState) == 128, "checkpoint state layout");
+
+namespace {
+
+template <typename T>
+void copyArray(std::vector<T> &to, T const *from, size_t count) {
+  // keeps the capacity of the last checkpoint, so only the copy is left
+  to.assign(from, from + count);
+}
+
+} // namespace
+
+// ======================== CONSTRUCTORS ============================//
+CheckpointWriter::CheckpointWriter()
+    : m_skipped(0), m_written(0), m_failed(false), m_closing(false) {
+  m_free.push_back(&m_buffers[0]);
+  m_free.push_back(&m_buffers[1]);
+  m_thread = std::thread(&CheckpointWriter::run, this);
+}
+
+CheckpointWriter::~CheckpointWriter() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_closing = true;
+  }
+  m_wake.notify_all();
+  m_thread.join();
+}
+// ==========================================================================//
+
+bool CheckpointWriter::save(std::string const &path,
+                            Simulation const &simulation,
+                            SimClock const *clock) {
+  Buffer *buffer;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_free.empty()) {
+      ++m_skipped;
+      return false;
+    }
+    buffer = m_free.back();
+    m_free.pop_back();
+  }
+
+  ParticleSystem const &system = simulation.system();
+  size_t const massCount = system.massCount();
+  size_t const springCount = system.springCount();
+  buffer->path = path;
+  buffer->gravity = system.gravity();
+  buffer->damping = system.damping();
+  copyArray(buffer->positions, system.positions(), massCount);
+  copyArray(buffer->velocities, system.velocities(), massCount);
+  copyArray(buffer->inverseMasses, system.inverseMasses(), massCount);
+  copyArray(buffer->springEnds, system.springEnds(), springCount);
+  copyArray(buffer->stiffnesses, system.stiffnesses(), springCount);
+  copyArray(buffer->restLengths, system.restLengths(), springCount);
+  copyArray(buffer->forces, system.forces(), massCount);
+  std::vector<Vec3f> const &dv =
+      simulation.implicitSolver().velocityChange();
+  copyArray(buffer->warmStart, dv.data(), dv.size());
+
+  CheckpointState &state = buffer->state;
+  std::memset(&state, 0, sizeof(state));
+  state.time = simulation.time();
+  state.steps = simulation.stepCount();
+  state.integrator = uint32_t(simulation.integrator());
+  state.forcesValid = simulation.forcesValid();
+  if (clock) {
+    state.hasClock = 1;
+    state.clockStepSize = clock->stepSize();
+    state.clockAccumulator = clock->accumulator();
+    state.clockTime = clock->time();
+    state.clockDropped = clock->droppedTime();
+  }
+  StepController::State control = simulation.stepControl().state();
+  state.stepSize = control.stepSize;
+  state.stepsSinceCheck = control.stepsSinceCheck;
+  state.strainRate = control.strainRate;
+  state.haveEnergy = control.haveEnergy;
+  state.energy = control.energy;
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_queue.push_back(buffer);
+  }
+  m_wake.notify_all();
+  return true;
+}
+
+bool CheckpointWriter::wait() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_wake.wait(lock, [&]() { return m_free.size() == 2; });
+  bool ok = !m_failed;
+  m_failed = false;
+  return ok;
+}
+
+void CheckpointWriter::run() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  for (;;) {
+    m_wake.wait(lock, [&]() { return m_closing || !m_queue.empty(); });
+    if (m_queue.empty())
+      return;
+    Buffer *buffer = m_queue.front();
+    m_queue.pop_front();
+
+    lock.unlock();
+    bool ok = write(*buffer);
+    lock.lock();
+
+    if (ok)
+      ++m_written;
+    else
+      m_failed = true;
+    m_free.push_back(buffer);
+    m_wake.notify_all();
+  }
+}
+
+bool CheckpointWriter::write(Buffer const &buffer) {
+  std::vector<SceneFileArray> arrays = {
+      {SceneSection::Positions, sizeof(Vec3f), buffer.positions.size(),
+       buffer.positions.data()},
+      {SceneSection::Velocities, sizeof(Vec3f), buffer.velocities.size(),
+       buffer.velocities.data()},
+      {SceneSection::InverseMasses, sizeof(float),
+       buffer.inverseMasses.size(), buffer.inverseMasses.data()},
+      {SceneSection::SpringEnds, sizeof(ParticleSystem::SpringEnds),
+       buffer.springEnds.size(), buffer.springEnds.data()},
+      {SceneSection::Stiffnesses, sizeof(float), buffer.stiffnesses.size(),
+       buffer.stiffnesses.data()},
+      {SceneSection::RestLengths, sizeof(float), buffer.restLengths.size(),
+       buffer.restLengths.data()},
+      {SceneSection::Forces, sizeof(Vec3f), buffer.forces.size(),
+       buffer.forces.data()},
+      {SceneSection::WarmStart, sizeof(Vec3f), buffer.warmStart.size(),
+       buffer.warmStart.data()},
+      {SceneSection::SimulationState, sizeof(CheckpointState), 1,
+       &buffer.state},
+  };
+
+  std::string temporary = buffer.path + ".tmp";
+  if (!writeSceneFile(temporary, buffer.gravity, buffer.damping, arrays))
+    return false;
+  if (std::rename(temporary.c_str(), buffer.path.c_str()) != 0) {
+    std::cerr << "Could Not Rename " << temporary << " to " << buffer.path
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool loadCheckpoint(std::string const &path, Simulation &simulation,
+                    SimClock *clock) {
+  std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+  if (!file->open(path) || !checkSceneFile(*file, path))
+    return false;
+
+  uint64_t count = 0;
+  CheckpointState const *state = static_cast<CheckpointState const *>(
+      findSceneSection(*file, SceneSection::SimulationState,
+                       sizeof(CheckpointState), count, path));
+  if (!state || count != 1 ||
+      state->integrator > uint32_t(IntegratorType::MultiRate)) {
+    std::cerr << path << " is not a checkpoint" << std::endl;
+    return false;
+  }
+
+  // everything is checked before anything is replaced, so a broken
+  // checkpoint leaves the simulation as it was
+  uint64_t massCount = 0, forceCount = 0, warmStartCount = 0;
+  Vec3f const *positions = static_cast<Vec3f const *>(findSceneSection(
+      *file, SceneSection::Positions, sizeof(Vec3f), massCount, path));
+  Vec3f const *forces = static_cast<Vec3f const *>(findSceneSection(
+      *file, SceneSection::Forces, sizeof(Vec3f), forceCount, path));
+  Vec3f const *warmStart = static_cast<Vec3f const *>(findSceneSection(
+      *file, SceneSection::WarmStart, sizeof(Vec3f), warmStartCount, path));
+  if (!positions || !forces || forceCount != massCount || !warmStart ||
+      (warmStartCount != 0 && warmStartCount != massCount)) {
+    std::cerr << "Broken checkpoint " << path << std::endl;
+    return false;
+  }
+
+  // checks the scene sections, and replaces the arrays only if they pass
+  ParticleSystem &system = simulation.system();
+  if (!loadSceneFile(file, path, system))
+    return false;
+
+  std::copy(forces, forces + forceCount, system.forces());
+  simulation.implicitSolver().setWarmStart(warmStart, warmStartCount);
+
+  simulation.setIntegrator(IntegratorType(state->integrator));
+  simulation.invalidateForces();
+  simulation.restore(state->time, state->steps, state->forcesValid != 0);
+
+  StepController::State control;
+  control.stepSize = state->stepSize;
+  control.stepsSinceCheck = state->stepsSinceCheck;
+  control.strainRate = state->strainRate;
+  control.haveEnergy = state->haveEnergy != 0;
+  control.energy = state->energy;
+  simulation.stepControl().setState(control);
+
+  if (clock && state->hasClock) {
+    if (state->clockStepSize > 0.f)
+      clock->setStepSize(state->clockStepSize);
+    clock->restore(state->clockAccumulator, state->clockTime,
+                   state->clockDropped);
+  }
+  return true;
+}
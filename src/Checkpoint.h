@@ -0,0 +1,117 @@
+//
+//  Checkpoint.h
+//
+//	Snapshots of everything a run needs to carry on where it was: the mass
+//	and spring arrays, the forces of the last step, the warm start of the
+//	implicit solver and the progress of the simulation, its step controller
+//	and clock. Stepping on from a restored checkpoint gives the same states
+//	bit for bit as stepping on from where it was taken.
+//
+//	A checkpoint is a scene file (see SceneFile.h) with three more sections,
+//	so it loads as a scene too. Restoring maps the file and adopts its
+//	arrays like loadSceneFile() does, only the forces and the warm start
+//	are copied.
+//
+//	Saving is double buffered: save() copies the arrays into one of two
+//	buffers and returns, a thread of its own writes the buffer out. The
+//	stepping thread only pays for the copy. If both buffers are still being
+//	written the checkpoint is skipped. Files are written next to path and
+//	renamed over it once complete, so a crash while writing leaves the last
+//	checkpoint intact and a file mapped by a restore is never overwritten.
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ParticleSystem.h"
+#include "SimClock.h"
+#include "Simulation.h"
+
+// The SimulationState section, one element
+struct CheckpointState {
+  double time; // Simulation
+  uint64_t steps;
+  uint32_t integrator; // IntegratorType
+  uint32_t forcesValid;
+  uint32_t hasClock; // the clock fields are set
+  float clockStepSize;
+  double clockAccumulator;
+  double clockTime;
+  double clockDropped;
+  float stepSize; // StepController::State
+  int32_t stepsSinceCheck;
+  float strainRate;
+  uint32_t haveEnergy;
+  double energy;
+  uint8_t reserved[48];
+};
+
+class CheckpointWriter {
+public:
+  CheckpointWriter();
+  // Waits for the checkpoints still being written
+  ~CheckpointWriter();
+
+  CheckpointWriter(CheckpointWriter const &) = delete;
+  CheckpointWriter &operator=(CheckpointWriter const &) = delete;
+
+  // Copies the state of simulation, and of clock if given, to be written
+  // to path. Returns false, copying nothing, if both buffers are busy.
+  bool save(std::string const &path, Simulation const &simulation,
+            SimClock const *clock = nullptr);
+  // Waits until everything saved is written, returns false if anything
+  // could not be (which was printed to std::cerr)
+  bool wait();
+
+  // Checkpoints written, as of the last wait(), and skipped
+  unsigned long writtenCount() const { return m_written; }
+  unsigned long skippedCount() const { return m_skipped; }
+
+private:
+  struct Buffer {
+    std::string path;
+    Vec3f gravity;
+    float damping;
+    std::vector<Vec3f> positions;
+    std::vector<Vec3f> velocities;
+    std::vector<float> inverseMasses;
+    std::vector<ParticleSystem::SpringEnds> springEnds;
+    std::vector<float> stiffnesses;
+    std::vector<float> restLengths;
+    std::vector<Vec3f> forces;
+    std::vector<Vec3f> warmStart;
+    CheckpointState state;
+  };
+
+  void run();
+  bool write(Buffer const &buffer);
+
+private:
+  Buffer m_buffers[2];
+  unsigned long m_skipped;
+
+  std::mutex m_mutex;
+  std::condition_variable m_wake;
+  std::deque<Buffer *> m_queue;
+  std::vector<Buffer *> m_free;
+  unsigned long m_written;
+  bool m_failed;
+  bool m_closing;
+  std::thread m_thread;
+};
+
+// Restores simulation, its system and the clock if given, from the
+// checkpoint at path. Everything set up outside of the checkpoint
+// (threads, solver settings, obstacles) stays as it is. Prints what went
+// wrong to std::cerr and returns false on failure.
+bool loadCheckpoint(std::string const &path, Simulation &simulation,
+                    SimClock *clock = nullptr);
+
+#endif // CHECKPOINT_H
@@ -0,0 +1,411 @@
+#include "CommandLine.h"
+
+#include <cstdlib>
+#include <cerrno>
+
+#include "ImageSequence.h"
+#include "Scenes.h"
+#include "ThreadPool.h"
+
+SimOptions::SimOptions()
+    : help(false), headless(false), scene("spring"), steps(1000),
+      dt(0.001f), adaptive(false), minDt(1e-6f), maxDt(1.f / 60.f),
+      strainPerStep(0.01f), energyTolerance(0.01f),
+      integrator(IntegratorType::SymplecticEuler),
+      cgTolerance(1e-4f), cgIterations(100), xpbdIterations(10),
+      collisionRadius(0.f), ground(false), groundHeight(0.f),
+      obstacleThickness(0.05f), friction(0.f),
+      maxSubsteps(64), overlay(false), recordFps(60.f), recordQuantum(1e-4f),
+      checkpointEvery(0), offscreenFrames(300), offscreenWidth(800),
+      offscreenHeight(600), offscreenFps(60.f),
+      threads(ThreadPool::hardwareThreads()),
+      simd(supportedSimdLevel()) {}
+
+namespace {
+
+bool parseFloat(std::string const &value, float &out) {
+  char *end = nullptr;
+  errno = 0;
+  float f = std::strtof(value.c_str(), &end);
+  if (value.empty() || *end != '\0' || errno != 0)
+    return false;
+  out = f;
+  return true;
+}
+
+bool parseUnsigned(std::string const &value, unsigned long &out) {
+  char *end = nullptr;
+  errno = 0;
+  unsigned long u = std::strtoul(value.c_str(), &end, 10);
+  if (value.empty() || value[0] == '-' || *end != '\0' || errno != 0)
+    return false;
+  out = u;
+  return true;
+}
+
+// WIDTH[xHEIGHT[xDEPTH]], missing sizes are left at 0 (scene default)
+bool parseSize(std::string const &value, SceneParams &params) {
+  int *sizes[] = {&params.width, &params.height, &params.depth};
+  int parsed[] = {0, 0, 0};
+
+  size_t begin = 0;
+  for (int axis = 0; axis < 3; ++axis) {
+    size_t end = value.find('x', begin);
+    unsigned long u = 0;
+    if (!parseUnsigned(value.substr(begin, end - begin), u) || u == 0 ||
+        u > 1000000000ul)
+      return false;
+    parsed[axis] = int(u);
+    if (end == std::string::npos)
+      break;
+    if (axis == 2)
+      return false;
+    begin = end + 1;
+  }
+
+  for (int axis = 0; axis < 3; ++axis)
+    *sizes[axis] = parsed[axis];
+  return true;
+}
+
+// WIDTHxHEIGHT of an image
+bool parseResolution(std::string const &value, int &width, int &height) {
+  size_t x = value.find('x');
+  unsigned long w = 0, h = 0;
+  if (x == std::string::npos || !parseUnsigned(value.substr(0, x), w) ||
+      !parseUnsigned(value.substr(x + 1), h) || w == 0 || h == 0 ||
+      w > 16384 || h > 16384)
+    return false;
+  width = int(w);
+  height = int(h);
+  return true;
+}
+
+// X,Y,Z,RADIUS
+bool parseSphere(std::string const &value, SphereObstacle &sphere) {
+  float parsed[4];
+  size_t begin = 0;
+  for (int k = 0; k < 4; ++k) {
+    size_t end = value.find(',', begin);
+    if ((end == std::string::npos) != (k == 3) ||
+        !parseFloat(value.substr(begin, end - begin), parsed[k]))
+      return false;
+    begin = end + 1;
+  }
+  if (!(parsed[3] > 0.f))
+    return false;
+
+  sphere.center = Vec3f(parsed[0], parsed[1], parsed[2]);
+  sphere.radius = parsed[3];
+  return true;
+}
+
+bool isFlag(std::string const &name) {
+  return name == "help" || name == "headless" || name == "overlay" ||
+         name == "adaptive";
+}
+
+} // namespace
+
+bool parseCommandLine(int argc, char **argv, SimOptions &options) {
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg.compare(0, 2, "--") != 0) {
+      std::cerr << "Unexpected argument " << arg << std::endl;
+      return false;
+    }
+
+    std::string name = arg.substr(2);
+    std::string value;
+    size_t eq = name.find('=');
+    if (eq != std::string::npos) {
+      value = name.substr(eq + 1);
+      name = name.substr(0, eq);
+    } else if (!isFlag(name)) {
+      if (i + 1 >= argc) {
+        std::cerr << "Missing value for --" << name << std::endl;
+        return false;
+      }
+      value = argv[++i];
+    }
+
+    bool ok = true;
+    unsigned long u = 0;
+    if (name == "help") {
+      options.help = true;
+    } else if (name == "headless") {
+      options.headless = true;
+    } else if (name == "scene") {
+      options.scene = value;
+    } else if (name == "scene-file") {
+      options.sceneFile = value;
+      ok = !value.empty();
+    } else if (name == "save-scene") {
+      options.saveScene = value;
+      ok = !value.empty();
+    } else if (name == "size") {
+      ok = parseSize(value, options.sceneParams);
+    } else if (name == "spacing") {
+      ok = parseFloat(value, options.sceneParams.spacing) &&
+           options.sceneParams.spacing > 0.f;
+    } else if (name == "mass") {
+      ok = parseFloat(value, options.sceneParams.mass) &&
+           options.sceneParams.mass > 0.f;
+    } else if (name == "stiffness") {
+      ok = parseFloat(value, options.sceneParams.stiffness) &&
+           options.sceneParams.stiffness > 0.f;
+    } else if (name == "damping") {
+      ok = parseFloat(value, options.sceneParams.damping) &&
+           options.sceneParams.damping >= 0.f;
+    } else if (name == "steps") {
+      ok = parseUnsigned(value, options.steps);
+    } else if (name == "dt") {
+      ok = parseFloat(value, options.dt) && options.dt > 0.f;
+    } else if (name == "adaptive") {
+      options.adaptive = true;
+    } else if (name == "min-dt") {
+      ok = parseFloat(value, options.minDt) && options.minDt > 0.f;
+    } else if (name == "max-dt") {
+      ok = parseFloat(value, options.maxDt) && options.maxDt > 0.f;
+    } else if (name == "strain-per-step") {
+      ok = parseFloat(value, options.strainPerStep) &&
+           options.strainPerStep > 0.f;
+    } else if (name == "energy-tolerance") {
+      ok = parseFloat(value, options.energyTolerance) &&
+           options.energyTolerance > 0.f;
+    } else if (name == "integrator") {
+      ok = parseIntegratorType(value, options.integrator);
+    } else if (name == "cg-tolerance") {
+      ok = parseFloat(value, options.cgTolerance) && options.cgTolerance > 0.f;
+    } else if (name == "cg-iterations") {
+      ok = parseUnsigned(value, u) && u > 0;
+      options.cgIterations = int(u);
+    } else if (name == "xpbd-iterations") {
+      ok = parseUnsigned(value, u) && u > 0;
+      options.xpbdIterations = int(u);
+    } else if (name == "collision-radius") {
+      ok = parseFloat(value, options.collisionRadius) &&
+           options.collisionRadius >= 0.f;
+    } else if (name == "ground") {
+      options.ground = parseFloat(value, options.groundHeight);
+      ok = options.ground;
+    } else if (name == "sphere") {
+      SphereObstacle sphere;
+      ok = parseSphere(value, sphere);
+      options.spheres.push_back(sphere);
+    } else if (name == "obstacle") {
+      options.obstacleFiles.push_back(value);
+      ok = !value.empty();
+    } else if (name == "obstacle-thickness") {
+      ok = parseFloat(value, options.obstacleThickness) &&
+           options.obstacleThickness > 0.f;
+    } else if (name == "friction") {
+      ok = parseFloat(value, options.friction) && options.friction >= 0.f;
+    } else if (name == "max-substeps") {
+      ok = parseUnsigned(value, u) && u > 0;
+      options.maxSubsteps = int(u);
+    } else if (name == "overlay") {
+      options.overlay = true;
+    } else if (name == "profile-csv") {
+      options.profileCsv = value;
+      ok = !value.empty();
+    } else if (name == "profile-json") {
+      options.profileJson = value;
+      ok = !value.empty();
+    } else if (name == "record") {
+      options.recordFile = value;
+      ok = !value.empty();
+    } else if (name == "record-fps") {
+      ok = parseFloat(value, options.recordFps) && options.recordFps >= 0.f;
+    } else if (name == "record-quantum") {
+      ok = parseFloat(value, options.recordQuantum) &&
+           options.recordQuantum > 0.f;
+    } else if (name == "play") {
+      options.playFile = value;
+      ok = !value.empty();
+    } else if (name == "checkpoint") {
+      options.checkpointFile = value;
+      ok = !value.empty();
+    } else if (name == "checkpoint-every") {
+      ok = parseUnsigned(value, options.checkpointEvery);
+    } else if (name == "restore") {
+      options.restoreFile = value;
+      ok = !value.empty();
+    } else if (name == "offscreen") {
+      options.offscreenPattern = value;
+      std::string file;
+      ok = imageFileName(value, 0, file);
+    } else if (name == "offscreen-frames") {
+      ok = parseUnsigned(value, options.offscreenFrames) &&
+           options.offscreenFrames > 0;
+    } else if (name == "offscreen-size") {
+      ok = parseResolution(value, options.offscreenWidth,
+                           options.offscreenHeight);
+    } else if (name == "offscreen-fps") {
+      ok = parseFloat(value, options.offscreenFps) &&
+           options.offscreenFps > 0.f;
+    } else if (name == "simd") {
+      bool isAuto = false;
+      ok = parseSimdLevel(value, options.simd, isAuto);
+    } else if (name == "threads") {
+      ok = parseUnsigned(value, u) && u > 0;
+      options.threads = int(u);
+    } else {
+      std::cerr << "Unknown option --" << name << std::endl;
+      return false;
+    }
+
+    if (!ok) {
+      std::cerr << "Bad value '" << value << "' for --" << name << std::endl;
+      return false;
+    }
+  }
+
+  // what --size multiplies out to depends on the scene, given in any order
+  double masses = 0, springs = 0;
+  if (options.sceneFile.empty() &&
+      sceneCounts(options.scene, options.sceneParams, masses, springs) &&
+      !sceneFits(masses, springs)) {
+    std::cerr << "--size makes the " << options.scene << " scene " << masses
+              << " masses and " << springs << " springs, at most "
+              << MAX_SCENE_COUNT << " of each" << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+void printUsage(std::ostream &out, char const *program) {
+  SimOptions defaults;
+
+  out << "Usage: " << program << " [options]\n"
+      << "  --headless       step the simulation without a window and report "
+         "throughput\n"
+      << "  --scene NAME     initial scene (default " << defaults.scene
+      << "), one of:";
+  for (auto const &name : sceneNames())
+    out << " " << name;
+  out << "\n"
+      << "  --scene-file PATH load a binary scene file instead of --scene\n"
+      << "  --save-scene PATH headless, save the initial scene as a binary "
+         "scene file\n"
+      << "  --size WxHxD     masses along each axis of the cloth, chain and "
+         "jelly scenes,\n"
+         "                   missing or 0 sizes use the scene default\n"
+      << "  --spacing X      rest distance between neighbouring masses "
+         "(default "
+      << defaults.sceneParams.spacing << ")\n"
+      << "  --mass X         kg per generated mass (default "
+      << defaults.sceneParams.mass << ")\n"
+      << "  --stiffness X    of generated springs (default "
+      << defaults.sceneParams.stiffness << ")\n"
+      << "  --damping X      linear drag of generated scenes (default "
+      << defaults.sceneParams.damping << ")\n"
+      << "  --steps N        headless steps to run (default " << defaults.steps
+      << ")\n"
+      << "  --dt SECONDS     simulation time step (default " << defaults.dt
+      << ")\n"
+      << "  --adaptive       pick every step's dt from stiffness, strain rate "
+         "and energy,\n"
+         "                   starting at --dt, headless runs --steps * --dt "
+         "seconds\n"
+      << "  --min-dt SECONDS smallest adaptive step (default "
+      << defaults.minDt << ")\n"
+      << "  --max-dt SECONDS largest adaptive step (default " << defaults.maxDt
+      << ")\n"
+      << "  --strain-per-step X most any spring's strain may change in an "
+         "adaptive step (default "
+      << defaults.strainPerStep << ")\n"
+      << "  --energy-tolerance X energy gain, of the kinetic and spring "
+         "energy, that halves\n"
+         "                   the adaptive step (default "
+      << defaults.energyTolerance << ")\n"
+      << "  --integrator NAME time integration (default "
+      << integratorName(defaults.integrator) << "), one of: "
+      << integratorNames() << "\n"
+      << "  --cg-tolerance X relative residual the implicit solve stops at "
+         "(default "
+      << defaults.cgTolerance << ")\n"
+      << "  --cg-iterations N most conjugate gradient iterations per implicit "
+         "step (default "
+      << defaults.cgIterations << ")\n"
+      << "  --xpbd-iterations N constraint iterations per xpbd step (default "
+      << defaults.xpbdIterations << ")\n"
+      << "  --collision-radius X closest two masses may get, 0 turns self "
+         "collision off (default "
+      << defaults.collisionRadius << ")\n"
+      << "  --ground Y       collide with a ground plane at height Y\n"
+      << "  --sphere X,Y,Z,R collide with a sphere, may be repeated\n"
+      << "  --obstacle PATH  collide with the triangles of an OBJ file, may be "
+         "repeated\n"
+      << "  --obstacle-thickness X distance masses keep from obstacles "
+         "(default "
+      << defaults.obstacleThickness << ")\n"
+      << "  --friction X     of obstacle contacts, 0 slides freely (default "
+      << defaults.friction << ")\n"
+      << "  --max-substeps N steps per frame before the viewer drops time "
+         "(default "
+      << defaults.maxSubsteps << ")\n"
+      << "  --overlay        show frame timings on screen (toggle with p)\n"
+      << "  --profile-csv PATH write the time of every phase of every frame "
+         "(headless: step) at exit\n"
+      << "  --profile-json PATH write p50 / p99 / max of every phase at exit\n"
+      << "  --record PATH    record the mass positions to a trajectory file\n"
+      << "  --record-fps X   recorded frames per simulated second, 0 records "
+         "every step (default "
+      << defaults.recordFps << ")\n"
+      << "  --record-quantum X position resolution of the recording "
+         "(default "
+      << defaults.recordQuantum << ")\n"
+      << "  --play PATH      play a recorded trajectory back over the scene it "
+         "was recorded\n"
+         "                   from instead of simulating, headless decodes "
+         "every frame\n"
+      << "  --checkpoint PATH save the whole simulation state to PATH with "
+         "F5, headless at\n"
+         "                   the end and every --checkpoint-every steps\n"
+      << "  --checkpoint-every N headless steps between checkpoints, 0 only "
+         "saves at the end\n"
+         "                   (default "
+      << defaults.checkpointEvery << ")\n"
+      << "  --restore PATH   carry on from a checkpoint instead of the scene, "
+         "with its\n"
+         "                   integrator, headless for --steps more steps\n"
+      << "  --offscreen PATTERN render to numbered .png or .ppm files without "
+         "a window,\n"
+         "                   PATTERN has one %d for the frame number, e.g. "
+         "out/%05d.png\n"
+      << "  --offscreen-frames N frames to render (default "
+      << defaults.offscreenFrames << ")\n"
+      << "  --offscreen-size WxH of the rendered frames (default "
+      << defaults.offscreenWidth << "x" << defaults.offscreenHeight << ")\n"
+      << "  --offscreen-fps X rendered frames per simulated second (default "
+      << defaults.offscreenFps << ")\n"
+      << "  --threads N      simulation threads (default " << defaults.threads
+      << ")\n"
+      << "  --simd LEVEL     spring kernels to use, auto (default, "
+      << simdLevelName(supportedSimdLevel()) << " here) avx2 sse or scalar\n"
+      << "  --help           print this message" << std::endl;
+}
+
+bool addObstacles(SimOptions const &options, Obstacles &obstacles) {
+  // large enough to reach past anything the scenes build
+  float const GROUND_HALF_SIZE = 500.f;
+
+  obstacles.clear();
+  obstacles.setThickness(options.obstacleThickness);
+  obstacles.setFriction(options.friction);
+  if (options.ground) {
+    obstacles.add(makePlaneMesh(Vec3f(0.f, options.groundHeight, 0.f),
+                                Vec3f(0.f, 1.f, 0.f), GROUND_HALF_SIZE));
+  }
+  for (auto const &sphere : options.spheres)
+    obstacles.add(makeSphereMesh(sphere.center, sphere.radius));
+  for (auto const &path : options.obstacleFiles) {
+    Mesh mesh;
+    if (!loadObjMesh(path, mesh))
+      return false;
+    obstacles.add(mesh);
+  }
+  return true;
+}
@@ -0,0 +1,80 @@
+//
+//  CommandLine.h
+//
+//	Options shared by the viewer and the headless driver.
+//
+//	Options are given as --name=value or --name value, flags as --name.
+
+#ifndef COMMAND_LINE_H
+#define COMMAND_LINE_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Integrator.h"
+#include "Obstacles.h"
+#include "Scenes.h"
+#include "SpringKernels.h"
+
+struct SphereObstacle {
+  Vec3f center;
+  float radius;
+};
+
+struct SimOptions {
+  SimOptions();
+
+  bool help;
+  bool headless;
+  std::string scene;
+  SceneParams sceneParams;
+  std::string sceneFile; // loaded instead of building scene if set
+  std::string saveScene; // headless only, file the initial scene is saved to
+  unsigned long steps; // headless only
+  float dt;
+  // dt follows the motion, starting from dt, headless then runs for
+  // steps * dt simulated seconds
+  bool adaptive;
+  float minDt, maxDt;
+  float strainPerStep;
+  float energyTolerance;
+  IntegratorType integrator;
+  float cgTolerance;
+  int cgIterations;
+  int xpbdIterations;
+  float collisionRadius; // 0 is no self collision
+  bool ground;
+  float groundHeight;
+  std::vector<SphereObstacle> spheres;
+  std::vector<std::string> obstacleFiles; // OBJ meshes
+  float obstacleThickness;
+  float friction;
+  int maxSubsteps; // viewer only, fixed steps per frame before dropping time
+  bool overlay;    // viewer only, show frame timings from the start
+  std::string profileCsv;  // per frame (per step headless) timings at exit
+  std::string profileJson; // their summary at exit
+  std::string recordFile; // trajectory the steps are recorded to
+  float recordFps;        // recorded frames per simulated second
+  float recordQuantum;    // position resolution of the recording
+  std::string playFile;   // trajectory played back instead of simulating
+  std::string checkpointFile;    // state saved to (headless: periodically)
+  unsigned long checkpointEvery; // headless steps between checkpoints
+  std::string restoreFile;       // checkpoint resumed instead of a scene
+  // viewer only, frames rendered to numbered image files without a window
+  std::string offscreenPattern;
+  unsigned long offscreenFrames;
+  int offscreenWidth, offscreenHeight;
+  float offscreenFps; // frames per simulated second
+  int threads;
+  SimdLevel simd;
+};
+
+// Prints what went wrong to std::cerr and returns false on bad input
+bool parseCommandLine(int argc, char **argv, SimOptions &options);
+void printUsage(std::ostream &out, char const *program);
+// Adds the ground, spheres and obstacle files of options, prints what went
+// wrong to std::cerr and returns false if a file cannot be read
+bool addObstacles(SimOptions const &options, Obstacles &obstacles);
+
+#endif // COMMAND_LINE_H
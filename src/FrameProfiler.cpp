@@ -0,0 +1,162 @@
+#include "FrameProfiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+// Nearest rank percentile, reorders values
+double percentile(std::vector<float> &values, double p) {
+  size_t rank = size_t(std::ceil(p * values.size()));
+  rank = std::min(std::max(rank, size_t(1)), values.size()) - 1;
+  std::nth_element(values.begin(), values.begin() + rank, values.end());
+  return values[rank];
+}
+
+std::string jsonString(std::string const &s) {
+  std::string out = "\"";
+  for (char c : s) {
+    if (c == '"' || c == '\\')
+      out += '\\';
+    out += c;
+  }
+  return out + "\"";
+}
+
+} // namespace
+
+// ======== CONSTRUCTORS ====================================================//
+FrameProfiler::FrameProfiler(size_t windowSize)
+    : m_windowSize(std::max(windowSize, size_t(1))), m_firstFrame(0) {
+  addPhase("frame");
+}
+// ==========================================================================//
+
+FrameProfiler::Phase FrameProfiler::addPhase(std::string const &name) {
+  m_names.push_back(name);
+  m_current.push_back(0.0);
+  m_history.push_back(std::vector<float>(m_history.empty() ? 0 : frameCount(),
+                                         0.f));
+  return Phase(m_names.size() - 1);
+}
+
+void FrameProfiler::beginFrame() {
+  std::fill(m_current.begin(), m_current.end(), 0.0);
+  m_frameStart = Clock::now();
+}
+
+void FrameProfiler::endFrame() {
+  record(FRAME, m_frameStart, Clock::now());
+
+  if (frameCount() == MAX_HISTORY) {
+    for (auto &history : m_history)
+      history.erase(history.begin(), history.begin() + MAX_HISTORY / 2);
+    m_firstFrame += MAX_HISTORY / 2;
+  }
+  for (size_t phase = 0; phase < m_history.size(); ++phase)
+    m_history[phase].push_back(float(m_current[phase]));
+}
+
+FrameProfiler::Stats FrameProfiler::windowStats(Phase phase) const {
+  size_t frames = frameCount();
+  return stats(phase, frames - std::min(frames, m_windowSize));
+}
+
+FrameProfiler::Stats FrameProfiler::totalStats(Phase phase) const {
+  return stats(phase, 0);
+}
+
+FrameProfiler::Stats FrameProfiler::stats(Phase phase, size_t first) const {
+  Stats s = {0, 0.0, 0.0, 0.0, 0.0};
+  std::vector<float> values(m_history[phase].begin() + first,
+                            m_history[phase].end());
+  if (values.empty())
+    return s;
+
+  s.frames = values.size();
+  double sum = 0.0;
+  for (float v : values) {
+    sum += v;
+    s.max = std::max(s.max, double(v));
+  }
+  s.mean = sum / values.size();
+  s.p50 = percentile(values, 0.5);
+  s.p99 = percentile(values, 0.99);
+  return s;
+}
+
+std::vector<std::string> FrameProfiler::summaryLines() const {
+  std::vector<std::string> lines;
+  char line[128];
+
+  Stats frame = windowStats(FRAME);
+  std::snprintf(line, sizeof(line), "%-8s %7.1f", "fps",
+                frame.mean > 0.0 ? 1e3 / frame.mean : 0.0);
+  lines.push_back(line);
+  std::snprintf(line, sizeof(line), "%-8s %7s %7s %7s", "ms", "p50", "p99",
+                "max");
+  lines.push_back(line);
+  for (size_t phase = 0; phase < phaseCount(); ++phase) {
+    Stats s = windowStats(Phase(phase));
+    std::snprintf(line, sizeof(line), "%-8.8s %7.2f %7.2f %7.2f",
+                  m_names[phase].c_str(), s.p50, s.p99, s.max);
+    lines.push_back(line);
+  }
+  return lines;
+}
+
+bool FrameProfiler::writeCsv(std::string const &path) const {
+  std::ofstream file(path.c_str());
+  if (!file) {
+    std::cerr << "Could Not Open File " << path << std::endl;
+    return false;
+  }
+
+  file << "index";
+  for (auto const &name : m_names)
+    file << "," << name;
+  file << "\n";
+
+  char value[32];
+  for (size_t frame = 0; frame < frameCount(); ++frame) {
+    file << m_firstFrame + frame;
+    for (auto const &history : m_history) {
+      std::snprintf(value, sizeof(value), ",%.6g", history[frame]);
+      file << value;
+    }
+    file << "\n";
+  }
+
+  if (!file.flush()) {
+    std::cerr << "Could not write " << path << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool FrameProfiler::writeJson(std::string const &path) const {
+  std::ofstream file(path.c_str());
+  if (!file) {
+    std::cerr << "Could Not Open File " << path << std::endl;
+    return false;
+  }
+
+  file << "{\n  \"frames\": " << frameCount() << ",\n  \"phases\": [";
+  for (size_t phase = 0; phase < phaseCount(); ++phase) {
+    Stats s = totalStats(Phase(phase));
+    file << (phase ? ",\n" : "\n") << "    {\"name\": "
+         << jsonString(m_names[phase]) << ", \"mean_ms\": " << s.mean
+         << ", \"p50_ms\": " << s.p50 << ", \"p99_ms\": " << s.p99
+         << ", \"max_ms\": " << s.max << "}";
+  }
+  file << "\n  ]\n}\n";
+
+  if (!file.flush()) {
+    std::cerr << "Could not write " << path << std::endl;
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,109 @@
+//
+//  FrameProfiler.h
+//
+//	Where the time of every frame goes, split into named phases.
+//
+//	A frame is bracketed by beginFrame() and endFrame(), which also time
+//	the whole frame as phase FRAME. Phases inside it are timed with a
+//	ScopedTimer, or given with record() when measured elsewhere (GPU timer
+//	queries), and several times of one phase in a frame add up. A phase
+//	not timed during a frame took 0 ms of it.
+//
+//	Every frame is kept, up to MAX_HISTORY frames after which the oldest
+//	half is dropped, for percentiles over the last windowSize() frames
+//	while running and over everything at exit, and for writing out as CSV
+//	(one row per frame) or JSON (a summary per phase). Timing a phase costs
+//	two reads of the steady clock and an addition.
+//
+//	Not thread safe, time everything from one thread.
+
+#ifndef FRAME_PROFILER_H
+#define FRAME_PROFILER_H
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class FrameProfiler {
+public:
+  typedef int Phase;
+  typedef std::chrono::steady_clock Clock;
+
+  enum { FRAME = 0 };
+  // about 4.5 hours at 60 frames per second
+  enum { MAX_HISTORY = 1 << 20 };
+
+  // Milliseconds, all 0 if there are no frames
+  struct Stats {
+    size_t frames;
+    double mean, p50, p99, max;
+  };
+
+  // Times its own lifetime as part of a phase of the current frame
+  class ScopedTimer {
+  public:
+    ScopedTimer(FrameProfiler &profiler, Phase phase)
+        : m_profiler(profiler), m_phase(phase), m_start(Clock::now()) {}
+    ~ScopedTimer() { m_profiler.record(m_phase, m_start, Clock::now()); }
+
+    ScopedTimer(ScopedTimer const &) = delete;
+    ScopedTimer &operator=(ScopedTimer const &) = delete;
+
+  private:
+    FrameProfiler &m_profiler;
+    Phase m_phase;
+    Clock::time_point m_start;
+  };
+
+public:
+  explicit FrameProfiler(size_t windowSize = 600);
+
+  // Phases added after the first frame read 0 ms in the earlier ones
+  Phase addPhase(std::string const &name);
+  size_t phaseCount() const { return m_names.size(); }
+  std::string const &phaseName(Phase phase) const { return m_names[phase]; }
+
+  void beginFrame();
+  void endFrame();
+
+  void record(Phase phase, double milliseconds) {
+    m_current[phase] += milliseconds;
+  }
+  void record(Phase phase, Clock::time_point start, Clock::time_point end) {
+    m_current[phase] +=
+        std::chrono::duration<double, std::milli>(end - start).count();
+  }
+
+  // Frames kept, and the number of the first of them
+  size_t frameCount() const { return m_history[FRAME].size(); }
+  size_t firstFrame() const { return m_firstFrame; }
+
+  size_t windowSize() const { return m_windowSize; }
+  // Over the last windowSize() frames
+  Stats windowStats(Phase phase) const;
+  // Over all frames kept
+  Stats totalStats(Phase phase) const;
+
+  // One line per phase with its window statistics, for showing on screen
+  std::vector<std::string> summaryLines() const;
+
+  // Print what went wrong to std::cerr and return false on failure
+  bool writeCsv(std::string const &path) const;
+  bool writeJson(std::string const &path) const;
+
+private:
+  Stats stats(Phase phase, size_t first) const;
+
+private:
+  size_t m_windowSize;
+  std::vector<std::string> m_names;
+  std::vector<double> m_current; // per phase, of the frame being timed
+  Clock::time_point m_frameStart;
+
+  // per phase, milliseconds of every frame kept
+  std::vector<std::vector<float>> m_history;
+  size_t m_firstFrame; // number of the oldest frame kept
+};
+
+#endif // FRAME_PROFILER_H
@@ -0,0 +1,61 @@
+#include "GpuTimer.h"
+
+// ======== CONSTRUCTORS ====================================================//
+GpuTimer::GpuTimer() : m_next(0), m_oldest(0), m_running(false) {
+  for (int i = 0; i < QUERY_COUNT; ++i) {
+    m_queries[i] = 0;
+    m_pending[i] = false;
+  }
+}
+// ==========================================================================//
+
+void GpuTimer::allocate() {
+  release();
+  if (!GLEW_VERSION_3_3 && !GLEW_ARB_timer_query)
+    return;
+  glGenQueries(QUERY_COUNT, m_queries);
+}
+
+void GpuTimer::release() {
+  if (available())
+    glDeleteQueries(QUERY_COUNT, m_queries);
+  for (int i = 0; i < QUERY_COUNT; ++i) {
+    m_queries[i] = 0;
+    m_pending[i] = false;
+  }
+  m_next = m_oldest = 0;
+  m_running = false;
+}
+
+void GpuTimer::begin() {
+  if (!available() || m_pending[m_next])
+    return;
+  glBeginQuery(GL_TIME_ELAPSED, m_queries[m_next]);
+  m_running = true;
+}
+
+void GpuTimer::end() {
+  if (!m_running)
+    return;
+  glEndQuery(GL_TIME_ELAPSED);
+  m_pending[m_next] = true;
+  m_next = (m_next + 1) % QUERY_COUNT;
+  m_running = false;
+}
+
+bool GpuTimer::read(double &milliseconds) {
+  if (!m_pending[m_oldest])
+    return false;
+
+  GLint done = 0;
+  glGetQueryObjectiv(m_queries[m_oldest], GL_QUERY_RESULT_AVAILABLE, &done);
+  if (!done)
+    return false;
+
+  GLuint64 ns = 0;
+  glGetQueryObjectui64v(m_queries[m_oldest], GL_QUERY_RESULT, &ns);
+  m_pending[m_oldest] = false;
+  m_oldest = (m_oldest + 1) % QUERY_COUNT;
+  milliseconds = ns * 1e-6;
+  return true;
+}
@@ -0,0 +1,48 @@
+//
+//  GpuTimer.h
+//
+//	GPU time of a stretch of GL commands, with GL_TIME_ELAPSED queries.
+//
+//	The result of a query is only read once the GPU has it, which takes a
+//	frame or more, so every frame starts the next of QUERY_COUNT queries
+//	and read() hands back the oldest finished one: the times come a few
+//	frames late but reading them never stalls. A frame whose query would
+//	still be in flight is not timed.
+//
+//	Timer queries are core in GL 3.3 and otherwise need ARB_timer_query,
+//	without either available() is false and nothing is timed. All calls
+//	need the GL context to be current.
+
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include <GL/glew.h>
+
+class GpuTimer {
+public:
+  enum { QUERY_COUNT = 4 };
+
+public:
+  GpuTimer();
+
+  void allocate();
+  void release();
+  bool available() const { return m_queries[0] != 0; }
+
+  // Around the commands to time, not nested with other GL_TIME_ELAPSED
+  // queries
+  void begin();
+  void end();
+
+  // Milliseconds of the oldest finished query, false if none is finished
+  bool read(double &milliseconds);
+
+private:
+  GLuint m_queries[QUERY_COUNT];
+  bool m_pending[QUERY_COUNT]; // started and not read yet
+  int m_next;                  // query begin() starts
+  int m_oldest;                // query read() looks at
+  bool m_running;              // between begin() and end()
+};
+
+#endif // GPU_TIMER_H
@@ -0,0 +1,251 @@
+#include "Headless.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+
+#include "Checkpoint.h"
+#include "FrameProfiler.h"
+#include "ParticleSystem.h"
+#include "Scenes.h"
+#include "SceneFile.h"
+#include "Simulation.h"
+#include "Trajectory.h"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+// Decodes every frame of a recording, in order
+int runPlayback(SimOptions const &options) {
+  TrajectoryReader reader;
+  if (!reader.open(options.playFile))
+    return EXIT_FAILURE;
+
+  std::vector<Vec3f> positions(reader.massCount());
+  Clock::time_point start = Clock::now();
+  for (size_t frame = 0; frame < reader.frameCount(); ++frame) {
+    if (!reader.read(frame, positions.data()))
+      return EXIT_FAILURE;
+  }
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+  size_t frames = reader.frameCount();
+  double duration =
+      frames > 0 ? reader.frameTime(frames - 1) - reader.frameTime(0) : 0.0;
+  cout << "trajectory: " << options.playFile
+       << "  masses: " << reader.massCount() << "  frames: " << frames
+       << "  simulated: " << duration << " s" << endl;
+  cout << "decoded in " << seconds << " s  frames/s: "
+       << (seconds > 0 ? frames / seconds : 0.0) << "  ns/mass-frame: "
+       << (frames * reader.massCount() > 0
+               ? seconds * 1e9 / (double(frames) * reader.massCount())
+               : 0.0)
+       << endl;
+  return EXIT_SUCCESS;
+}
+
+} // namespace
+
+int runHeadless(SimOptions const &options) {
+  if (!options.offscreenPattern.empty()) {
+    cerr << "--offscreen renders, run it without --headless" << endl;
+    return EXIT_FAILURE;
+  }
+  if (!options.playFile.empty())
+    return runPlayback(options);
+
+  bool const restoring = !options.restoreFile.empty();
+  ParticleSystem particles;
+  Clock::time_point setupStart = Clock::now();
+  if (restoring) {
+    // into the simulation, once it is set up
+  } else if (!options.sceneFile.empty()) {
+    if (!loadSceneFile(options.sceneFile, particles))
+      return EXIT_FAILURE;
+  } else if (!buildScene(options.scene, particles, options.sceneParams)) {
+    double masses, springs;
+    if (!sceneCounts(options.scene, options.sceneParams, masses, springs))
+      cerr << "Unknown scene " << options.scene << endl;
+    return EXIT_FAILURE;
+  }
+  double setupSeconds =
+      std::chrono::duration<double>(Clock::now() - setupStart).count();
+
+  setSimdLevel(options.simd);
+  Simulation sim(particles, options.threads);
+  sim.setIntegrator(options.integrator);
+  sim.implicitSolver().setTolerance(options.cgTolerance);
+  sim.implicitSolver().setMaxIterations(options.cgIterations);
+  sim.xpbdSolver().setIterations(options.xpbdIterations);
+  sim.selfCollision().setRadius(options.collisionRadius);
+  if (!addObstacles(options, sim.obstacles()))
+    return EXIT_FAILURE;
+  sim.stepControl().setEnabled(options.adaptive);
+  sim.stepControl().setLimits(options.minDt, options.maxDt);
+  sim.stepControl().setStrainPerStep(options.strainPerStep);
+  sim.stepControl().setEnergyTolerance(options.energyTolerance);
+  sim.stepControl().reset(options.dt);
+
+  if (restoring) {
+    Clock::time_point restoreStart = Clock::now();
+    if (!loadCheckpoint(options.restoreFile, sim))
+      return EXIT_FAILURE;
+    setupSeconds =
+        std::chrono::duration<double>(Clock::now() - restoreStart).count();
+  }
+
+  if (!options.saveScene.empty() &&
+      !saveSceneFile(options.saveScene, particles)) {
+    return EXIT_FAILURE;
+  }
+
+  cout << "scene: "
+       << (restoring ? options.restoreFile
+                     : options.sceneFile.empty() ? options.scene
+                                                 : options.sceneFile)
+       << "  masses: " << particles.massCount()
+       << "  springs: " << particles.springCount()
+       << "  threads: " << sim.threadCount()
+       << "  integrator: " << integratorName(sim.integrator())
+       << "  simd: " << simdLevelName(simdLevel()) << endl;
+  cout << (restoring ? "restored"
+                     : options.sceneFile.empty() ? "built" : "loaded")
+       << " in " << setupSeconds * 1e3 << " ms";
+  if (restoring)
+    cout << "  at " << sim.time() << " s, step " << sim.stepCount();
+  cout << endl;
+
+  // every step is a frame, to see how steady the step time is
+  FrameProfiler profiler(options.steps);
+
+  TrajectoryWriter recorder;
+  if (!options.recordFile.empty()) {
+    if (!recorder.open(options.recordFile, particles.massCount(),
+                       options.recordFps, options.recordQuantum))
+      return EXIT_FAILURE;
+    recorder.record(sim.time(), particles.positions());
+  }
+
+  // the copy is all the steps wait for, the file is written meanwhile
+  CheckpointWriter checkpoints;
+  unsigned long checkpointCalls = 0;
+  double checkpointSeconds = 0, checkpointMaxSeconds = 0;
+  auto checkpoint = [&]() {
+    ++checkpointCalls;
+    Clock::time_point copyStart = Clock::now();
+    checkpoints.save(options.checkpointFile, sim);
+    double seconds =
+        std::chrono::duration<double>(Clock::now() - copyStart).count();
+    checkpointSeconds += seconds;
+    checkpointMaxSeconds = std::max(checkpointMaxSeconds, seconds);
+  };
+
+  Clock::time_point start = Clock::now();
+
+  // adaptive runs cover the same simulated time fixed steps of dt would
+  double const startTime = sim.time();
+  double const endTime = startTime + double(options.steps) * options.dt;
+  unsigned long steps = 0;
+  float minDt = options.dt, maxDt = options.dt;
+
+  unsigned long cgIterations = 0;
+  double collisionPairs = 0;
+  double contacts = 0;
+  // adaptive runs stop short of a sliver of a step left over by rounding
+  auto done = [&]() {
+    return options.adaptive ? endTime - sim.time() < 0.5 * options.minDt
+                            : steps == options.steps;
+  };
+  while (!done()) {
+    float dt = sim.nextStepSize(options.dt);
+    if (options.adaptive) {
+      minDt = std::min(minDt, dt);
+      maxDt = std::max(maxDt, dt);
+      // the last step ends right at the duration
+      dt = float(std::min(double(dt), endTime - sim.time()));
+    }
+    ++steps;
+
+    profiler.beginFrame();
+    sim.step(dt);
+    profiler.endFrame();
+    recorder.record(sim.time(), particles.positions());
+    cgIterations += sim.implicitSolver().lastIterations();
+    collisionPairs += sim.selfCollision().lastPairCount();
+    contacts += sim.obstacles().lastContactCount();
+    if (!options.checkpointFile.empty() && options.checkpointEvery > 0 &&
+        steps % options.checkpointEvery == 0 && !done()) {
+      checkpoint();
+    }
+  }
+
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+  if (!options.checkpointFile.empty()) {
+    checkpoint();
+    if (!checkpoints.wait())
+      return EXIT_FAILURE;
+    cout << "checkpoints: " << checkpoints.writtenCount()
+         << "  skipped: " << checkpoints.skippedCount() << "  copy ms mean: "
+         << checkpointSeconds * 1e3 / checkpointCalls
+         << "  max: " << checkpointMaxSeconds * 1e3 << endl;
+  }
+
+  if (recorder.isOpen()) {
+    if (!recorder.close())
+      return EXIT_FAILURE;
+    double massFrames = double(recorder.frameCount()) * particles.massCount();
+    cout << "recorded frames: " << recorder.frameCount()
+         << "  dropped: " << recorder.droppedCount()
+         << "  file: " << recorder.fileSize() / 1e6 << " MB  bytes/mass-frame: "
+         << (massFrames > 0 ? recorder.fileSize() / massFrames : 0.0) << endl;
+  }
+
+  double particleSteps = double(steps) * particles.massCount();
+  double stepsPerSecond = seconds > 0 ? steps / seconds : 0;
+  double nsPerParticleStep =
+      particleSteps > 0 ? seconds * 1e9 / particleSteps : 0;
+
+  cout << "steps: " << steps << "  dt: " << options.dt
+       << "  simulated: " << sim.time() << " s" << endl;
+  if (options.adaptive) {
+    StepController const &control = sim.stepControl();
+    cout << "adaptive dt min: " << minDt << "  mean: "
+         << (steps > 0 ? (sim.time() - startTime) / steps : 0.0)
+         << "  max: " << maxDt
+         << "  stable explicit dt: " << control.stabilityLimit() << endl;
+  }
+  if (sim.integrator() == IntegratorType::MultiRate) {
+    MultiRateSolver const &solver = sim.multiRateSolver();
+    cout << "multirate levels: " << solver.levelCount()
+         << "  outer steps: " << solver.outerSteps()
+         << "  stiff springs: " << solver.stiffSpringCount()
+         << "  stiff masses: " << solver.stiffMassCount() << endl;
+  }
+  cout << "wall: " << seconds << " s  steps/s: " << stepsPerSecond
+       << "  ns/particle-step: " << nsPerParticleStep << endl;
+  FrameProfiler::Stats step = profiler.totalStats(FrameProfiler::FRAME);
+  cout << "step ms p50: " << step.p50 << "  p99: " << step.p99
+       << "  max: " << step.max << endl;
+  if (sim.integrator() == IntegratorType::BackwardEuler && steps > 0) {
+    cout << "cg iterations/step: " << double(cgIterations) / steps << endl;
+  }
+  if (sim.selfCollision().enabled() && steps > 0) {
+    cout << "collision pairs/step: " << collisionPairs / steps << endl;
+  }
+  if (!sim.obstacles().empty() && steps > 0) {
+    cout << "obstacle contacts/step: " << contacts / steps << endl;
+  }
+
+  if (!options.profileCsv.empty() && !profiler.writeCsv(options.profileCsv))
+    return EXIT_FAILURE;
+  if (!options.profileJson.empty() && !profiler.writeJson(options.profileJson))
+    return EXIT_FAILURE;
+
+  return EXIT_SUCCESS;
+}
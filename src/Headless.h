@@ -0,0 +1,17 @@
+//
+//  Headless.h
+//
+//	Runs the simulation without GLFW or OpenGL, for throughput runs on
+//	machines without a display. Builds the requested scene, takes the
+//	requested number of steps and reports steps per second and the cost
+//	of one mass for one step.
+
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include "CommandLine.h"
+
+// Returns the process exit code
+int runHeadless(SimOptions const &options);
+
+#endif // HEADLESS_H
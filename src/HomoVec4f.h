@@ -27,8 +27,11 @@ public:
   float operator[](int i) const;
   float &operator[](int i);
 
+  float const *data() const;
+
 private:
-  union {
+  // aligned so Mat4f multiplication can load it as one SSE register
+  union alignas(16) {
     struct {
       float m_x, m_y, m_z, m_w;
     };
@@ -53,12 +56,27 @@ inline float HomoVec4f::operator[](int i) const { return m_coord[i]; }
 
 inline float &HomoVec4f::operator[](int i) { return m_coord[i]; }
 
+inline float const *HomoVec4f::data() const { return m_coord; }
+
 inline HomoVec4f::operator Vec3f() const { return Vec3f(m_x, m_y, m_z); }
 
 // Mat4f multiplication //
 inline HomoVec4f operator*(Mat4f const &m, HomoVec4f const &v) {
   HomoVec4f result;
 
+#ifdef MAT4F_SSE
+  // products of each row with v, transposed so that summing the registers
+  // adds every row's terms in the same order as the scalar loop
+  float const *a = m.data();
+  __m128 const x = _mm_load_ps(v.data());
+  __m128 p0 = _mm_mul_ps(_mm_load_ps(a), x);
+  __m128 p1 = _mm_mul_ps(_mm_load_ps(a + 4), x);
+  __m128 p2 = _mm_mul_ps(_mm_load_ps(a + 8), x);
+  __m128 p3 = _mm_mul_ps(_mm_load_ps(a + 12), x);
+  _MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+  __m128 sum = _mm_add_ps(_mm_add_ps(_mm_add_ps(p0, p1), p2), p3);
+  _mm_store_ps(&result[0], sum);
+#else
   float element;
   for (int i = 0; i < Mat4f::DIM; ++i) {
     element = 0;
@@ -67,6 +85,7 @@ inline HomoVec4f operator*(Mat4f const &m, HomoVec4f const &v) {
     }
     result[i] = element;
   }
+#endif
 
   return result;
 }
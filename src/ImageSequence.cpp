@@ -0,0 +1,277 @@
+#include "ImageSequence.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include <zlib.h>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+unsigned char const PNG_SIGNATURE[8] = {0x89, 'P', 'N', 'G',
+                                        '\r', '\n', 0x1a, '\n'};
+
+void putBigEndian(std::vector<unsigned char> &out, uint32_t value) {
+  out.push_back(value >> 24);
+  out.push_back(value >> 16);
+  out.push_back(value >> 8);
+  out.push_back(value);
+}
+
+// Fills in length and type of the chunk at start, whose size bytes of data
+// follow those 8 bytes up to the end of out, and appends its CRC
+void finishPngChunk(std::vector<unsigned char> &out, size_t start,
+                    char const *type, size_t size) {
+  unsigned char *chunk = out.data() + start;
+  chunk[0] = size >> 24;
+  chunk[1] = size >> 16;
+  chunk[2] = size >> 8;
+  chunk[3] = size;
+  std::memcpy(chunk + 4, type, 4);
+  uLong crc = crc32(0L, chunk + 4, uInt(4 + size));
+  putBigEndian(out, uint32_t(crc));
+}
+
+bool endsWith(std::string const &s, char const *suffix) {
+  size_t n = std::strlen(suffix);
+  return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+} // namespace
+
+bool imageFormat(std::string const &pattern, ImageFormat &format) {
+  if (endsWith(pattern, ".ppm"))
+    format = ImageFormat::PPM;
+  else if (endsWith(pattern, ".png"))
+    format = ImageFormat::PNG;
+  else
+    return false;
+  return true;
+}
+
+// The pattern is checked before it is given to snprintf, it comes from the
+// command line
+bool imageFileName(std::string const &pattern, unsigned long frame,
+                   std::string &name) {
+  ImageFormat format;
+  if (!imageFormat(pattern, format))
+    return false;
+
+  int conversions = 0;
+  for (size_t i = 0; i < pattern.size(); ++i) {
+    if (pattern[i] != '%')
+      continue;
+    if (++i < pattern.size() && pattern[i] == '%')
+      continue;
+    while (i < pattern.size() && pattern[i] >= '0' && pattern[i] <= '9')
+      ++i;
+    if (i == pattern.size() || pattern[i] != 'd')
+      return false;
+    ++conversions;
+  }
+  if (conversions != 1)
+    return false;
+
+  std::vector<char> buffer(pattern.size() + 32);
+  std::snprintf(buffer.data(), buffer.size(), pattern.c_str(), int(frame));
+  name = buffer.data();
+  return true;
+}
+
+// ======== CONSTRUCTORS ====================================================//
+ImageSequenceWriter::ImageSequenceWriter()
+    : m_format(ImageFormat::PPM), m_width(0), m_height(0), m_frames(0),
+      m_waitSeconds(0), m_buffers(0), m_closing(false), m_bytes(0),
+      m_failed(false) {}
+
+ImageSequenceWriter::~ImageSequenceWriter() { close(); }
+// ==========================================================================//
+
+bool ImageSequenceWriter::open(std::string const &pattern, int width,
+                               int height) {
+  close();
+
+  std::string name;
+  if (!imageFileName(pattern, 0, name) || !imageFormat(pattern, m_format)) {
+    std::cerr << "Image file names need one %d for the frame number and a "
+                 ".ppm or .png extension, not "
+              << pattern << std::endl;
+    return false;
+  }
+
+  m_pattern = pattern;
+  m_width = width;
+  m_height = height;
+  m_frames = 0;
+  m_waitSeconds = 0;
+  m_queue.clear();
+  m_free.clear();
+  m_buffers = 0;
+  m_closing = false;
+  m_bytes = 0;
+  m_failed = false;
+
+  m_thread = std::thread(&ImageSequenceWriter::run, this);
+  return true;
+}
+
+bool ImageSequenceWriter::close() {
+  if (!m_thread.joinable())
+    return !m_failed;
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_closing = true;
+  }
+  m_wake.notify_all();
+  m_thread.join();
+
+  m_free.clear();
+  return !m_failed;
+}
+
+void ImageSequenceWriter::write(unsigned long frameNumber,
+                                unsigned char const *rgba) {
+  if (!m_thread.joinable())
+    return;
+
+  Frame frame;
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_free.empty() && m_buffers >= MAX_PENDING) {
+      Clock::time_point start = Clock::now();
+      m_wake.wait(lock, [this]() { return !m_free.empty(); });
+      m_waitSeconds +=
+          std::chrono::duration<double>(Clock::now() - start).count();
+    }
+    if (!m_free.empty()) {
+      frame = std::move(m_free.back());
+      m_free.pop_back();
+    } else {
+      ++m_buffers;
+    }
+  }
+
+  frame.index = frameNumber;
+  ++m_frames;
+  frame.rgba.assign(rgba, rgba + size_t(4) * m_width * m_height);
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_queue.push_back(std::move(frame));
+  }
+  m_wake.notify_all();
+}
+
+void ImageSequenceWriter::run() {
+  for (;;) {
+    Frame frame;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_wake.wait(lock, [this]() { return !m_queue.empty() || m_closing; });
+      if (m_queue.empty())
+        return;
+      frame = std::move(m_queue.front());
+      m_queue.pop_front();
+    }
+
+    if (!encode(frame))
+      m_failed = true;
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_free.push_back(std::move(frame));
+    }
+    m_wake.notify_all();
+  }
+}
+
+bool ImageSequenceWriter::encode(Frame const &frame) {
+  m_file.clear();
+  if (m_format == ImageFormat::PNG) {
+    if (!encodePng(frame))
+      return false;
+  } else {
+    encodePpm(frame);
+  }
+
+  std::string name;
+  imageFileName(m_pattern, frame.index, name);
+  std::ofstream out(name.c_str(), std::ios::binary | std::ios::trunc);
+  out.write(reinterpret_cast<char const *>(m_file.data()), m_file.size());
+  if (!out) {
+    std::cerr << "Could Not Write File " << name << std::endl;
+    return false;
+  }
+  m_bytes += m_file.size();
+  return true;
+}
+
+void ImageSequenceWriter::encodePpm(Frame const &frame) {
+  char header[64];
+  int length =
+      std::snprintf(header, sizeof(header), "P6\n%d %d\n255\n", m_width,
+                    m_height);
+  m_file.assign(header, header + length);
+
+  size_t const rowBytes = size_t(3) * m_width;
+  m_file.resize(length + rowBytes * m_height);
+  unsigned char *out = m_file.data() + length;
+  // top row first
+  for (int y = m_height - 1; y >= 0; --y) {
+    unsigned char const *in = frame.rgba.data() + size_t(4) * m_width * y;
+    for (int x = 0; x < m_width; ++x, in += 4, out += 3) {
+      out[0] = in[0];
+      out[1] = in[1];
+      out[2] = in[2];
+    }
+  }
+}
+
+// 8 bit RGB, each row Sub filtered (the difference to the pixel on its
+// left), which turns flat areas into zeros for deflate
+bool ImageSequenceWriter::encodePng(Frame const &frame) {
+  size_t const rowBytes = 1 + size_t(3) * m_width;
+  m_rows.resize(rowBytes * m_height);
+  unsigned char *out = m_rows.data();
+  for (int y = m_height - 1; y >= 0; --y) {
+    unsigned char const *in = frame.rgba.data() + size_t(4) * m_width * y;
+    *out++ = 1; // Sub
+    unsigned char left[3] = {0, 0, 0};
+    for (int x = 0; x < m_width; ++x, in += 4, out += 3) {
+      for (int c = 0; c < 3; ++c) {
+        out[c] = in[c] - left[c];
+        left[c] = in[c];
+      }
+    }
+  }
+
+  m_file.assign(PNG_SIGNATURE, PNG_SIGNATURE + sizeof(PNG_SIGNATURE));
+
+  size_t start = m_file.size();
+  m_file.resize(start + 8);
+  putBigEndian(m_file, uint32_t(m_width));
+  putBigEndian(m_file, uint32_t(m_height));
+  unsigned char const ihdr[5] = {8, 2, 0, 0, 0}; // 8 bit RGB, no interlace
+  m_file.insert(m_file.end(), ihdr, ihdr + sizeof(ihdr));
+  finishPngChunk(m_file, start, "IHDR", 13);
+
+  start = m_file.size();
+  uLongf compressed = compressBound(uLong(m_rows.size()));
+  m_file.resize(start + 8 + compressed);
+  if (compress2(m_file.data() + start + 8, &compressed, m_rows.data(),
+                uLong(m_rows.size()), Z_BEST_SPEED) != Z_OK) {
+    std::cerr << "Could Not Compress Frame " << frame.index << std::endl;
+    return false;
+  }
+  m_file.resize(start + 8 + compressed);
+  finishPngChunk(m_file, start, "IDAT", compressed);
+
+  start = m_file.size();
+  m_file.resize(start + 8);
+  finishPngChunk(m_file, start, "IEND", 0);
+  return true;
+}
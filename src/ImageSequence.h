@@ -0,0 +1,102 @@
+//
+//  ImageSequence.h
+//
+//	Numbered image files, one per rendered frame, written on a thread of
+//	their own so encoding does not hold up rendering.
+//
+//	Frames come in the way GL reads them back: RGBA bytes, bottom row
+//	first. write() copies a frame into a recycled buffer and returns, the
+//	writer thread flips it, drops alpha and encodes it as binary PPM (P6)
+//	or PNG, whichever the extension of the file name pattern says. PNG rows
+//	are Sub filtered and deflated at zlib's fastest level, which already
+//	shrinks rendered frames (mostly flat background) to a small fraction of
+//	the PPM.
+//
+//	Unlike TrajectoryWriter nothing is dropped: a batch render wants every
+//	frame, so with MAX_PENDING frames waiting write() waits for the oldest
+//	to be written.
+
+#ifndef IMAGE_SEQUENCE_H
+#define IMAGE_SEQUENCE_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class ImageFormat { PPM, PNG };
+
+// Name of frame's file for a pattern with one printf integer conversion
+// (%d, %05d) and a .ppm or .png extension, false if pattern is not one
+bool imageFileName(std::string const &pattern, unsigned long frame,
+                   std::string &name);
+bool imageFormat(std::string const &pattern, ImageFormat &format);
+
+class ImageSequenceWriter {
+public:
+  enum { MAX_PENDING = 8 };
+
+public:
+  ImageSequenceWriter();
+  ~ImageSequenceWriter();
+
+  ImageSequenceWriter(ImageSequenceWriter const &) = delete;
+  ImageSequenceWriter &operator=(ImageSequenceWriter const &) = delete;
+
+  // Frames of width x height, into files named by pattern and the frame
+  // number given to write() (see imageFileName()). Prints what went wrong
+  // to std::cerr and returns false on failure.
+  bool open(std::string const &pattern, int width, int height);
+  // Waits for the frames still queued, returns false if any could not be
+  // written
+  bool close();
+  bool isOpen() const { return m_thread.joinable(); }
+
+  // width * height RGBA pixels, bottom row first, of the frame numbered
+  // frame
+  void write(unsigned long frame, unsigned char const *rgba);
+
+  ImageFormat format() const { return m_format; }
+  // Frames given to write(), bytes of the files written once closed, and
+  // how long write() waited for the writer thread in all
+  unsigned long frameCount() const { return m_frames; }
+  uint64_t bytesWritten() const { return m_bytes; }
+  double waitSeconds() const { return m_waitSeconds; }
+
+private:
+  struct Frame {
+    unsigned long index;
+    std::vector<unsigned char> rgba;
+  };
+
+  void run();
+  bool encode(Frame const &frame);
+  void encodePpm(Frame const &frame);
+  bool encodePng(Frame const &frame);
+
+private:
+  std::string m_pattern;
+  ImageFormat m_format;
+  int m_width, m_height;
+  unsigned long m_frames;
+  double m_waitSeconds;
+
+  std::mutex m_mutex;
+  std::condition_variable m_wake;
+  std::deque<Frame> m_queue;
+  std::vector<Frame> m_free; // recycled buffers
+  size_t m_buffers;          // queued, free or being written
+  bool m_closing;
+  std::thread m_thread;
+
+  // writer thread only, until it has been joined
+  std::vector<unsigned char> m_file; // encoded image
+  std::vector<unsigned char> m_rows; // PNG filtered scanlines
+  uint64_t m_bytes;
+  bool m_failed;
+};
+
+#endif // IMAGE_SEQUENCE_H
@@ -0,0 +1,132 @@
+#include "Integrator.h"
+
+#include <algorithm>
+
+#include "SpringKernels.h"
+
+namespace {
+
+struct IntegratorEntry {
+  IntegratorType type;
+  char const *name;
+};
+
+IntegratorEntry const INTEGRATORS[] = {
+    {IntegratorType::ExplicitEuler, "euler"},
+    {IntegratorType::SymplecticEuler, "symplectic"},
+    {IntegratorType::VelocityVerlet, "verlet"},
+    {IntegratorType::BackwardEuler, "implicit"},
+    {IntegratorType::XPBD, "xpbd"},
+    {IntegratorType::MultiRate, "multirate"},
+};
+
+void computeSpringForces(ParticleSystem &system, SpringColoring const &colors,
+                         ThreadPool &pool) {
+  Vec3f *force = system.forces();
+  pool.parallelFor(system.massCount(), [&](size_t begin, size_t end) {
+    std::fill(force + begin, force + end, Vec3f());
+  });
+
+  accumulateSpringForces(system, colors, pool);
+}
+
+} // namespace
+
+char const *integratorName(IntegratorType type) {
+  for (auto const &entry : INTEGRATORS) {
+    if (entry.type == type)
+      return entry.name;
+  }
+  return "unknown";
+}
+
+bool parseIntegratorType(std::string const &name, IntegratorType &type) {
+  for (auto const &entry : INTEGRATORS) {
+    if (name == entry.name) {
+      type = entry.type;
+      return true;
+    }
+  }
+  return false;
+}
+
+std::string integratorNames() {
+  std::string names;
+  for (auto const &entry : INTEGRATORS) {
+    if (!names.empty())
+      names += " ";
+    names += entry.name;
+  }
+  return names;
+}
+
+void accumulateSpringForces(ParticleSystem &system,
+                            SpringColoring const &colors, ThreadPool &pool) {
+  for (size_t c = 0; c < colors.batchCount(); ++c) {
+    size_t begin = colors.batchBegin(c);
+    size_t count = colors.batchEnd(c) - begin;
+
+    if (colors.isSerialBatch(c)) {
+      springForceKernel(system, begin, begin + count);
+      continue;
+    }
+
+    pool.parallelFor(count, [&](size_t b, size_t e) {
+      springForceKernel(system, begin + b, begin + e);
+    });
+  }
+}
+
+void explicitEulerStep(ParticleSystem &system, float dt,
+                       SpringColoring const &colors, ThreadPool &pool) {
+  computeSpringForces(system, colors, pool);
+
+  Vec3f *pos = system.positions();
+  Vec3f *vel = system.velocities();
+  Vec3f const *force = system.forces();
+  float const *invMass = system.inverseMasses();
+  Vec3f const gravity = system.gravity();
+  float const damping = system.damping();
+
+  pool.parallelFor(system.massCount(), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      if (invMass[i] == 0.f)
+        continue;
+
+      Vec3f acc = force[i] * invMass[i] + gravity - vel[i] * damping;
+      pos[i] += vel[i] * dt;
+      vel[i] += acc * dt;
+    }
+  });
+}
+
+void symplecticEulerStep(ParticleSystem &system, float dt,
+                         SpringColoring const &colors, ThreadPool &pool) {
+  computeSpringForces(system, colors, pool);
+
+  pool.parallelFor(system.massCount(), [&](size_t begin, size_t end) {
+    kickDriftKernel(system, dt, dt, true, begin, end);
+  });
+}
+
+void velocityVerletStep(ParticleSystem &system, float dt,
+                        SpringColoring const &colors, ThreadPool &pool,
+                        bool forcesValid) {
+  if (!forcesValid)
+    computeSpringForces(system, colors, pool);
+
+  float const halfDt = 0.5f * dt;
+
+  // half kick with the old forces, then drift to the new positions
+  pool.parallelFor(system.massCount(), [&](size_t begin, size_t end) {
+    kickDriftKernel(system, halfDt, dt, true, begin, end);
+  });
+
+  computeSpringForces(system, colors, pool);
+
+  // second half kick with the forces at the new positions, the drag uses
+  // the half step velocity
+  pool.parallelFor(system.massCount(), [&](size_t begin, size_t end) {
+    kickDriftKernel(system, halfDt, 0.f, false, begin, end);
+  });
+}
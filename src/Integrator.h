@@ -0,0 +1,63 @@
+//
+//  Integrator.h
+//
+//	Explicit time integration of a ParticleSystem.
+//
+//	Every step works straight on the contiguous arrays of the system: one
+//	pass over the springs to gather Hooke forces, one or two passes over the
+//	masses to advance velocities and positions. Fixed masses (inverse mass
+//	0) are left untouched.
+//
+//	  ExplicitEuler   x += dt v(t),   v += dt a(t)      first order, gains
+//	                                                      energy, reference only
+//	  SymplecticEuler v += dt a(t),   x += dt v(t+dt)   first order, stable
+//	  VelocityVerlet  half kick, drift, full force pass, half kick
+//	                                                      second order
+//	  BackwardEuler   implicit, see BackwardEuler.h       large stable steps
+//	  XPBD            constraint projection, see XPBD.h   large stable steps
+//	  MultiRate       verlet, stiff springs substepped    soft springs set dt
+//	                  see MultiRate.h
+
+#ifndef INTEGRATOR_H
+#define INTEGRATOR_H
+
+#include <string>
+
+#include "ParticleSystem.h"
+#include "ThreadPool.h"
+#include "SpringColoring.h"
+
+enum class IntegratorType {
+  ExplicitEuler,
+  SymplecticEuler,
+  VelocityVerlet,
+  BackwardEuler,
+  XPBD,
+  MultiRate
+};
+
+char const *integratorName(IntegratorType type);
+bool parseIntegratorType(std::string const &name, IntegratorType &type);
+// All names parseIntegratorType() accepts, separated by spaces
+std::string integratorNames();
+
+// Adds f = k * (|d| - rest) * d / |d|, d = b - a, of every spring to the
+// force of mass a, and -f to mass b. Colors are processed in order, the
+// springs of each color in parallel; colors must be up to date with the
+// system (SpringColoring::update()).
+void accumulateSpringForces(ParticleSystem &system,
+                            SpringColoring const &colors, ThreadPool &pool);
+
+// Each step recomputes the spring forces, except velocityVerletStep() which
+// expects system.forces() to already hold the forces at the current
+// positions (see the forcesValid flag) and leaves the forces at the new
+// positions there for the next step.
+void explicitEulerStep(ParticleSystem &system, float dt,
+                       SpringColoring const &colors, ThreadPool &pool);
+void symplecticEulerStep(ParticleSystem &system, float dt,
+                         SpringColoring const &colors, ThreadPool &pool);
+void velocityVerletStep(ParticleSystem &system, float dt,
+                        SpringColoring const &colors, ThreadPool &pool,
+                        bool forcesValid);
+
+#endif // INTEGRATOR_H
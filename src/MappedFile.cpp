@@ -0,0 +1,52 @@
+#include "MappedFile.h"
+
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::~MappedFile() { close(); }
+
+bool MappedFile::open(std::string const &path) {
+  close();
+
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::cerr << "Could Not Open File " << path << ": " << std::strerror(errno)
+              << std::endl;
+    return false;
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+    std::cerr << "Could Not Map Empty File " << path << std::endl;
+    ::close(fd);
+    return false;
+  }
+
+  size_t size = size_t(info.st_size);
+  void *data =
+      mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  // the mapping stays valid after the descriptor is closed
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    std::cerr << "Could Not Map File " << path << ": " << std::strerror(errno)
+              << std::endl;
+    return false;
+  }
+
+  m_data = static_cast<char *>(data);
+  m_size = size;
+  return true;
+}
+
+void MappedFile::close() {
+  if (m_data)
+    munmap(m_data, m_size);
+  m_data = nullptr;
+  m_size = 0;
+}
@@ -0,0 +1,36 @@
+//
+//  MappedFile.h
+//
+//	A whole file mapped into memory copy-on-write: the contents can be read
+//	and written in place, writes stay private to this process and never
+//	reach the file.
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <cstddef>
+
+class MappedFile {
+public:
+  MappedFile() : m_data(nullptr), m_size(0) {}
+  ~MappedFile();
+
+  MappedFile(MappedFile const &) = delete;
+  MappedFile &operator=(MappedFile const &) = delete;
+
+  // Prints what went wrong to std::cerr and returns false on failure
+  bool open(std::string const &path);
+  void close();
+
+  bool isOpen() const { return m_data != nullptr; }
+  char *data() { return m_data; }
+  char const *data() const { return m_data; }
+  size_t size() const { return m_size; }
+
+private:
+  char *m_data;
+  size_t m_size;
+};
+
+#endif // MAPPED_FILE_H
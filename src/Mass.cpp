@@ -1,16 +1,27 @@
 #include "Mass.h"
 
 // ======================== CONSTRUCTORS ============================//
-Mass::Mass(float m, Vec3f pos) {
+Mass::Mass(float m, Vec3f pos, Vec3f vel) {
   mass = m;
   position = pos;
-  velocity = Vec3f(0,0,0);
-  force = Vec3f(0,0,0);
+  velocity = vel;
 }
 // ==========================================================================//
 
 // ========================= OPERATORS ======================================//
-Vec3f Mass::getPos() {
+Vec3f Mass::getPos() const {
   return position;
 }
+
+Vec3f Mass::getVelocity() const {
+  return velocity;
+}
+
+float Mass::getMass() const {
+  return mass;
+}
+
+bool Mass::isFixed() const {
+  return mass <= 0.f;
+}
 // ==========================================================================//
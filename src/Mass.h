@@ -3,24 +3,28 @@
 
 #include <iostream>
 #include "Vec3f.h"
-#include <vector>
 
 using namespace std;
 
 // Defines the properties of a Mass
+//
+// A Mass only describes a point mass when it is added to a ParticleSystem,
+// the system itself owns the simulated state. A mass of 0 (or less) is
+// treated as infinitely heavy, so it stays fixed in place.
 
 class Mass {
 public:
-  vector<Mass> Masses;
-  Mass() {};
-  Mass(float m, Vec3f pos);
-  Vec3f getPos();
+  Mass() : mass(0.f) {};
+  Mass(float m, Vec3f pos, Vec3f vel = Vec3f(0, 0, 0));
+  Vec3f getPos() const;
+  Vec3f getVelocity() const;
+  float getMass() const;
+  bool isFixed() const;
 
 private:
   float mass;
   Vec3f position;
   Vec3f velocity;
-  Vec3f force;
 };
 
 #endif // MASS_H
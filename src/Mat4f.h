@@ -2,35 +2,47 @@
 #define MAT4F_H
 
 #include <assert.h>
-#include <memory>
 #include <initializer_list>
 #include <array>
-#include <functional>
 #include <algorithm>
 #include <iterator>
 #include <iostream>
 
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#define MAT4F_SSE 1
+#endif
+
 // Stores a 4 by 4 Matrix in Row Major order.
 // When passing to glUniform4x4fv, turn on transpose.
+//
+// The elements live inline (16 byte aligned, one SSE register per row), so
+// constructing, copying and multiplying matrices never allocates.
 
 class Mat4f {
 public:
   enum { DIM = 4, NUM_ELEM = 16 };
 
   typedef std::array<float, NUM_ELEM> ARRAY_16f;
-  typedef std::unique_ptr<ARRAY_16f> Mat4fHandle;
 
 public:
-  explicit Mat4f();
+  // elements are left uninitialized
+  explicit Mat4f() = default;
   explicit Mat4f(float f);
 
+  // Row major, usable in constant expressions
+  constexpr Mat4f(float a00, float a01, float a02, float a03, float a10,
+                  float a11, float a12, float a13, float a20, float a21,
+                  float a22, float a23, float a30, float a31, float a32,
+                  float a33);
+
   // not explicit, so Mat4f m = {1,...,16};
   Mat4f(std::initializer_list<float> list);
   // Move constructor
-  Mat4f(Mat4f &&moved);
+  Mat4f(Mat4f &&moved) = default;
   // Copy Constructor
-  Mat4f(const Mat4f &copied);
-  ~Mat4f();
+  Mat4f(const Mat4f &copied) = default;
+  ~Mat4f() = default;
 
   float &operator()(int row, int column);
   float &operator[](int element);
@@ -43,8 +55,8 @@ public:
   Mat4f operator*(const Mat4f &other) const;
   Mat4f operator*(float scalar) const;
 
-  Mat4f &operator=(const Mat4f &copied);
-  Mat4f &operator=(Mat4f &&moved);
+  Mat4f &operator=(const Mat4f &copied) = default;
+  Mat4f &operator=(Mat4f &&moved) = default;
 
   bool isValidDimIndex(int idx) const;
   bool isValidElementIndex(int idx) const;
@@ -57,11 +69,114 @@ public:
   ARRAY_16f::const_iterator end() const;
 
   float const *data() const;
+  float *data();
 
 private:
-  Mat4fHandle m_ptr;
+  alignas(16) ARRAY_16f m_data;
 };
 
 std::ostream &operator<<(std::ostream &, const Mat4f &mat);
 
+inline constexpr Mat4f::Mat4f(float a00, float a01, float a02, float a03,
+                              float a10, float a11, float a12, float a13,
+                              float a20, float a21, float a22, float a23,
+                              float a30, float a31, float a32, float a33)
+    : m_data{{a00, a01, a02, a03, a10, a11, a12, a13, a20, a21, a22, a23, a30,
+              a31, a32, a33}} {}
+
+inline float &Mat4f::operator()(int row, int column) {
+  assert(isValidDimIndex(row) && isValidDimIndex(column));
+  return m_data[row * DIM + column];
+}
+
+inline float Mat4f::operator()(int row, int column) const {
+  assert(isValidDimIndex(row) && isValidDimIndex(column));
+  return m_data[row * DIM + column];
+}
+
+inline float &Mat4f::operator[](int element) {
+  assert(isValidElementIndex(element));
+  return m_data[element];
+}
+
+inline float Mat4f::operator[](int element) const {
+  assert(isValidElementIndex(element));
+  return m_data[element];
+}
+
+// Row i of the product is sum_k this(i,k) * row k of other, added in k order
+// so the SSE and scalar paths give the same bits
+inline Mat4f Mat4f::operator*(const Mat4f &other) const {
+  Mat4f result;
+
+#ifdef MAT4F_SSE
+  __m128 const b0 = _mm_load_ps(other.m_data.data());
+  __m128 const b1 = _mm_load_ps(other.m_data.data() + 4);
+  __m128 const b2 = _mm_load_ps(other.m_data.data() + 8);
+  __m128 const b3 = _mm_load_ps(other.m_data.data() + 12);
+
+  for (int i = 0; i < DIM; ++i) {
+    float const *a = m_data.data() + i * DIM;
+    __m128 row = _mm_mul_ps(_mm_set1_ps(a[0]), b0);
+    row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(a[1]), b1));
+    row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(a[2]), b2));
+    row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(a[3]), b3));
+    _mm_store_ps(result.m_data.data() + i * DIM, row);
+  }
+#else
+  float element;
+  for (int i = 0; i < DIM; ++i) {
+    for (int j = 0; j < DIM; ++j) {
+      element = 0;
+      for (int k = 0; k < DIM; ++k) {
+        element += (*this)(i, k) * other(k, j);
+      }
+      result(i, j) = element;
+    }
+  }
+#endif
+
+  return result;
+}
+
+// 0	1	2	3
+// 4	5	6	7
+// 8	9	10	11
+// 12	13	14	15
+
+inline Mat4f Mat4f::transposed() const {
+  Mat4f result;
+
+#ifdef MAT4F_SSE
+  __m128 r0 = _mm_load_ps(m_data.data());
+  __m128 r1 = _mm_load_ps(m_data.data() + 4);
+  __m128 r2 = _mm_load_ps(m_data.data() + 8);
+  __m128 r3 = _mm_load_ps(m_data.data() + 12);
+  _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+  _mm_store_ps(result.m_data.data(), r0);
+  _mm_store_ps(result.m_data.data() + 4, r1);
+  _mm_store_ps(result.m_data.data() + 8, r2);
+  _mm_store_ps(result.m_data.data() + 12, r3);
+#else
+  for (int i = 0; i < DIM; ++i) {
+    for (int j = 0; j < DIM; ++j)
+      result(j, i) = (*this)(i, j);
+  }
+#endif
+
+  return result;
+}
+
+inline float const *Mat4f::data() const { return m_data.data(); }
+
+inline float *Mat4f::data() { return m_data.data(); }
+
+inline bool Mat4f::isValidDimIndex(int idx) const {
+  return idx >= 0 && idx < DIM;
+}
+
+inline bool Mat4f::isValidElementIndex(int idx) const {
+  return idx >= 0 && idx < NUM_ELEM;
+}
+
 #endif // MAT4F_H
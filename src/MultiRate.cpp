@@ -0,0 +1,245 @@
+#include "MultiRate.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Integrator.h"
+#include "SpringKernels.h"
+#include "StepController.h"
+
+namespace {
+
+// of the stable step actually used, as in StepController
+float const SAFETY = 0.9f;
+
+// Same operations as springForceKernel(), so taking a spring out of the
+// forces the kernel gathered leaves only rounding behind
+inline Vec3f springForce(Vec3f const *pos, ParticleSystem::SpringEnds ends,
+                         float stiffness, float rest) {
+  Vec3f d = pos[ends.b] - pos[ends.a];
+  float len = d.length();
+  if (len == 0.f)
+    return Vec3f();
+  return d * (stiffness * (len - rest) / len);
+}
+
+} // namespace
+
+// ======================== CONSTRUCTORS ============================//
+MultiRateSolver::MultiRateSolver()
+    : m_classified(false), m_system(nullptr), m_topology(0), m_damping(0.f),
+      m_dt(0.f), m_outerSteps(1), m_levelForcesValid(false) {}
+// ==========================================================================//
+
+bool MultiRateSolver::classify(ParticleSystem const &system, float dt) {
+  ParticleSystem::SpringEnds const *ends = system.springEnds();
+  float const *invMass = system.inverseMasses();
+  size_t const springCount = system.springCount();
+  size_t const massCount = system.massCount();
+
+  // the limits only change with the springs and masses, levels with dt
+  if (!m_classified || m_system != &system ||
+      m_topology != system.topologyVersion() ||
+      m_damping != system.damping()) {
+    std::vector<double> rows;
+    stiffnessRows(system, rows);
+    m_springLimit.resize(springCount);
+    for (size_t s = 0; s < springCount; ++s) {
+      double row = std::max(rows[ends[s].a], rows[ends[s].b]);
+      m_springLimit[s] = stableStepSize(row, system.damping());
+    }
+    m_system = &system;
+    m_topology = system.topologyVersion();
+    m_damping = system.damping();
+    m_dt = 0.f;
+  } else if (m_dt == dt) {
+    return false;
+  }
+  m_classified = true;
+  m_dt = dt;
+  m_levelForcesValid = false;
+
+  std::vector<unsigned char> springLevel(springCount);
+  int minLevel = springCount > 0 ? int(MAX_LEVEL) : 0;
+  int maxLevel = 0;
+  for (size_t s = 0; s < springCount; ++s) {
+    float limit = SAFETY * m_springLimit[s];
+    int level = 0;
+    if (limit > 0.f) {
+      while (level < MAX_LEVEL && dt > limit * float(1 << level))
+        ++level;
+    }
+    springLevel[s] = level;
+    minLevel = std::min(minLevel, level);
+    maxLevel = std::max(maxLevel, level);
+  }
+
+  // the softest springs set the outer step
+  m_outerSteps = 1 << minLevel;
+  int const levelCount = maxLevel - minLevel + 1;
+  m_levels.assign(levelCount - 1, Level());
+  m_stiffSprings.clear();
+  m_stiffMasses.clear();
+
+  std::vector<unsigned char> massLevel(massCount, 0);
+  for (size_t s = 0; s < springCount; ++s) {
+    int level = springLevel[s] - minLevel;
+    springLevel[s] = level;
+    massLevel[ends[s].a] = std::max<int>(massLevel[ends[s].a], level);
+    massLevel[ends[s].b] = std::max<int>(massLevel[ends[s].b], level);
+    if (level > 0) {
+      m_levels[level - 1].springs.push_back(unsigned(s));
+      m_stiffSprings.push_back(unsigned(s));
+    }
+  }
+
+  for (size_t i = 0; i < massCount; ++i) {
+    if (massLevel[i] > 0 && invMass[i] != 0.f) {
+      m_levels[massLevel[i] - 1].drifted.push_back(unsigned(i));
+      m_stiffMasses.push_back(unsigned(i));
+    }
+  }
+  m_savedPos.resize(m_stiffMasses.size());
+
+  // renumber the masses of each level's springs, -1 if not used yet
+  std::vector<int> local(massCount, -1);
+  for (auto &level : m_levels) {
+    auto localIndex = [&](unsigned mass) {
+      if (local[mass] < 0) {
+        local[mass] = int(level.masses.size());
+        level.masses.push_back(mass);
+      }
+      return unsigned(local[mass]);
+    };
+    for (unsigned s : level.springs) {
+      ParticleSystem::SpringEnds e;
+      e.a = localIndex(ends[s].a);
+      e.b = localIndex(ends[s].b);
+      level.ends.push_back(e);
+    }
+    level.forces.resize(level.masses.size());
+    for (unsigned mass : level.masses)
+      local[mass] = -1;
+  }
+  return true;
+}
+
+void MultiRateSolver::step(ParticleSystem &system, float dt,
+                           SpringColoring const &colors, ThreadPool &pool,
+                           bool forcesValid) {
+  // the forces left behind may include springs of another level now
+  if (classify(system, dt))
+    forcesValid = false;
+
+  float const h = dt / float(m_outerSteps);
+  if (m_levels.empty()) {
+    for (int i = 0; i < m_outerSteps; ++i) {
+      velocityVerletStep(system, h, colors, pool, forcesValid);
+      forcesValid = true;
+    }
+    return;
+  }
+
+  if (!forcesValid) {
+    computeSoftForces(system, colors, pool);
+    m_levelForcesValid = false;
+  }
+  for (int i = 0; i < m_outerSteps; ++i)
+    outerStep(system, h, colors, pool);
+}
+
+void MultiRateSolver::outerStep(ParticleSystem &system, float dt,
+                                SpringColoring const &colors,
+                                ThreadPool &pool) {
+  Vec3f *pos = system.positions();
+  float const halfDt = 0.5f * dt;
+
+  // half kick everything, gravity and drag included, but drift only the
+  // level 0 masses
+  for (size_t k = 0; k < m_stiffMasses.size(); ++k)
+    m_savedPos[k] = pos[m_stiffMasses[k]];
+  pool.parallelFor(system.massCount(), [&](size_t begin, size_t end) {
+    kickDriftKernel(system, halfDt, dt, true, begin, end);
+  });
+  for (size_t k = 0; k < m_stiffMasses.size(); ++k)
+    pos[m_stiffMasses[k]] = m_savedPos[k];
+
+  if (!m_levelForcesValid) {
+    for (auto &level : m_levels)
+      computeLevelForces(system, level);
+    m_levelForcesValid = true;
+  }
+  levelStep(system, 0, halfDt);
+  levelStep(system, 0, halfDt);
+
+  computeSoftForces(system, colors, pool);
+  pool.parallelFor(system.massCount(), [&](size_t begin, size_t end) {
+    kickDriftKernel(system, halfDt, 0.f, false, begin, end);
+  });
+}
+
+// The forces of all springs, less those of the deeper levels
+void MultiRateSolver::computeSoftForces(ParticleSystem &system,
+                                        SpringColoring const &colors,
+                                        ThreadPool &pool) {
+  Vec3f *force = system.forces();
+  pool.parallelFor(system.massCount(), [&](size_t begin, size_t end) {
+    std::fill(force + begin, force + end, Vec3f());
+  });
+  accumulateSpringForces(system, colors, pool);
+
+  Vec3f const *pos = system.positions();
+  ParticleSystem::SpringEnds const *ends = system.springEnds();
+  float const *stiffness = system.stiffnesses();
+  float const *rest = system.restLengths();
+  for (unsigned s : m_stiffSprings) {
+    Vec3f f = springForce(pos, ends[s], stiffness[s], rest[s]);
+    force[ends[s].a] -= f;
+    force[ends[s].b] += f;
+  }
+}
+
+void MultiRateSolver::computeLevelForces(ParticleSystem const &system,
+                                         Level &level) {
+  Vec3f const *pos = system.positions();
+  float const *stiffness = system.stiffnesses();
+  float const *rest = system.restLengths();
+  ParticleSystem::SpringEnds const *ends = system.springEnds();
+
+  std::fill(level.forces.begin(), level.forces.end(), Vec3f());
+  for (size_t k = 0; k < level.springs.size(); ++k) {
+    unsigned s = level.springs[k];
+    Vec3f f = springForce(pos, ends[s], stiffness[s], rest[s]);
+    level.forces[level.ends[k].a] += f;
+    level.forces[level.ends[k].b] -= f;
+  }
+}
+
+// One step of h of m_levels[index], its forces valid on entry and exit
+void MultiRateSolver::levelStep(ParticleSystem &system, size_t index,
+                                float h) {
+  Level &level = m_levels[index];
+  Vec3f *pos = system.positions();
+  Vec3f *vel = system.velocities();
+  float const *invMass = system.inverseMasses();
+  float const halfH = 0.5f * h;
+
+  auto kick = [&]() {
+    for (size_t k = 0; k < level.masses.size(); ++k) {
+      unsigned i = level.masses[k];
+      vel[i] += level.forces[k] * (invMass[i] * halfH);
+    }
+  };
+
+  kick();
+  for (unsigned i : level.drifted)
+    pos[i] += vel[i] * h;
+
+  if (index + 1 < m_levels.size()) {
+    levelStep(system, index + 1, halfH);
+    levelStep(system, index + 1, halfH);
+  }
+
+  computeLevelForces(system, level);
+  kick();
+}
@@ -0,0 +1,100 @@
+//
+//  MultiRate.h
+//
+//	Multi-rate velocity Verlet, for scenes where a few stiff springs would
+//	otherwise set the step size of everything (a stiff rope on soft cloth).
+//
+//	Every spring is put in a level L, the smallest for which dt / 2^L is a
+//	stable step for it: the Gershgorin bound of StepController.h taken at
+//	the busier of its two masses. A mass is in the deepest level of its
+//	springs. The step then is the impulse scheme of r-RESPA, one level
+//	nested in the other:
+//
+//	  level L, step h   half kick with the forces of the level L springs
+//	                    drift the masses of level L by h
+//	                    two steps of level L + 1 with h / 2
+//	                    half kick with the new level L forces
+//
+//	Gravity and drag act in the level 0 kicks only. Masses move only in
+//	the drifts of their own level, so the forces of a level stay valid
+//	from the end of one of its steps to the start of the next and each
+//	level computes its forces once per step, like verlet. Level 0 runs
+//	the verlet kernels over all masses and springs and takes the forces of
+//	the deeper springs out again. The deeper levels go over their own
+//	springs and masses only, one thread, so they should be few. Without
+//	any deeper springs the step is exactly velocityVerletStep().
+//
+//	If even the softest spring needs substeps, dt is split into 2^L equal
+//	steps first. Springs that are not stable at MAX_LEVEL stay there.
+
+#ifndef MULTI_RATE_H
+#define MULTI_RATE_H
+
+#include <vector>
+
+#include "ParticleSystem.h"
+#include "SpringColoring.h"
+#include "ThreadPool.h"
+
+class MultiRateSolver {
+public:
+  // at most 2^MAX_LEVEL steps of the stiffest springs per step
+  enum { MAX_LEVEL = 6 };
+
+public:
+  MultiRateSolver();
+
+  // Like velocityVerletStep(), forcesValid says whether the forces left by
+  // the last step are still those at the current positions
+  void step(ParticleSystem &system, float dt, SpringColoring const &colors,
+            ThreadPool &pool, bool forcesValid);
+
+  // Call after changing masses or stiffnesses without changing the topology
+  void invalidate() { m_classified = false; }
+
+  // Of the last step: levels in use, into how many equal steps dt was
+  // split, and the springs and masses substepped within those
+  int levelCount() const { return int(m_levels.size()) + 1; }
+  int outerSteps() const { return m_outerSteps; }
+  size_t stiffSpringCount() const { return m_stiffSprings.size(); }
+  size_t stiffMassCount() const { return m_stiffMasses.size(); }
+
+private:
+  // A level below 0, its springs on their own with masses renumbered
+  struct Level {
+    std::vector<unsigned> springs;
+    std::vector<ParticleSystem::SpringEnds> ends; // into masses
+    std::vector<unsigned> masses; // every mass its springs act on
+    std::vector<unsigned> drifted; // the free masses of this level
+    std::vector<Vec3f> forces; // per entry of masses
+  };
+
+  // Returns whether the levels changed
+  bool classify(ParticleSystem const &system, float dt);
+  void outerStep(ParticleSystem &system, float dt, SpringColoring const &colors,
+                 ThreadPool &pool);
+  void computeSoftForces(ParticleSystem &system, SpringColoring const &colors,
+                         ThreadPool &pool);
+  void computeLevelForces(ParticleSystem const &system, Level &level);
+  void levelStep(ParticleSystem &system, size_t index, float h);
+
+private:
+  // what the levels were worked out for
+  bool m_classified;
+  ParticleSystem const *m_system;
+  unsigned m_topology;
+  float m_damping;
+  float m_dt;
+
+  // per spring, the stable step at its masses, 0 if unbounded
+  std::vector<float> m_springLimit;
+
+  int m_outerSteps;
+  std::vector<Level> m_levels; // level i + 1
+  std::vector<unsigned> m_stiffSprings; // of all levels below 0
+  std::vector<unsigned> m_stiffMasses; // free masses of those levels
+  std::vector<Vec3f> m_savedPos; // per stiff mass
+  bool m_levelForcesValid;
+};
+
+#endif // MULTI_RATE_H
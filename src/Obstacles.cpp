@@ -0,0 +1,263 @@
+#include "Obstacles.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+// masses per batch sharing one walk of the tree
+size_t const BATCH_SIZE = 16;
+// a batch near more leaves than this walks the tree per mass instead
+size_t const MAX_BATCH_LEAVES = 32;
+
+float const PI = 3.14159265358979f;
+
+Vec3f const OBSTACLE_COLOR(0.6f, 0.6f, 0.6f);
+
+} // namespace
+
+// ======== CONSTRUCTORS ====================================================//
+Obstacles::Obstacles()
+    : m_dirty(false), m_thickness(0.05f), m_friction(0.f), m_contacts(0) {}
+// ==========================================================================//
+
+void Obstacles::add(Mesh const &mesh) {
+  int offset = int(m_verts.size());
+  m_verts.insert(m_verts.end(), mesh.vertices().begin(),
+                 mesh.vertices().end());
+  for (auto it = mesh.trianglesBegin(); it != mesh.trianglesEnd(); ++it)
+    m_tris.push_back(
+        Mesh::Triangle(it->a + offset, it->b + offset, it->c + offset));
+  m_dirty = true;
+}
+
+void Obstacles::clear() {
+  m_verts.clear();
+  m_tris.clear();
+  m_bvh.clear();
+  m_dirty = false;
+}
+
+bool Obstacles::apply(ParticleSystem &system, float dt, ThreadPool &pool) {
+  m_contacts = 0;
+  if (empty() || system.massCount() == 0)
+    return false;
+
+  if (m_dirty) {
+    m_bvh.build(m_verts, m_tris);
+    m_dirty = false;
+  }
+
+  // batches are fixed by index, not by thread, so results do not depend on
+  // the thread count
+  size_t const count = system.massCount();
+  size_t const batches = (count + BATCH_SIZE - 1) / BATCH_SIZE;
+  m_contacts = size_t(pool.parallelSum(
+      batches,
+      [&](size_t begin, size_t end) {
+        std::vector<TriangleBVH::Leaf> leaves;
+        leaves.reserve(MAX_BATCH_LEAVES);
+        size_t contacts = 0;
+        for (size_t b = begin; b < end; ++b)
+          contacts += collideBatch(system, dt, b * BATCH_SIZE,
+                                   std::min(count, (b + 1) * BATCH_SIZE),
+                                   leaves);
+        return double(contacts);
+      },
+      32));
+
+  return m_contacts > 0;
+}
+
+size_t Obstacles::collideBatch(ParticleSystem &system, float dt, size_t begin,
+                               size_t end,
+                               std::vector<TriangleBVH::Leaf> &leaves) const {
+  Vec3f *pos = system.positions();
+  Vec3f *vel = system.velocities();
+  float const *invMass = system.inverseMasses();
+
+  // box around where the batch's masses may touch something, a mass
+  // reaches thickness plus the distance it moved this step
+  Vec3f lo = pos[begin], hi = pos[begin];
+  float reach = 0.f;
+  for (size_t i = begin; i < end; ++i) {
+    for (int a = 0; a < 3; ++a) {
+      lo[a] = std::min(lo[a], pos[i][a]);
+      hi[a] = std::max(hi[a], pos[i][a]);
+    }
+    reach = std::max(reach, vel[i].lengthSquared());
+  }
+  reach = m_thickness + std::sqrt(reach) * dt;
+  lo -= Vec3f(reach, reach, reach);
+  hi += Vec3f(reach, reach, reach);
+  for (int a = 0; a < 3; ++a) {
+    if (lo[a] > m_bvh.max()[a] || hi[a] < m_bvh.min()[a])
+      return 0;
+  }
+
+  leaves.clear();
+  bool batched = m_bvh.overlappingLeaves(lo, hi, leaves, MAX_BATCH_LEAVES);
+  if (batched && leaves.empty())
+    return 0;
+
+  size_t contacts = 0;
+  for (size_t i = begin; i < end; ++i) {
+    if (invMass[i] == 0.f)
+      continue;
+
+    Vec3f &p = pos[i];
+    Vec3f &v = vel[i];
+    float maxDistance = m_thickness + v.length() * dt;
+    TriangleBVH::Hit hit;
+    bool found = batched ? m_bvh.closest(p, maxDistance, leaves.data(),
+                                         leaves.size(), hit)
+                         : m_bvh.closest(p, maxDistance, hit);
+    if (!found)
+      continue;
+
+    Vec3f d = p - hit.point;
+    Vec3f normal; // pushed out along
+    if (d * hit.normal >= 0.f) {
+      float dist = std::sqrt(hit.distance2);
+      if (dist >= m_thickness)
+        continue;
+      normal = dist > 0.f ? d / dist : hit.normal;
+    } else {
+      // behind, only a contact if the mass was in front before the step
+      Vec3f prev = p - v * dt;
+      if ((prev - hit.point) * hit.normal < 0.f)
+        continue;
+      normal = hit.normal;
+    }
+    ++contacts;
+
+    p = hit.point + normal * m_thickness;
+
+    float vn = v * normal;
+    if (vn < 0.f) {
+      v -= normal * vn;
+      float vt = v.length();
+      if (vt > 0.f)
+        v *= std::max(0.f, 1.f + m_friction * vn / vt);
+    }
+  }
+  return contacts;
+}
+
+Mesh makePlaneMesh(Vec3f const &center, Vec3f const &normal, float halfSize) {
+  Vec3f n = normal.normalized();
+  // any axis not along n gives the plane's tangents
+  Vec3f axis = std::abs(n.x()) < 0.9f ? Vec3f(1.f, 0.f, 0.f)
+                                      : Vec3f(0.f, 1.f, 0.f);
+  Vec3f u = (axis ^ n).normalized() * halfSize;
+  Vec3f v = (n ^ u.normalized()) * halfSize;
+
+  Mesh::Vertices verts;
+  verts.push_back(Mesh::Vertex(center - u - v, OBSTACLE_COLOR));
+  verts.push_back(Mesh::Vertex(center + u - v, OBSTACLE_COLOR));
+  verts.push_back(Mesh::Vertex(center + u + v, OBSTACLE_COLOR));
+  verts.push_back(Mesh::Vertex(center - u + v, OBSTACLE_COLOR));
+
+  Mesh::Triangles tris;
+  tris.push_back(Mesh::Triangle(0, 1, 2));
+  tris.push_back(Mesh::Triangle(0, 2, 3));
+  return Mesh(verts, tris);
+}
+
+Mesh makeSphereMesh(Vec3f const &center, float radius, int slices,
+                    int stacks) {
+  slices = std::max(slices, 3);
+  stacks = std::max(stacks, 2);
+
+  // poles, then stacks - 1 rings of slices vertices from the top down
+  Mesh::Vertices verts;
+  verts.push_back(
+      Mesh::Vertex(center + Vec3f(0.f, radius, 0.f), OBSTACLE_COLOR));
+  verts.push_back(
+      Mesh::Vertex(center - Vec3f(0.f, radius, 0.f), OBSTACLE_COLOR));
+  for (int s = 1; s < stacks; ++s) {
+    float theta = PI * s / stacks;
+    for (int i = 0; i < slices; ++i) {
+      float phi = 2.f * PI * i / slices;
+      Vec3f dir(std::sin(theta) * std::cos(phi), std::cos(theta),
+                std::sin(theta) * std::sin(phi));
+      verts.push_back(Mesh::Vertex(center + dir * radius, OBSTACLE_COLOR));
+    }
+  }
+
+  auto ring = [slices](int s, int i) {
+    return 2 + (s - 1) * slices + i % slices;
+  };
+  Mesh::Triangles tris;
+  for (int i = 0; i < slices; ++i) {
+    tris.push_back(Mesh::Triangle(0, ring(1, i), ring(1, i + 1)));
+    for (int s = 1; s + 1 < stacks; ++s) {
+      tris.push_back(Mesh::Triangle(ring(s, i), ring(s + 1, i),
+                                    ring(s + 1, i + 1)));
+      tris.push_back(Mesh::Triangle(ring(s, i), ring(s + 1, i + 1),
+                                    ring(s, i + 1)));
+    }
+    tris.push_back(
+        Mesh::Triangle(1, ring(stacks - 1, i + 1), ring(stacks - 1, i)));
+  }
+
+  // wind every triangle to face away from the center
+  for (auto &tri : tris) {
+    Vec3f a = verts[tri.a].pos, b = verts[tri.b].pos, c = verts[tri.c].pos;
+    if (((b - a) ^ (c - a)) * (a + b + c - center * 3.f) < 0.f)
+      std::swap(tri.b, tri.c);
+  }
+  return Mesh(verts, tris);
+}
+
+bool loadObjMesh(std::string const &path, Mesh &mesh) {
+  std::ifstream file(path.c_str());
+  if (!file) {
+    std::cerr << "Could Not Open File " << path << std::endl;
+    return false;
+  }
+
+  Mesh::Vertices verts;
+  Mesh::Triangles tris;
+  std::string line;
+  for (int lineNumber = 1; std::getline(file, line); ++lineNumber) {
+    std::istringstream in(line);
+    std::string type;
+    in >> type;
+
+    if (type == "v") {
+      float x, y, z;
+      if (!(in >> x >> y >> z)) {
+        std::cerr << "Bad vertex on line " << lineNumber << " of " << path
+                  << std::endl;
+        return false;
+      }
+      verts.push_back(Mesh::Vertex(Vec3f(x, y, z), OBSTACLE_COLOR));
+    } else if (type == "f") {
+      // v, v/vt, v//vn or v/vt/vn, negative indices count from the end
+      std::vector<int> face;
+      std::string corner;
+      while (in >> corner) {
+        long index = std::strtol(corner.c_str(), nullptr, 10);
+        if (index < 0)
+          index += long(verts.size());
+        else
+          index -= 1;
+        if (index < 0 || index >= long(verts.size())) {
+          std::cerr << "Bad face on line " << lineNumber << " of " << path
+                    << std::endl;
+          return false;
+        }
+        face.push_back(int(index));
+      }
+      for (size_t k = 2; k < face.size(); ++k)
+        tris.push_back(Mesh::Triangle(face[0], face[k - 1], face[k]));
+    }
+  }
+
+  mesh = Mesh(verts, tris);
+  return true;
+}
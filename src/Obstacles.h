@@ -0,0 +1,78 @@
+//
+//  Obstacles.h
+//
+//	Static environment geometry masses collide with, such as the ground,
+//	spheres or any triangle mesh.
+//
+//	All obstacle triangles go into one TriangleBVH. Masses are queried in
+//	batches of neighbouring indices (which are neighbours in space for the
+//	generated scenes): the tree is walked once per batch for the leaves
+//	near the batch, and every mass of the batch then only looks at those.
+//	Batches the tree has nothing near are skipped after one box test, and
+//	widely spread batches fall back to walking the tree per mass.
+//
+//	A mass closer than thickness() to a triangle, or one that crossed a
+//	triangle from its front side during the step, is put back thickness()
+//	in front of it. Its velocity into the surface is removed and friction
+//	takes off tangential speed in proportion (Coulomb style).
+
+#ifndef OBSTACLES_H
+#define OBSTACLES_H
+
+#include <cstddef>
+#include <string>
+
+#include "Mesh.h"
+#include "ParticleSystem.h"
+#include "ThreadPool.h"
+#include "TriangleBVH.h"
+
+class Obstacles {
+public:
+  Obstacles();
+
+  // Triangles face the side their counter clockwise winding points to
+  void add(Mesh const &mesh);
+  void clear();
+  bool empty() const { return m_tris.empty(); }
+  // Everything added, as one mesh for drawing
+  Mesh mesh() const { return Mesh(m_verts, m_tris); }
+
+  // Returns whether any mass was moved
+  bool apply(ParticleSystem &system, float dt, ThreadPool &pool);
+
+  float thickness() const { return m_thickness; }
+  void setThickness(float thickness) { m_thickness = thickness; }
+  // 0 slides freely, 1 stops tangential motion at moderate impacts
+  float friction() const { return m_friction; }
+  void setFriction(float friction) { m_friction = friction; }
+
+  // Masses in contact during the last apply()
+  size_t lastContactCount() const { return m_contacts; }
+
+private:
+  size_t collideBatch(ParticleSystem &system, float dt, size_t begin,
+                      size_t end, std::vector<TriangleBVH::Leaf> &leaves) const;
+
+private:
+  Mesh::Vertices m_verts;
+  Mesh::Triangles m_tris;
+  TriangleBVH m_bvh;
+  bool m_dirty; // m_bvh is behind the triangles
+
+  float m_thickness;
+  float m_friction;
+  size_t m_contacts;
+};
+
+// Square of 2 * halfSize through center, facing normal
+Mesh makePlaneMesh(Vec3f const &center, Vec3f const &normal, float halfSize);
+// UV sphere facing outwards
+Mesh makeSphereMesh(Vec3f const &center, float radius, int slices = 32,
+                    int stacks = 16);
+// Reads the vertices and faces of a Wavefront OBJ file, polygons are split
+// into triangle fans. Prints what went wrong to std::cerr and returns false
+// on failure
+bool loadObjMesh(std::string const &path, Mesh &mesh);
+
+#endif // OBSTACLES_H
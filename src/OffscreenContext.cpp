@@ -0,0 +1,251 @@
+#include "OffscreenContext.h"
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <type_traits>
+#include <vector>
+
+static_assert(std::is_same<EGLDisplay, void *>::value &&
+                  std::is_same<EGLContext, void *>::value &&
+                  std::is_same<EGLSurface, void *>::value,
+              "EGL handles are kept as void pointers");
+
+namespace {
+
+bool hasExtension(char const *extensions, char const *name) {
+  if (!extensions)
+    return false;
+  size_t length = std::strlen(name);
+  for (char const *p = extensions; (p = std::strstr(p, name)); p += length) {
+    bool starts = p == extensions || p[-1] == ' ';
+    bool ends = p[length] == ' ' || p[length] == '\0';
+    if (starts && ends)
+      return true;
+  }
+  return false;
+}
+
+// The first display that initializes, see OffscreenContext.h for the order
+EGLDisplay initializeDisplay() {
+  char const *extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+  PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+      reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+          eglGetProcAddress("eglGetPlatformDisplayEXT"));
+  PFNEGLQUERYDEVICESEXTPROC queryDevices =
+      reinterpret_cast<PFNEGLQUERYDEVICESEXTPROC>(
+          eglGetProcAddress("eglQueryDevicesEXT"));
+
+  std::vector<EGLDisplay> candidates;
+  if (getPlatformDisplay &&
+      hasExtension(extensions, "EGL_MESA_platform_surfaceless")) {
+    candidates.push_back(getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA,
+                                            EGL_DEFAULT_DISPLAY, nullptr));
+  }
+  EGLDeviceEXT device;
+  EGLint deviceCount = 0;
+  if (getPlatformDisplay && queryDevices &&
+      hasExtension(extensions, "EGL_EXT_platform_device") &&
+      queryDevices(1, &device, &deviceCount) && deviceCount > 0) {
+    candidates.push_back(
+        getPlatformDisplay(EGL_PLATFORM_DEVICE_EXT, device, nullptr));
+  }
+  candidates.push_back(eglGetDisplay(EGL_DEFAULT_DISPLAY));
+
+  for (EGLDisplay display : candidates) {
+    if (display != EGL_NO_DISPLAY && eglInitialize(display, nullptr, nullptr))
+      return display;
+  }
+  return EGL_NO_DISPLAY;
+}
+
+} // namespace
+
+// ======== CONSTRUCTORS ====================================================//
+OffscreenContext::OffscreenContext()
+    : m_display(EGL_NO_DISPLAY), m_context(EGL_NO_CONTEXT),
+      m_surface(EGL_NO_SURFACE), m_width(0), m_height(0), m_samples(0),
+      m_framebuffer(0), m_color(0), m_depth(0), m_resolveFramebuffer(0),
+      m_resolveColor(0) {}
+
+OffscreenContext::~OffscreenContext() { release(); }
+// ==========================================================================//
+
+bool OffscreenContext::create(int width, int height, int samples) {
+  if (m_context == EGL_NO_CONTEXT && !createContext())
+    return false;
+  return createFramebuffer(width, height, samples);
+}
+
+bool OffscreenContext::createContext() {
+  m_display = initializeDisplay();
+  if (m_display == EGL_NO_DISPLAY) {
+    std::cerr << "No EGL display to render offscreen with" << std::endl;
+    return false;
+  }
+
+  EGLint const configAttributes[] = {EGL_SURFACE_TYPE,
+                                     EGL_PBUFFER_BIT,
+                                     EGL_RENDERABLE_TYPE,
+                                     EGL_OPENGL_BIT,
+                                     EGL_RED_SIZE,
+                                     8,
+                                     EGL_GREEN_SIZE,
+                                     8,
+                                     EGL_BLUE_SIZE,
+                                     8,
+                                     EGL_NONE};
+  EGLConfig config;
+  EGLint configCount = 0;
+  if (!eglBindAPI(EGL_OPENGL_API) ||
+      !eglChooseConfig(m_display, configAttributes, &config, 1,
+                       &configCount) ||
+      configCount == 0) {
+    std::cerr << "No desktop OpenGL config on the EGL display" << std::endl;
+    release();
+    return false;
+  }
+
+  EGLint const contextAttributes[] = {EGL_CONTEXT_MAJOR_VERSION,
+                                      3,
+                                      EGL_CONTEXT_MINOR_VERSION,
+                                      3,
+                                      EGL_CONTEXT_OPENGL_PROFILE_MASK,
+                                      EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                                      EGL_NONE};
+  m_context =
+      eglCreateContext(m_display, config, EGL_NO_CONTEXT, contextAttributes);
+  if (m_context == EGL_NO_CONTEXT) {
+    std::cerr << "Could not create an OpenGL 3.3 core context with EGL"
+              << std::endl;
+    release();
+    return false;
+  }
+
+  // everything is drawn into framebuffer objects, the surface is only
+  // there for drivers that need one to make a context current
+  if (!hasExtension(eglQueryString(m_display, EGL_EXTENSIONS),
+                    "EGL_KHR_surfaceless_context")) {
+    EGLint const surfaceAttributes[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1,
+                                        EGL_NONE};
+    m_surface = eglCreatePbufferSurface(m_display, config, surfaceAttributes);
+  }
+  if (!eglMakeCurrent(m_display, m_surface, m_surface, m_context)) {
+    std::cerr << "Could not make the EGL context current" << std::endl;
+    release();
+    return false;
+  }
+
+  glewExperimental = true; // Needed in Core Profile
+  GLenum error = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+  // GLEW built for GLX loads the GL functions first and only then fails on
+  // the missing X display, which an EGL context does not need
+  if (error == GLEW_ERROR_NO_GLX_DISPLAY)
+    error = GLEW_OK;
+#endif
+  if (error != GLEW_OK) {
+    std::cerr << "Failed to initialise GLEW" << std::endl;
+    release();
+    return false;
+  }
+  return true;
+}
+
+bool OffscreenContext::createFramebuffer(int width, int height, int samples) {
+  releaseFramebuffer();
+
+  GLint maxSamples = 0;
+  glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);
+  m_width = width;
+  m_height = height;
+  m_samples = std::min(std::max(samples, 0), int(maxSamples));
+
+  glGenFramebuffers(1, &m_framebuffer);
+  glGenRenderbuffers(1, &m_color);
+  glGenRenderbuffers(1, &m_depth);
+  glBindRenderbuffer(GL_RENDERBUFFER, m_color);
+  glRenderbufferStorageMultisample(GL_RENDERBUFFER, m_samples, GL_RGBA8,
+                                   width, height);
+  glBindRenderbuffer(GL_RENDERBUFFER, m_depth);
+  glRenderbufferStorageMultisample(GL_RENDERBUFFER, m_samples,
+                                   GL_DEPTH_COMPONENT24, width, height);
+  glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                            GL_RENDERBUFFER, m_color);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                            GL_RENDERBUFFER, m_depth);
+  bool complete =
+      glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+  if (complete && m_samples > 0) {
+    glGenFramebuffers(1, &m_resolveFramebuffer);
+    glGenRenderbuffers(1, &m_resolveColor);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_resolveColor);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_resolveFramebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                              GL_RENDERBUFFER, m_resolveColor);
+    complete =
+        glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+  }
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+  if (!complete) {
+    std::cerr << "Could not create a " << width << "x" << height
+              << " framebuffer with " << m_samples << " samples" << std::endl;
+    releaseFramebuffer();
+    return false;
+  }
+  bindForDrawing();
+  return true;
+}
+
+void OffscreenContext::releaseFramebuffer() {
+  if (m_context == EGL_NO_CONTEXT)
+    return;
+
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  GLuint framebuffers[] = {m_framebuffer, m_resolveFramebuffer};
+  GLuint renderbuffers[] = {m_color, m_depth, m_resolveColor};
+  glDeleteFramebuffers(2, framebuffers);
+  glDeleteRenderbuffers(3, renderbuffers);
+  m_framebuffer = m_resolveFramebuffer = 0;
+  m_color = m_depth = m_resolveColor = 0;
+}
+
+void OffscreenContext::release() {
+  releaseFramebuffer();
+  if (m_display == EGL_NO_DISPLAY)
+    return;
+
+  eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  if (m_context != EGL_NO_CONTEXT)
+    eglDestroyContext(m_display, m_context);
+  if (m_surface != EGL_NO_SURFACE)
+    eglDestroySurface(m_display, m_surface);
+  eglTerminate(m_display);
+  m_display = EGL_NO_DISPLAY;
+  m_context = EGL_NO_CONTEXT;
+  m_surface = EGL_NO_SURFACE;
+}
+
+void OffscreenContext::bindForDrawing() {
+  glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+  glViewport(0, 0, m_width, m_height);
+}
+
+void OffscreenContext::bindForReading() {
+  if (m_resolveFramebuffer) {
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, m_framebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_resolveFramebuffer);
+    glBlitFramebuffer(0, 0, m_width, m_height, 0, 0, m_width, m_height,
+                      GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, m_resolveFramebuffer);
+  } else {
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, m_framebuffer);
+  }
+}
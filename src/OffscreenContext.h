@@ -0,0 +1,62 @@
+//
+//  OffscreenContext.h
+//
+//	A GL context without a window, for rendering on machines with no
+//	display: the same GL 3.3 core profile the viewer's window has, drawn
+//	into a framebuffer object whose pixels are then read back.
+//
+//	The context comes from EGL, on the first of these displays that works:
+//	Mesa's surfaceless platform (a GPU render node, or llvmpipe without
+//	one), the first EGL device (drivers without the Mesa platforms), the
+//	default display. Frames are drawn multisampled like the window's and
+//	resolved into a plain framebuffer before they are read.
+
+#ifndef OFFSCREEN_CONTEXT_H
+#define OFFSCREEN_CONTEXT_H
+
+#include <GL/glew.h>
+
+class OffscreenContext {
+public:
+  OffscreenContext();
+  ~OffscreenContext();
+
+  OffscreenContext(OffscreenContext const &) = delete;
+  OffscreenContext &operator=(OffscreenContext const &) = delete;
+
+  // Makes the context current and loads the GL functions, then
+  // (re)creates the framebuffer: width x height, samples per pixel (0 for
+  // no multisampling). Prints what went wrong to std::cerr and returns
+  // false on failure.
+  bool create(int width, int height, int samples);
+  void release();
+
+  int width() const { return m_width; }
+  int height() const { return m_height; }
+  int samples() const { return m_samples; }
+
+  // Binds the framebuffer to draw the next frame into
+  void bindForDrawing();
+  // Resolves the frame drawn and binds it to be read
+  void bindForReading();
+
+private:
+  bool createContext();
+  bool createFramebuffer(int width, int height, int samples);
+  void releaseFramebuffer();
+
+private:
+  // EGLDisplay, EGLContext and EGLSurface, so the EGL headers (and the X11
+  // ones they pull in) stay out of the viewer's code
+  void *m_display;
+  void *m_context;
+  void *m_surface; // 1x1 pbuffer, if surfaceless contexts are missing
+
+  int m_width, m_height, m_samples;
+  GLuint m_framebuffer; // drawn into, multisampled
+  GLuint m_color, m_depth;
+  GLuint m_resolveFramebuffer; // read from, 0 if m_framebuffer is
+  GLuint m_resolveColor;
+};
+
+#endif // OFFSCREEN_CONTEXT_H
@@ -0,0 +1,122 @@
+#include "ParticleSystem.h"
+
+#include <cassert>
+#include <algorithm>
+#include <utility>
+
+// ========================= SETUP ==========================================//
+void ParticleSystem::clear() {
+  m_pos.clear();
+  m_vel.clear();
+  m_force.clear();
+  m_invMass.clear();
+
+  m_ends.clear();
+  m_stiffness.clear();
+  m_restLength.clear();
+
+  m_owner.reset();
+  ++m_topology;
+}
+
+void ParticleSystem::reserve(size_t massCount, size_t springCount) {
+  m_pos.reserve(massCount);
+  m_vel.reserve(massCount);
+  m_force.reserve(massCount);
+  m_invMass.reserve(massCount);
+
+  m_ends.reserve(springCount);
+  m_stiffness.reserve(springCount);
+  m_restLength.reserve(springCount);
+}
+
+void ParticleSystem::adopt(size_t massCount, Vec3f *pos, Vec3f *vel,
+                           float *invMass, size_t springCount,
+                           SpringEnds *ends, float *stiffness,
+                           float *restLength,
+                           std::shared_ptr<void> const &owner) {
+  m_pos.adopt(pos, massCount);
+  m_vel.adopt(vel, massCount);
+  m_invMass.adopt(invMass, massCount);
+  m_force.assign(std::vector<Vec3f>(massCount));
+
+  m_ends.adopt(ends, springCount);
+  m_stiffness.adopt(stiffness, springCount);
+  m_restLength.adopt(restLength, springCount);
+
+  m_owner = owner;
+  ++m_topology;
+}
+
+int ParticleSystem::addMass(Mass const &mass) {
+  return addMass(mass.getMass(), mass.getPos(), mass.getVelocity());
+}
+
+int ParticleSystem::addMass(float mass, Vec3f const &pos, Vec3f const &vel) {
+  m_pos.push_back(pos);
+  m_vel.push_back(vel);
+  m_force.push_back(Vec3f());
+  m_invMass.push_back(mass > 0.f ? 1.f / mass : 0.f);
+
+  ++m_topology;
+  return static_cast<int>(m_pos.size()) - 1;
+}
+
+int ParticleSystem::addSpring(Spring const &spring) {
+  return addSpring(spring.getMassA(), spring.getMassB(),
+                   spring.getStiffness(), spring.getRestLength());
+}
+
+int ParticleSystem::addSpring(int a, int b, float stiffness,
+                              float restLength) {
+  assert(a >= 0 && size_t(a) < massCount());
+  assert(b >= 0 && size_t(b) < massCount());
+  assert(a != b);
+
+  m_ends.emplace_back(a, b);
+  m_stiffness.push_back(stiffness);
+  m_restLength.push_back(restLength);
+
+  ++m_topology;
+  return static_cast<int>(m_ends.size()) - 1;
+}
+
+int ParticleSystem::addSpring(int a, int b, float stiffness) {
+  return addSpring(a, b, stiffness, m_pos[a].distance(m_pos[b]));
+}
+// ==========================================================================//
+
+// ========================= ACCESS =========================================//
+Mass ParticleSystem::mass(int i) const {
+  float m = m_invMass[i] > 0.f ? 1.f / m_invMass[i] : 0.f;
+  return Mass(m, m_pos[i], m_vel[i]);
+}
+
+Spring ParticleSystem::spring(int i) const {
+  return Spring(m_stiffness[i], m_ends[i].a, m_ends[i].b, m_restLength[i]);
+}
+
+void ParticleSystem::permuteSprings(std::vector<unsigned> const &order) {
+  assert(order.size() == springCount());
+
+  std::vector<SpringEnds> ends(order.size());
+  std::vector<float> stiffness(order.size());
+  std::vector<float> restLength(order.size());
+
+  for (size_t k = 0; k < order.size(); ++k) {
+    ends[k] = m_ends[order[k]];
+    stiffness[k] = m_stiffness[order[k]];
+    restLength[k] = m_restLength[order[k]];
+  }
+
+  m_ends.assign(std::move(ends));
+  m_stiffness.assign(std::move(stiffness));
+  m_restLength.assign(std::move(restLength));
+
+  ++m_topology;
+}
+
+void ParticleSystem::clearForces() {
+  std::fill(m_force.begin(), m_force.end(), Vec3f());
+}
+// ==========================================================================//
@@ -0,0 +1,118 @@
+//
+//  ParticleSystem.h
+//
+//	Structure-of-arrays store for all masses and springs of a simulation.
+//
+//	Every per mass attribute (position, velocity, force, inverse mass) lives
+//	in its own contiguous array indexed by the mass id, and springs are kept
+//	as index pairs with parallel stiffness / rest length arrays. The force
+//	and integration passes can then stream linearly through memory instead
+//	of chasing Mass/Spring objects.
+//
+//	A mass with an inverse mass of 0 is fixed in place. Forces only hold the
+//	spring (internal) forces, gravity and damping are applied as
+//	accelerations by the integrator so fixed masses need no special case.
+//
+//	The arrays can also be adopted from memory the system does not own (see
+//	SceneFile.h), a loaded scene is then simulated in place.
+
+#ifndef PARTICLE_SYSTEM_H
+#define PARTICLE_SYSTEM_H
+
+#include <vector>
+#include <cstddef>
+#include <memory>
+
+#include "Vec3f.h"
+#include "Mass.h"
+#include "Spring.h"
+#include "AttributeArray.h"
+
+class ParticleSystem {
+public: // Helper structures
+  struct SpringEnds {
+  public:
+    SpringEnds(unsigned a = 0, unsigned b = 0) : a(a), b(b) {}
+
+    unsigned a, b;
+  };
+
+public:
+  ParticleSystem()
+      : m_gravity(0.f, -9.81f, 0.f), m_damping(0.f), m_topology(0) {}
+
+  void clear();
+  void reserve(size_t massCount, size_t springCount);
+
+  // Replaces the contents with arrays owned by owner, which is kept alive
+  // for as long as any of them is in use. Forces get their own storage.
+  void adopt(size_t massCount, Vec3f *pos, Vec3f *vel, float *invMass,
+             size_t springCount, SpringEnds *ends, float *stiffness,
+             float *restLength, std::shared_ptr<void> const &owner);
+
+  // return the index of the new mass / spring
+  int addMass(Mass const &mass);
+  int addMass(float mass, Vec3f const &pos, Vec3f const &vel = Vec3f());
+  int addSpring(Spring const &spring);
+  int addSpring(int a, int b, float stiffness, float restLength);
+  // rest length is the current distance between the two masses
+  int addSpring(int a, int b, float stiffness);
+
+  size_t massCount() const { return m_pos.size(); }
+  size_t springCount() const { return m_ends.size(); }
+
+  Vec3f *positions() { return m_pos.data(); }
+  Vec3f const *positions() const { return m_pos.data(); }
+  Vec3f *velocities() { return m_vel.data(); }
+  Vec3f const *velocities() const { return m_vel.data(); }
+  Vec3f *forces() { return m_force.data(); }
+  Vec3f const *forces() const { return m_force.data(); }
+  float *inverseMasses() { return m_invMass.data(); }
+  float const *inverseMasses() const { return m_invMass.data(); }
+
+  SpringEnds const *springEnds() const { return m_ends.data(); }
+  float *stiffnesses() { return m_stiffness.data(); }
+  float const *stiffnesses() const { return m_stiffness.data(); }
+  float *restLengths() { return m_restLength.data(); }
+  float const *restLengths() const { return m_restLength.data(); }
+
+  // Rebuild the descriptors of a single mass or spring
+  Mass mass(int i) const;
+  Spring spring(int i) const;
+
+  // Moves spring order[k] to slot k of the spring arrays
+  void permuteSprings(std::vector<unsigned> const &order);
+
+  void clearForces();
+
+  // Acceleration applied to every free mass
+  Vec3f const &gravity() const { return m_gravity; }
+  void setGravity(Vec3f const &g) { m_gravity = g; }
+  // Linear drag, every free mass is slowed by -damping * velocity
+  float damping() const { return m_damping; }
+  void setDamping(float d) { m_damping = d; }
+
+  // Changes whenever masses or springs are added or removed, so anything
+  // derived from the connectivity knows when to rebuild.
+  unsigned topologyVersion() const { return m_topology; }
+
+private:
+  AttributeArray<Vec3f> m_pos;
+  AttributeArray<Vec3f> m_vel;
+  AttributeArray<Vec3f> m_force;
+  AttributeArray<float> m_invMass;
+
+  AttributeArray<SpringEnds> m_ends;
+  AttributeArray<float> m_stiffness;
+  AttributeArray<float> m_restLength;
+
+  // keeps adopted arrays alive
+  std::shared_ptr<void> m_owner;
+
+  Vec3f m_gravity;
+  float m_damping;
+
+  unsigned m_topology;
+};
+
+#endif // PARTICLE_SYSTEM_H
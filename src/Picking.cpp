@@ -0,0 +1,161 @@
+#include "Picking.h"
+
+#include <cmath>
+#include <mutex>
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+namespace {
+
+// masses per thread before another thread helps
+size_t const PICK_CHUNK = 16384;
+
+float const PI = 3.14159265358979f;
+
+struct Candidate {
+  float distance2;
+  int index;
+
+  bool operator<(Candidate const &other) const {
+    return distance2 < other.distance2 ||
+           (distance2 == other.distance2 && index < other.index);
+  }
+};
+
+// Projects one mass, returns false if it is outside the view volume. Adds
+// in the same order as the SSE path, so both give the same bits.
+bool projectOne(Vec3f const &p, float const *m, Viewport const &view,
+                float &sx, float &sy) {
+  float cx = (m[0] * p.x() + m[1] * p.y()) + (m[2] * p.z() + m[3]);
+  float cy = (m[4] * p.x() + m[5] * p.y()) + (m[6] * p.z() + m[7]);
+  float cz = (m[8] * p.x() + m[9] * p.y()) + (m[10] * p.z() + m[11]);
+  float cw = (m[12] * p.x() + m[13] * p.y()) + (m[14] * p.z() + m[15]);
+  if (!(std::abs(cx) <= cw && std::abs(cy) <= cw && std::abs(cz) <= cw))
+    return false;
+
+  sx = (cx / cw + 1.f) * (view.width * 0.5f);
+  sy = (1.f - cy / cw) * (view.height * 0.5f);
+  return true;
+}
+
+#if defined(__SSE__)
+// plane . (x, y, z, 1) for four points
+inline __m128 planeDistance(__m128 const *plane, __m128 x, __m128 y,
+                            __m128 z) {
+  return _mm_add_ps(
+      _mm_add_ps(_mm_mul_ps(plane[0], x), _mm_mul_ps(plane[1], y)),
+      _mm_add_ps(_mm_mul_ps(plane[2], z), plane[3]));
+}
+#endif
+
+Candidate pickRange(Vec3f const *positions, size_t begin, size_t end,
+                    float const *m, Viewport const &view, float x, float y,
+                    float radius2) {
+  Candidate best = {radius2, -1};
+
+  auto consider = [&](size_t i) {
+    float sx, sy;
+    if (!projectOne(positions[i], m, view, sx, sy))
+      return;
+    float d2 = (sx - x) * (sx - x) + (sy - y) * (sy - y);
+    Candidate c = {d2, int(i)};
+    if (c < best)
+      best = c;
+  };
+
+  size_t i = begin;
+#if defined(__SSE__)
+  // Only masses inside the square of pixels around the cursor can be
+  // within radius. The sides of that square are four planes through the
+  // camera, whose clip space rows are combinations of the matrix rows
+  // (e.g. x_ndc >= left is row0 - left * row3 >= 0), one pixel wider so
+  // rounding never loses a mass.
+  float const r = std::sqrt(radius2) + 1.f;
+  float const left = 2.f * (x - r) / view.width - 1.f;
+  float const right = 2.f * (x + r) / view.width - 1.f;
+  float const bottom = 1.f - 2.f * (y + r) / view.height;
+  float const top = 1.f - 2.f * (y - r) / view.height;
+  __m128 planes[4][4];
+  for (int c = 0; c < 4; ++c) {
+    planes[0][c] = _mm_set1_ps(m[c] - left * m[12 + c]);
+    planes[1][c] = _mm_set1_ps(right * m[12 + c] - m[c]);
+    planes[2][c] = _mm_set1_ps(m[4 + c] - bottom * m[12 + c]);
+    planes[3][c] = _mm_set1_ps(top * m[12 + c] - m[4 + c]);
+  }
+  __m128 const zero = _mm_setzero_ps();
+
+  for (; i + 4 <= end; i += 4) {
+    // x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3 into x, y and z of four
+    float const *f = reinterpret_cast<float const *>(positions + i);
+    __m128 a = _mm_loadu_ps(f);
+    __m128 b = _mm_loadu_ps(f + 4);
+    __m128 c = _mm_loadu_ps(f + 8);
+    __m128 t = _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 0, 3, 2));
+    __m128 vx = _mm_shuffle_ps(a, t, _MM_SHUFFLE(3, 0, 3, 0));
+    __m128 vy = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)),
+                               _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)),
+                               _MM_SHUFFLE(2, 0, 2, 0));
+    __m128 vz = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)),
+                               _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)),
+                               _MM_SHUFFLE(2, 0, 2, 0));
+
+    __m128 inside = _mm_and_ps(
+        _mm_and_ps(_mm_cmpge_ps(planeDistance(planes[0], vx, vy, vz), zero),
+                   _mm_cmpge_ps(planeDistance(planes[1], vx, vy, vz), zero)),
+        _mm_and_ps(_mm_cmpge_ps(planeDistance(planes[2], vx, vy, vz), zero),
+                   _mm_cmpge_ps(planeDistance(planes[3], vx, vy, vz), zero)));
+
+    // the few masses near the cursor are projected one by one, so the
+    // result is exactly the scalar one
+    int near = _mm_movemask_ps(inside);
+    for (int k = 0; k < 4; ++k) {
+      if (near & (1 << k))
+        consider(i + k);
+    }
+  }
+#endif
+  for (; i < end; ++i)
+    consider(i);
+
+  return best;
+}
+
+} // namespace
+
+int pickProjected(Vec3f const *positions, size_t count, Mat4f const &mvp,
+                  Viewport const &view, float x, float y, float radius,
+                  ThreadPool &pool) {
+  static_assert(sizeof(Vec3f) == 3 * sizeof(float),
+                "positions are read as packed floats");
+
+  Candidate best = {radius * radius, -1};
+  std::mutex bestMutex;
+  pool.parallelFor(
+      count,
+      [&](size_t begin, size_t end) {
+        Candidate c = pickRange(positions, begin, end, mvp.data(), view, x,
+                                y, radius * radius);
+        std::lock_guard<std::mutex> lock(bestMutex);
+        if (c < best)
+          best = c;
+      },
+      PICK_CHUNK);
+  return best.index;
+}
+
+Vec3f unprojectAtDepth(Camera const &camera, float fovDegrees,
+                       Viewport const &view, float x, float y, float depth) {
+  Vec3f forward = camera.forward().normalized();
+  Vec3f right = (forward ^ camera.up()).normalized();
+  Vec3f up = right ^ forward;
+
+  float tanHalf = std::tan(fovDegrees * PI / 360.f);
+  float ndcX = 2.f * x / view.width - 1.f;
+  float ndcY = 1.f - 2.f * y / view.height;
+  Vec3f dir = forward + right * (ndcX * tanHalf * view.width / view.height) +
+              up * (ndcY * tanHalf);
+
+  return camera.position() + dir * depth;
+}
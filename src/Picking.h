@@ -0,0 +1,40 @@
+//
+//  Picking.h
+//
+//	Finding the mass under the cursor, and where the cursor points in the
+//	scene, without a GL context.
+//
+//	A pick tests all masses against the four planes through the camera
+//	that bound the pick radius on screen, four at a time with SSE straight
+//	from the Vec3f array (no per mass matrix or vector objects, no
+//	perspective divide), with the range split over a thread pool. Only the
+//	few masses inside are projected to measure their distance in pixels.
+
+#ifndef PICKING_H
+#define PICKING_H
+
+#include <cstddef>
+
+#include "Camera.h"
+#include "Mat4f.h"
+#include "ThreadPool.h"
+#include "Vec3f.h"
+
+// A view of width x height pixels, with (0, 0) at the top left
+struct Viewport {
+  float width, height;
+};
+
+// Index of the mass drawn nearest to pixel (x, y) among those within
+// radius pixels of it, -1 if there is none. Ties go to the lower index.
+int pickProjected(Vec3f const *positions, size_t count, Mat4f const &mvp,
+                  Viewport const &view, float x, float y, float radius,
+                  ThreadPool &pool);
+
+// The point under pixel (x, y) at the given distance in front of the
+// camera (along its forward direction), for a perspective of fovDegrees
+// vertically
+Vec3f unprojectAtDepth(Camera const &camera, float fovDegrees,
+                       Viewport const &view, float x, float y, float depth);
+
+#endif // PICKING_H
@@ -0,0 +1,113 @@
+#include "PixelReadback.h"
+
+#include <iostream>
+
+namespace {
+
+// a frame in flight should never take this long
+GLuint64 const FENCE_TIMEOUT_NS = 1000000000ull;
+
+} // namespace
+
+// ======== CONSTRUCTORS ====================================================//
+PixelReadback::PixelReadback()
+    : m_width(0), m_height(0), m_next(0), m_pending(0), m_mapped(false) {
+  for (int i = 0; i < RING_SIZE; ++i) {
+    m_buffers[i] = 0;
+    m_fences[i] = 0;
+  }
+}
+// ==========================================================================//
+
+void PixelReadback::allocate(int width, int height) {
+  release();
+
+  m_width = width;
+  m_height = height;
+  glGenBuffers(RING_SIZE, m_buffers);
+  for (GLuint buffer : m_buffers) {
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+    glBufferData(GL_PIXEL_PACK_BUFFER, GLsizeiptr(4) * width * height,
+                 nullptr, GL_STREAM_READ);
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void PixelReadback::release() {
+  if (m_mapped)
+    unmapOldest();
+  for (int i = 0; i < RING_SIZE; ++i) {
+    if (m_fences[i])
+      glDeleteSync(m_fences[i]);
+    m_fences[i] = 0;
+  }
+  if (m_buffers[0])
+    glDeleteBuffers(RING_SIZE, m_buffers);
+  for (GLuint &buffer : m_buffers)
+    buffer = 0;
+  m_next = m_pending = 0;
+}
+
+void PixelReadback::read() {
+  if (m_pending == RING_SIZE) {
+    std::cerr << "Pixel readback ring full, dropping a frame" << std::endl;
+    --m_pending;
+  }
+
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, m_buffers[m_next]);
+  glPixelStorei(GL_PACK_ALIGNMENT, 4);
+  // into the buffer, so this returns before the pixels are there
+  glReadPixels(0, 0, m_width, m_height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  GLsync &fence = m_fences[m_next];
+  if (fence)
+    glDeleteSync(fence);
+  fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+  m_next = (m_next + 1) % RING_SIZE;
+  ++m_pending;
+}
+
+unsigned char const *PixelReadback::mapOldest() {
+  if (m_pending == 0)
+    return nullptr;
+
+  int oldest = (m_next + RING_SIZE - m_pending) % RING_SIZE;
+  GLsync &fence = m_fences[oldest];
+  if (fence) {
+    GLenum status = GL_TIMEOUT_EXPIRED;
+    while (status == GL_TIMEOUT_EXPIRED) {
+      status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                FENCE_TIMEOUT_NS);
+    }
+    if (status == GL_WAIT_FAILED)
+      std::cerr << "Waiting for a pixel readback fence failed" << std::endl;
+    glDeleteSync(fence);
+    fence = 0;
+  }
+
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, m_buffers[oldest]);
+  void *pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+                                  GLsizeiptr(4) * m_width * m_height,
+                                  GL_MAP_READ_BIT);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  m_mapped = pixels != nullptr;
+  if (!pixels) {
+    std::cerr << "Could not map a read back frame" << std::endl;
+    --m_pending;
+  }
+  return static_cast<unsigned char const *>(pixels);
+}
+
+void PixelReadback::unmapOldest() {
+  if (!m_mapped)
+    return;
+
+  int oldest = (m_next + RING_SIZE - m_pending) % RING_SIZE;
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, m_buffers[oldest]);
+  glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  m_mapped = false;
+  --m_pending;
+}
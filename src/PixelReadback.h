@@ -0,0 +1,55 @@
+//
+//  PixelReadback.h
+//
+//	Reads rendered frames back to the CPU without waiting for them.
+//
+//	read() only queues a glReadPixels of the bound read framebuffer into
+//	the next of RING_SIZE pixel buffer objects, and a fence behind it. The
+//	GPU copies the pixels while the next frames are being drawn, and the
+//	oldest frame is mapped once its fence has passed: with the ring full,
+//	a frame is read back RING_SIZE - 1 frames after it was drawn, and the
+//	map normally does not wait at all.
+//
+//	Pixels are RGBA bytes, bottom row first, the format drivers copy
+//	fastest. All calls need the GL context to be current.
+
+#ifndef PIXEL_READBACK_H
+#define PIXEL_READBACK_H
+
+#include <GL/glew.h>
+
+class PixelReadback {
+public:
+  enum { RING_SIZE = 3 };
+
+public:
+  PixelReadback();
+
+  // (Re)creates the ring for frames of width x height
+  void allocate(int width, int height);
+  void release();
+
+  int width() const { return m_width; }
+  int height() const { return m_height; }
+  // Frames read and not mapped yet, a read() with RING_SIZE of them
+  // pending drops the oldest
+  int pendingCount() const { return m_pending; }
+
+  // Starts reading the bound read framebuffer
+  void read();
+  // The oldest pending frame, waiting for it if needed, nullptr if nothing
+  // is pending or it could not be mapped. Valid until unmapOldest(), which
+  // must come before the next read().
+  unsigned char const *mapOldest();
+  void unmapOldest();
+
+private:
+  GLuint m_buffers[RING_SIZE];
+  GLsync m_fences[RING_SIZE];
+  int m_width, m_height;
+  int m_next;    // buffer read() reads into
+  int m_pending; // buffers before m_next being read
+  bool m_mapped; // the oldest one is mapped
+};
+
+#endif // PIXEL_READBACK_H
@@ -0,0 +1,260 @@
+#include "SceneFile.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "MappedFile.h"
+#include "SpringColoring.h"
+
+static_assert(sizeof(SceneFileHeader) == 64, "scene header layout");
+static_assert(sizeof(SceneFileSection) == 32, "scene section layout");
+static_assert(sizeof(Vec3f) == 3 * sizeof(float), "Vec3f must be packed");
+static_assert(sizeof(ParticleSystem::SpringEnds) == 2 * sizeof(uint32_t),
+              "SpringEnds must be packed");
+static_assert(sizeof(Mesh::Triangle) == 3 * sizeof(int32_t),
+              "Triangle must be packed");
+
+namespace {
+
+char const MAGIC[8] = {'M', 'S', 'S', 'C', 'E', 'N', 'E', '\0'};
+uint32_t const ENDIAN_TAG = 0x01020304;
+
+uint64_t aligned(uint64_t offset) {
+  return (offset + SCENE_FILE_ALIGNMENT - 1) / SCENE_FILE_ALIGNMENT *
+         SCENE_FILE_ALIGNMENT;
+}
+
+// Section of the given type checked against the file, nullptr if missing
+// or broken
+SceneFileSection const *findSection(MappedFile const &file,
+                                    SceneFileHeader const &header,
+                                    SceneSection type, uint32_t elementSize,
+                                    std::string const &path) {
+  SceneFileSection const *sections =
+      reinterpret_cast<SceneFileSection const *>(file.data() +
+                                                 sizeof(SceneFileHeader));
+  for (uint32_t i = 0; i < header.sectionCount; ++i) {
+    SceneFileSection const &section = sections[i];
+    if (section.type != uint32_t(type))
+      continue;
+
+    if (section.elementSize != elementSize ||
+        section.offset % SCENE_FILE_ALIGNMENT != 0 ||
+        section.offset > file.size() ||
+        section.count > (file.size() - section.offset) / elementSize) {
+      std::cerr << "Broken section " << section.type << " in scene file "
+                << path << std::endl;
+      return nullptr;
+    }
+    return &section;
+  }
+  return nullptr;
+}
+
+} // namespace
+
+bool saveSceneFile(std::string const &path, ParticleSystem const &system,
+                   Mesh::Triangles const &triangles) {
+  // a copy, so the springs can be put in color order
+  ParticleSystem colored(system);
+  SpringColoring coloring;
+  coloring.update(colored);
+
+  std::vector<SceneFileArray> data = {
+      {SceneSection::Positions, sizeof(Vec3f), colored.massCount(),
+       colored.positions()},
+      {SceneSection::Velocities, sizeof(Vec3f), colored.massCount(),
+       colored.velocities()},
+      {SceneSection::InverseMasses, sizeof(float), colored.massCount(),
+       colored.inverseMasses()},
+      {SceneSection::SpringEnds, sizeof(ParticleSystem::SpringEnds),
+       colored.springCount(), colored.springEnds()},
+      {SceneSection::Stiffnesses, sizeof(float), colored.springCount(),
+       colored.stiffnesses()},
+      {SceneSection::RestLengths, sizeof(float), colored.springCount(),
+       colored.restLengths()},
+  };
+  if (!triangles.empty()) {
+    data.push_back({SceneSection::Triangles, sizeof(Mesh::Triangle),
+                    triangles.size(), triangles.data()});
+  }
+  return writeSceneFile(path, system.gravity(), system.damping(), data);
+}
+
+bool writeSceneFile(std::string const &path, Vec3f const &gravity,
+                    float damping, std::vector<SceneFileArray> const &data) {
+  SceneFileHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = SCENE_FILE_VERSION;
+  header.byteOrder = ENDIAN_TAG;
+  header.sectionCount = uint32_t(data.size());
+  header.gravity[0] = gravity.x();
+  header.gravity[1] = gravity.y();
+  header.gravity[2] = gravity.z();
+  header.damping = damping;
+
+  std::vector<SceneFileSection> sections(data.size());
+  uint64_t offset =
+      aligned(sizeof(SceneFileHeader) + data.size() * sizeof(SceneFileSection));
+  for (size_t i = 0; i < data.size(); ++i) {
+    SceneFileSection &section = sections[i];
+    std::memset(&section, 0, sizeof(section));
+    section.type = uint32_t(data[i].type);
+    section.elementSize = data[i].elementSize;
+    section.offset = offset;
+    section.count = data[i].count;
+    offset = aligned(offset + section.count * section.elementSize);
+  }
+  header.fileSize = offset;
+
+  std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+  if (!out) {
+    std::cerr << "Could Not Open File " << path << std::endl;
+    return false;
+  }
+
+  char const padding[SCENE_FILE_ALIGNMENT] = {};
+  out.write(reinterpret_cast<char const *>(&header), sizeof(header));
+  out.write(reinterpret_cast<char const *>(sections.data()),
+            sections.size() * sizeof(SceneFileSection));
+  uint64_t written =
+      sizeof(header) + sections.size() * sizeof(SceneFileSection);
+  for (size_t i = 0; i < data.size(); ++i) {
+    out.write(padding, sections[i].offset - written);
+    uint64_t bytes = sections[i].count * sections[i].elementSize;
+    out.write(static_cast<char const *>(data[i].data), bytes);
+    written = sections[i].offset + bytes;
+  }
+  out.write(padding, header.fileSize - written);
+
+  if (!out) {
+    std::cerr << "Could Not Write File " << path << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool loadSceneFile(std::string const &path, ParticleSystem &system,
+                   Mesh::Triangles *triangles) {
+  std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+  if (!file->open(path))
+    return false;
+  return loadSceneFile(file, path, system, triangles);
+}
+
+bool checkSceneFile(MappedFile const &file, std::string const &path) {
+  SceneFileHeader const *header =
+      reinterpret_cast<SceneFileHeader const *>(file.data());
+  if (file.size() < sizeof(SceneFileHeader) ||
+      std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0) {
+    std::cerr << path << " is not a scene file" << std::endl;
+    return false;
+  }
+  if (header->version != SCENE_FILE_VERSION ||
+      header->byteOrder != ENDIAN_TAG) {
+    std::cerr << "Unsupported scene file version " << header->version
+              << " or byte order in " << path << std::endl;
+    return false;
+  }
+  if (header->fileSize != file.size() ||
+      header->sectionCount > (file.size() - sizeof(SceneFileHeader)) /
+                                 sizeof(SceneFileSection)) {
+    std::cerr << "Truncated scene file " << path << std::endl;
+    return false;
+  }
+  return true;
+}
+
+void const *findSceneSection(MappedFile const &file, SceneSection type,
+                             uint32_t elementSize, uint64_t &count,
+                             std::string const &path) {
+  SceneFileHeader const *header =
+      reinterpret_cast<SceneFileHeader const *>(file.data());
+  SceneFileSection const *section =
+      findSection(file, *header, type, elementSize, path);
+  if (!section)
+    return nullptr;
+  count = section->count;
+  return file.data() + section->offset;
+}
+
+bool loadSceneFile(std::shared_ptr<MappedFile> const &file,
+                   std::string const &path, ParticleSystem &system,
+                   Mesh::Triangles *triangles) {
+  if (!checkSceneFile(*file, path))
+    return false;
+
+  SceneFileHeader const *header =
+      reinterpret_cast<SceneFileHeader const *>(file->data());
+
+  SceneFileSection const *sections[] = {
+      findSection(*file, *header, SceneSection::Positions, sizeof(Vec3f),
+                  path),
+      findSection(*file, *header, SceneSection::Velocities, sizeof(Vec3f),
+                  path),
+      findSection(*file, *header, SceneSection::InverseMasses, sizeof(float),
+                  path),
+      findSection(*file, *header, SceneSection::SpringEnds,
+                  sizeof(ParticleSystem::SpringEnds), path),
+      findSection(*file, *header, SceneSection::Stiffnesses, sizeof(float),
+                  path),
+      findSection(*file, *header, SceneSection::RestLengths, sizeof(float),
+                  path),
+  };
+  for (auto section : sections) {
+    if (!section) {
+      std::cerr << "Missing section in scene file " << path << std::endl;
+      return false;
+    }
+  }
+
+  size_t massCount = sections[0]->count;
+  size_t springCount = sections[3]->count;
+  if (sections[1]->count != massCount || sections[2]->count != massCount ||
+      sections[4]->count != springCount || sections[5]->count != springCount) {
+    std::cerr << "Inconsistent array sizes in scene file " << path
+              << std::endl;
+    return false;
+  }
+
+  char *base = file->data();
+  ParticleSystem::SpringEnds *ends =
+      reinterpret_cast<ParticleSystem::SpringEnds *>(base +
+                                                     sections[3]->offset);
+  // the one pass over the data, a bad index would be read out of bounds
+  for (size_t s = 0; s < springCount; ++s) {
+    if (ends[s].a >= massCount || ends[s].b >= massCount ||
+        ends[s].a == ends[s].b) {
+      std::cerr << "Bad spring " << s << " in scene file " << path
+                << std::endl;
+      return false;
+    }
+  }
+
+  if (triangles) {
+    triangles->clear();
+    SceneFileSection const *section =
+        findSection(*file, *header, SceneSection::Triangles,
+                    sizeof(Mesh::Triangle), path);
+    if (section) {
+      Mesh::Triangle const *tris =
+          reinterpret_cast<Mesh::Triangle const *>(base + section->offset);
+      triangles->assign(tris, tris + section->count);
+    }
+  }
+
+  system.adopt(massCount, reinterpret_cast<Vec3f *>(base + sections[0]->offset),
+               reinterpret_cast<Vec3f *>(base + sections[1]->offset),
+               reinterpret_cast<float *>(base + sections[2]->offset),
+               springCount, ends,
+               reinterpret_cast<float *>(base + sections[4]->offset),
+               reinterpret_cast<float *>(base + sections[5]->offset), file);
+  system.setGravity(
+      Vec3f(header->gravity[0], header->gravity[1], header->gravity[2]));
+  system.setDamping(header->damping);
+  return true;
+}
@@ -0,0 +1,105 @@
+//
+//  SceneFile.h
+//
+//	Binary scene files, loaded by mapping them into memory: the arrays of
+//	the file are used as the simulation arrays in place, with no parsing
+//	and no copying.
+//
+//	Layout (native little endian, version 1):
+//	  SceneFileHeader   64 bytes, magic "MSSCENE", version, gravity, damping
+//	  SceneFileSection  one 32 byte entry per section
+//	  section data      each starting on a 64 byte boundary
+//
+//	Sections hold one ParticleSystem array each (positions, velocities,
+//	inverse masses, spring ends, stiffnesses, rest lengths) plus an optional
+//	triangle list over the masses for a Mesh. Unknown section types are
+//	skipped, so sections can be added without a new version: checkpoints
+//	(see Checkpoint.h) are scene files with the rest of the simulation
+//	state in sections of their own.
+
+#ifndef SCENE_FILE_H
+#define SCENE_FILE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+#include "Mesh.h"
+#include "ParticleSystem.h"
+
+enum { SCENE_FILE_VERSION = 1, SCENE_FILE_ALIGNMENT = 64 };
+
+struct SceneFileHeader {
+  char magic[8]; // "MSSCENE\0"
+  uint32_t version;
+  uint32_t byteOrder; // 0x01020304 as written
+  uint64_t fileSize;
+  uint32_t sectionCount;
+  float gravity[3];
+  float damping;
+  uint8_t reserved[20];
+};
+
+enum class SceneSection : uint32_t {
+  Positions = 1,
+  Velocities = 2,
+  InverseMasses = 3,
+  SpringEnds = 4,
+  Stiffnesses = 5,
+  RestLengths = 6,
+  Triangles = 7,
+  // checkpoints only
+  Forces = 8,
+  WarmStart = 9,
+  SimulationState = 10,
+};
+
+struct SceneFileSection {
+  uint32_t type;        // SceneSection
+  uint32_t elementSize; // bytes per element
+  uint64_t offset;      // from the start of the file
+  uint64_t count;       // elements
+  uint64_t reserved;
+};
+
+// One array of a scene file, written as a section of its own
+struct SceneFileArray {
+  SceneSection type;
+  uint32_t elementSize; // bytes per element
+  uint64_t count;       // elements
+  void const *data;
+};
+
+// Writes the system and, if not empty, triangles indexing its masses.
+// Springs are stored in color order (see SpringColoring.h) so a loaded
+// scene does not have to reorder them. Prints what went wrong to std::cerr
+// and returns false on failure.
+bool saveSceneFile(std::string const &path, ParticleSystem const &system,
+                   Mesh::Triangles const &triangles = Mesh::Triangles());
+// Writes the arrays as they are, the same way
+bool writeSceneFile(std::string const &path, Vec3f const &gravity,
+                    float damping, std::vector<SceneFileArray> const &arrays);
+
+// Maps the file and has the system adopt its arrays. Writes to the system
+// stay private to it and never reach the file. Triangles are copied out if
+// asked for. Prints what went wrong to std::cerr and returns false on
+// failure, leaving the system untouched.
+bool loadSceneFile(std::string const &path, ParticleSystem &system,
+                   Mesh::Triangles *triangles = nullptr);
+// The same from a file mapped already, which the system then keeps alive
+bool loadSceneFile(std::shared_ptr<MappedFile> const &file,
+                   std::string const &path, ParticleSystem &system,
+                   Mesh::Triangles *triangles = nullptr);
+
+// Whether file has a scene file header that fits it, prints what is wrong
+// to std::cerr if not
+bool checkSceneFile(MappedFile const &file, std::string const &path);
+// Data and element count of the section of type in a checked scene file,
+// nullptr if there is none or it does not fit (which is printed)
+void const *findSceneSection(MappedFile const &file, SceneSection type,
+                             uint32_t elementSize, uint64_t &count,
+                             std::string const &path);
+
+#endif // SCENE_FILE_H
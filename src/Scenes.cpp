@@ -0,0 +1,290 @@
+#include "Scenes.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+namespace {
+
+int sizeOr(int size, int fallback) { return size > 0 ? size : fallback; }
+
+// how much stiffer than the cloth the rope of buildClothRope() is
+float const ROPE_STIFFNESS = 1000.f;
+
+// one direction out of every +/- pair of the 26 neighbours of a jelly mass
+int const JELLY_OFFSETS[13][3] = {
+    {1, 0, 0},  {0, 1, 0},  {0, 0, 1},  {1, 1, 0},   {1, -1, 0},
+    {1, 0, 1},  {1, 0, -1}, {0, 1, 1},  {0, 1, -1},  {1, 1, 1},
+    {1, 1, -1}, {1, -1, 1}, {1, -1, -1}};
+
+// Springs between every mass (x,y,z) of a lattice and (x+dx,y+dy,z+dz), in
+// T: size_t to reserve, double to check sizes whose count may not fit it
+template <typename T>
+T latticeSpringCount(int w, int h, int d, int dx, int dy, int dz) {
+  return T(std::max(0, w - std::abs(dx))) * T(std::max(0, h - std::abs(dy))) *
+         T(std::max(0, d - std::abs(dz)));
+}
+
+// Masses along each axis and springs of the generated scenes
+void clothSize(SceneParams const &params, int &w, int &h) {
+  w = std::max(2, sizeOr(params.width, 32));
+  h = std::max(2, sizeOr(params.height, 32));
+}
+
+template <typename T> T clothSpringCount(int w, int h) {
+  return latticeSpringCount<T>(w, h, 1, 1, 0, 0) +
+         latticeSpringCount<T>(w, h, 1, 0, 1, 0) +
+         T(2) * latticeSpringCount<T>(w, h, 1, 1, 1, 0) +
+         latticeSpringCount<T>(w, h, 1, 2, 0, 0) +
+         latticeSpringCount<T>(w, h, 1, 0, 2, 0);
+}
+
+void jellySize(SceneParams const &params, int &w, int &h, int &d) {
+  w = std::max(2, sizeOr(params.width, 8));
+  h = std::max(2, sizeOr(params.height, 8));
+  d = std::max(2, sizeOr(params.depth, 8));
+}
+
+template <typename T> T jellySpringCount(int w, int h, int d) {
+  T springs = 0;
+  for (auto const &o : JELLY_OFFSETS)
+    springs += latticeSpringCount<T>(w, h, d, o[0], o[1], o[2]);
+  return springs;
+}
+
+typedef void (*SceneBuilder)(ParticleSystem &, SceneParams const &);
+typedef void (*SceneCounter)(SceneParams const &, double &masses,
+                             double &springs);
+
+void buildMassOnSpringScene(ParticleSystem &system, SceneParams const &) {
+  buildMassOnSpring(system);
+}
+
+void countMassOnSpring(SceneParams const &, double &masses, double &springs) {
+  masses = 2;
+  springs = 1;
+}
+
+void countCloth(SceneParams const &params, double &masses, double &springs) {
+  int w, h;
+  clothSize(params, w, h);
+  masses = double(w) * h;
+  springs = clothSpringCount<double>(w, h);
+}
+
+void countClothRope(SceneParams const &params, double &masses,
+                    double &springs) {
+  countCloth(params, masses, springs);
+  int const links = sizeOr(params.depth, 16);
+  masses += links;
+  springs += links;
+}
+
+void countChain(SceneParams const &params, double &masses, double &springs) {
+  int const links = std::max(2, sizeOr(params.width, 32));
+  int const chains = sizeOr(params.height, 1);
+  masses = double(links) * chains;
+  springs = double(links - 1) * chains;
+}
+
+void countJelly(SceneParams const &params, double &masses, double &springs) {
+  int w, h, d;
+  jellySize(params, w, h, d);
+  masses = double(w) * h * d;
+  springs = jellySpringCount<double>(w, h, d);
+}
+
+struct SceneEntry {
+  char const *name;
+  SceneBuilder build;
+  SceneCounter count;
+};
+
+SceneEntry const SCENES[] = {
+    {"spring", buildMassOnSpringScene, countMassOnSpring},
+    {"cloth", buildCloth, countCloth},
+    {"chain", buildChain, countChain},
+    {"jelly", buildJelly, countJelly},
+    {"rope", buildClothRope, countClothRope},
+};
+
+SceneEntry const *findScene(std::string const &name) {
+  for (auto const &scene : SCENES) {
+    if (name == scene.name)
+      return &scene;
+  }
+  return nullptr;
+}
+
+} // namespace
+
+void buildMassOnSpring(ParticleSystem &system) {
+  system.clear();
+
+  // the top mass is the fixed anchor the other one hangs from
+  int massA = system.addMass(Mass(0.f, Vec3f(0, 20, 0)));
+  int massB = system.addMass(Mass(100.f, Vec3f(0, 0, 0)));
+  system.addSpring(Spring(500.f, massA, massB, 20.0f));
+}
+
+void buildCloth(ParticleSystem &system, SceneParams const &params) {
+  int w, h;
+  clothSize(params, w, h);
+  float const s = params.spacing;
+  float const k = params.stiffness;
+
+  system.clear();
+  system.reserve(size_t(w) * h, clothSpringCount<size_t>(w, h));
+  system.setDamping(params.damping);
+
+  // in the xy plane, centered on x and hanging down from y = h * s / 2
+  Vec3f const origin(-0.5f * (w - 1) * s, 0.5f * h * s, 0.f);
+  for (int r = 0; r < h; ++r) {
+    for (int c = 0; c < w; ++c) {
+      bool pinned = r == 0 && (c == 0 || c == w - 1);
+      system.addMass(pinned ? 0.f : params.mass,
+                     origin + Vec3f(c * s, -r * s, 0.f));
+    }
+  }
+
+  for (int r = 0; r < h; ++r) {
+    for (int c = 0; c < w; ++c) {
+      int i = r * w + c;
+      // structural
+      if (c + 1 < w)
+        system.addSpring(i, i + 1, k, s);
+      if (r + 1 < h)
+        system.addSpring(i, i + w, k, s);
+      // shear
+      if (c + 1 < w && r + 1 < h) {
+        system.addSpring(i, i + w + 1, k, s * std::sqrt(2.f));
+        system.addSpring(i + 1, i + w, k, s * std::sqrt(2.f));
+      }
+      // bend
+      if (c + 2 < w)
+        system.addSpring(i, i + 2, k, 2.f * s);
+      if (r + 2 < h)
+        system.addSpring(i, i + 2 * w, k, 2.f * s);
+    }
+  }
+}
+
+void buildClothRope(ParticleSystem &system, SceneParams const &params) {
+  buildCloth(system, params);
+
+  int w, h;
+  clothSize(params, w, h);
+  int const links = sizeOr(params.depth, 16);
+  float const s = params.spacing;
+  float const k = params.stiffness * ROPE_STIFFNESS;
+
+  system.reserve(size_t(w) * h + links, system.springCount() + links);
+
+  // from the middle of the bottom edge, straight out of the cloth
+  int prev = (h - 1) * w + w / 2;
+  Vec3f const start = system.positions()[prev];
+  for (int link = 1; link <= links; ++link) {
+    int i = system.addMass(params.mass, start + Vec3f(0.f, 0.f, link * s));
+    system.addSpring(prev, i, k, s);
+    prev = i;
+  }
+}
+
+void buildChain(ParticleSystem &system, SceneParams const &params) {
+  int const links = std::max(2, sizeOr(params.width, 32));
+  int const chains = sizeOr(params.height, 1);
+  float const s = params.spacing;
+
+  system.clear();
+  system.reserve(size_t(links) * chains, size_t(links - 1) * chains);
+  system.setDamping(params.damping);
+
+  // chains start side by side along z, their anchors on the y axis
+  float const top = 0.5f * (links - 1) * s;
+  for (int chain = 0; chain < chains; ++chain) {
+    Vec3f const anchor(-0.5f * (links - 1) * s, top,
+                       (chain - 0.5f * (chains - 1)) * s);
+    system.addMass(0.f, anchor);
+    for (int link = 1; link < links; ++link) {
+      int i = system.addMass(params.mass, anchor + Vec3f(link * s, 0.f, 0.f));
+      system.addSpring(i - 1, i, params.stiffness, s);
+    }
+  }
+}
+
+void buildJelly(ParticleSystem &system, SceneParams const &params) {
+  int w, h, d;
+  jellySize(params, w, h, d);
+  float const s = params.spacing;
+
+  system.clear();
+  system.reserve(size_t(w) * h * d, jellySpringCount<size_t>(w, h, d));
+  system.setDamping(params.damping);
+
+  Vec3f const origin = Vec3f(w - 1, h - 1, d - 1) * (-0.5f * s);
+  for (int z = 0; z < d; ++z) {
+    for (int y = 0; y < h; ++y) {
+      for (int x = 0; x < w; ++x)
+        system.addMass(params.mass, origin + Vec3f(x, y, z) * s);
+    }
+  }
+
+  for (int z = 0; z < d; ++z) {
+    for (int y = 0; y < h; ++y) {
+      for (int x = 0; x < w; ++x) {
+        int i = (z * h + y) * w + x;
+        for (auto const &o : JELLY_OFFSETS) {
+          int nx = x + o[0], ny = y + o[1], nz = z + o[2];
+          if (nx < 0 || nx >= w || ny < 0 || ny >= h || nz < 0 || nz >= d)
+            continue;
+          int j = (nz * h + ny) * w + nx;
+          float rest = s * std::sqrt(float(o[0] * o[0] + o[1] * o[1] +
+                                           o[2] * o[2]));
+          system.addSpring(i, j, params.stiffness, rest);
+        }
+      }
+    }
+  }
+}
+
+bool sceneCounts(std::string const &name, SceneParams const &params,
+                 double &masses, double &springs) {
+  SceneEntry const *scene = findScene(name);
+  if (!scene)
+    return false;
+  scene->count(params, masses, springs);
+  return true;
+}
+
+bool sceneFits(double masses, double springs) {
+  return masses <= double(MAX_SCENE_COUNT) &&
+         springs <= double(MAX_SCENE_COUNT);
+}
+
+bool buildScene(std::string const &name, ParticleSystem &system,
+                SceneParams const &params) {
+  SceneEntry const *scene = findScene(name);
+  if (!scene)
+    return false;
+
+  // the generators index masses and springs with int
+  double masses = 0, springs = 0;
+  scene->count(params, masses, springs);
+  if (!sceneFits(masses, springs)) {
+    std::cerr << "The " << name << " scene of " << masses << " masses and "
+              << springs << " springs is too large, at most "
+              << MAX_SCENE_COUNT << " of each" << std::endl;
+    return false;
+  }
+
+  scene->build(system, params);
+  return true;
+}
+
+std::vector<std::string> sceneNames() {
+  std::vector<std::string> names;
+  for (auto const &scene : SCENES)
+    names.push_back(scene.name);
+  return names;
+}
@@ -0,0 +1,75 @@
+//
+//  Scenes.h
+//
+//	Builders for the initial state of each simulation scene. The viewer and
+//	the headless driver both pick a scene by name from here.
+//
+//	The generated scenes (cloth, rope, chain, jelly) are sized by SceneParams and
+//	reserve their exact mass and spring counts up front, so building one
+//	with millions of masses takes linear time and a single allocation per
+//	array.
+
+#ifndef SCENES_H
+#define SCENES_H
+
+#include <climits>
+#include <string>
+#include <vector>
+
+#include "ParticleSystem.h"
+
+struct SceneParams {
+  SceneParams()
+      : width(0), height(0), depth(0), spacing(1.f), mass(0.1f),
+        stiffness(100.f), damping(0.1f) {}
+
+  // masses along each axis, 0 picks the scene's default
+  int width;
+  int height;
+  int depth;
+  float spacing; // rest distance between neighbouring masses
+  float mass;    // of every free mass
+  float stiffness;
+  float damping;
+};
+
+// Sets up the initial scene of a mass on a spring
+void buildMassOnSpring(ParticleSystem &system);
+
+// Hanging width x height cloth with structural, shear and bend springs,
+// pinned at its two top corners (default 32 x 32)
+void buildCloth(ParticleSystem &system, SceneParams const &params);
+
+// The cloth of buildCloth() with a rope of depth masses (default 16) a
+// thousand times stiffer than the cloth hanging from the middle of its
+// bottom edge, for the multi-rate integrator
+void buildClothRope(ParticleSystem &system, SceneParams const &params);
+
+// height chains of width masses each, starting out horizontal from a fixed
+// first mass (default 32 x 1)
+void buildChain(ParticleSystem &system, SceneParams const &params);
+
+// Free falling width x height x depth lattice, every mass connected to its
+// 26 neighbours (default 8 x 8 x 8)
+void buildJelly(ParticleSystem &system, SceneParams const &params);
+
+// Most masses, and most springs, a generated scene may have: the builders
+// and ParticleSystem index both with int
+size_t const MAX_SCENE_COUNT = INT_MAX;
+
+// Masses and springs the named scene would have, false if there is no
+// scene by that name. Doubles, as the sizes allowed on the command line
+// can multiply out to more than a size_t holds.
+bool sceneCounts(std::string const &name, SceneParams const &params,
+                 double &masses, double &springs);
+// Neither count is above MAX_SCENE_COUNT
+bool sceneFits(double masses, double springs);
+
+// Clears the system and fills it with the named scene, returns false if
+// there is no scene by that name or it would not fit (printed to
+// std::cerr), leaving the system as it was
+bool buildScene(std::string const &name, ParticleSystem &system,
+                SceneParams const &params = SceneParams());
+std::vector<std::string> sceneNames();
+
+#endif // SCENES_H
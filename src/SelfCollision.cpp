@@ -0,0 +1,219 @@
+#include "SelfCollision.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// buckets per prefix sum block
+size_t const SCAN_BLOCK = 16384;
+
+int cellCoord(float x, float invCell) {
+  return static_cast<int>(std::floor(x * invCell));
+}
+
+} // namespace
+
+// ======== CONSTRUCTORS ====================================================//
+SelfCollision::SelfCollision() : m_radius(0.f), m_pairs(0), m_bucketCount(0) {}
+// ==========================================================================//
+
+unsigned SelfCollision::rowHash(int y, int z) const {
+  return unsigned(y) * 73856093u ^ unsigned(z) * 19349663u;
+}
+
+uint64_t SelfCollision::rowKey(int y, int z) {
+  return uint64_t(unsigned(y)) | uint64_t(unsigned(z)) << 32;
+}
+
+bool SelfCollision::apply(ParticleSystem &system, float dt, ThreadPool &pool) {
+  m_pairs = 0;
+  size_t const count = system.massCount();
+  if (!enabled() || count < 2)
+    return false;
+
+  buildGrid(system, pool);
+
+  m_correction.resize(count);
+  // every pair is seen from both of its masses
+  m_pairs = size_t(pool.parallelSum(count, [&](size_t begin, size_t end) {
+              return double(gatherCorrections(system, begin, end));
+            })) /
+            2;
+  if (m_pairs == 0)
+    return false;
+
+  Vec3f *pos = system.positions();
+  Vec3f *vel = system.velocities();
+  float const invDt = 1.f / dt;
+  pool.parallelFor(count, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      pos[i] += m_correction[i];
+      vel[i] += m_correction[i] * invDt;
+    }
+  });
+
+  return true;
+}
+
+void SelfCollision::buildGrid(ParticleSystem const &system, ThreadPool &pool) {
+  size_t const count = system.massCount();
+  Vec3f const *pos = system.positions();
+  float const invCell = 1.f / m_radius;
+
+  // power of two of at least twice the masses, few unrelated cells share
+  size_t buckets = 1;
+  while (buckets < 2 * count)
+    buckets *= 2;
+  if (buckets != m_bucketCount) {
+    m_bucketCount = buckets;
+    m_count.reset(new std::atomic<unsigned>[buckets]);
+    m_start.resize(buckets + 1);
+  }
+
+  m_cell.resize(count);
+  m_bucket.resize(count);
+  m_sorted.resize(count);
+
+  pool.parallelFor(m_bucketCount, [&](size_t begin, size_t end) {
+    for (size_t b = begin; b < end; ++b)
+      m_count[b].store(0, std::memory_order_relaxed);
+  });
+
+  pool.parallelFor(count, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      int x = cellCoord(pos[i].x(), invCell);
+      int y = cellCoord(pos[i].y(), invCell);
+      int z = cellCoord(pos[i].z(), invCell);
+      unsigned b = (rowHash(y, z) + unsigned(x)) & unsigned(m_bucketCount - 1);
+      m_cell[i].row = rowKey(y, z);
+      m_cell[i].x = x;
+      m_bucket[i] = b;
+      m_count[b].fetch_add(1, std::memory_order_relaxed);
+    }
+  });
+
+  // exclusive prefix sum of the counts: block totals in parallel, a short
+  // serial scan over the blocks, then every block offsets its own buckets
+  size_t const blocks = (m_bucketCount + SCAN_BLOCK - 1) / SCAN_BLOCK;
+  std::vector<unsigned> blockStart(blocks + 1, 0);
+  pool.parallelFor(
+      blocks,
+      [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; ++k) {
+          size_t last = std::min(m_bucketCount, (k + 1) * SCAN_BLOCK);
+          unsigned sum = 0;
+          for (size_t b = k * SCAN_BLOCK; b < last; ++b)
+            sum += m_count[b].load(std::memory_order_relaxed);
+          blockStart[k + 1] = sum;
+        }
+      },
+      1);
+  for (size_t k = 0; k < blocks; ++k)
+    blockStart[k + 1] += blockStart[k];
+
+  pool.parallelFor(
+      blocks,
+      [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; ++k) {
+          size_t last = std::min(m_bucketCount, (k + 1) * SCAN_BLOCK);
+          unsigned offset = blockStart[k];
+          for (size_t b = k * SCAN_BLOCK; b < last; ++b) {
+            m_start[b] = offset;
+            offset += m_count[b].load(std::memory_order_relaxed);
+            // from here on the count is the bucket's next free slot
+            m_count[b].store(m_start[b], std::memory_order_relaxed);
+          }
+        }
+      },
+      1);
+  m_start[m_bucketCount] = unsigned(count);
+
+  pool.parallelFor(count, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      unsigned slot =
+          m_count[m_bucket[i]].fetch_add(1, std::memory_order_relaxed);
+      m_sorted[slot] = unsigned(i);
+    }
+  });
+
+  // the scatter order depends on the threads, the sorted buckets do not
+  pool.parallelFor(m_bucketCount, [&](size_t begin, size_t end) {
+    for (size_t b = begin; b < end; ++b) {
+      if (m_start[b + 1] - m_start[b] > 1)
+        std::sort(m_sorted.begin() + m_start[b],
+                  m_sorted.begin() + m_start[b + 1]);
+    }
+  });
+}
+
+size_t SelfCollision::gatherCorrections(ParticleSystem const &system,
+                                        size_t begin, size_t end) {
+  Vec3f const *pos = system.positions();
+  float const invCell = 1.f / m_radius;
+  unsigned const mask = unsigned(m_bucketCount - 1);
+  unsigned const *start = m_start.data();
+
+  size_t pairs = 0;
+  for (size_t i = begin; i < end; ++i) {
+    Vec3f correction;
+    int cx = cellCoord(pos[i].x(), invCell);
+    int cy = cellCoord(pos[i].y(), invCell);
+    int cz = cellCoord(pos[i].z(), invCell);
+
+    for (int dz = -1; dz <= 1; ++dz) {
+      for (int dy = -1; dy <= 1; ++dy) {
+        uint64_t row = rowKey(cy + dy, cz + dz);
+        // buckets of cells cx - 1 .. cx + 1, they only wrap around at the
+        // end of the table
+        unsigned first = (rowHash(cy + dy, cz + dz) + unsigned(cx - 1)) & mask;
+        unsigned last = first + 3;
+        if (last <= m_bucketCount) {
+          pairs += gatherRange(system, i, row, cx - 1, start[first],
+                               start[last], correction);
+        } else {
+          pairs += gatherRange(system, i, row, cx - 1, start[first],
+                               start[m_bucketCount], correction);
+          pairs += gatherRange(system, i, row, cx - 1, start[0],
+                               start[last - m_bucketCount], correction);
+        }
+      }
+    }
+    m_correction[i] = correction;
+  }
+  return pairs;
+}
+
+// Adds the corrections of mass i against the masses of m_sorted[begin, end)
+// that lie in the cells firstX .. firstX + 2 of the row. Buckets also hold
+// masses of other cells, and rows may share buckets, so masses of any other
+// cell are skipped (no pair is counted twice).
+size_t SelfCollision::gatherRange(ParticleSystem const &system, unsigned i,
+                                  uint64_t row, int firstX, unsigned begin,
+                                  unsigned end, Vec3f &correction) const {
+  Vec3f const *pos = system.positions();
+  float const *invMass = system.inverseMasses();
+  float const radius = m_radius;
+
+  size_t pairs = 0;
+  for (unsigned k = begin; k < end; ++k) {
+    unsigned j = m_sorted[k];
+    Cell const &cell = m_cell[j];
+    if (j == i || cell.row != row || unsigned(cell.x - firstX) > 2u)
+      continue;
+
+    Vec3f d = pos[i] - pos[j];
+    float dist2 = d * d;
+    if (dist2 >= radius * radius || dist2 == 0.f)
+      continue;
+    ++pairs;
+
+    float w = invMass[i] + invMass[j];
+    if (w == 0.f)
+      continue;
+
+    float dist = std::sqrt(dist2);
+    correction += d * ((radius - dist) / dist * invMass[i] / w);
+  }
+  return pairs;
+}
@@ -0,0 +1,83 @@
+//
+//  SelfCollision.h
+//
+//	Keeps masses at least radius() apart, so cloth cannot pass through
+//	itself.
+//
+//	Every step the masses are binned into a uniform grid of radius sized
+//	cells, hashed into a table about twice the mass count. The table is
+//	built with a parallel counting sort: atomic counts per bucket, a
+//	parallel prefix sum and an atomic scatter, after which every bucket is
+//	sorted by mass index so the layout does not depend on the threads. A
+//	mass can only touch masses in the 27 cells around its own, so finding
+//	all close pairs is O(n).
+//
+//	Only the y and z of a cell are hashed and x is added on, so the three
+//	cells of a row sit in neighbouring buckets and are read as one
+//	contiguous range: 9 ranges per mass instead of 27 scattered lookups.
+//
+//	Overlaps are resolved by position correction, each pair pushed apart
+//	along the line between them, split by inverse mass. Every mass gathers
+//	its own correction from all of its pairs (Jacobi style), so the masses
+//	can be handled in parallel without races and the result is the same
+//	for any thread count. The velocity changes by correction / dt, which
+//	takes out the approaching speed.
+
+#ifndef SELF_COLLISION_H
+#define SELF_COLLISION_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "ParticleSystem.h"
+#include "ThreadPool.h"
+
+class SelfCollision {
+public:
+  SelfCollision();
+
+  // Returns whether any mass was moved
+  bool apply(ParticleSystem &system, float dt, ThreadPool &pool);
+
+  // 0 turns self collision off
+  float radius() const { return m_radius; }
+  void setRadius(float radius) { m_radius = radius; }
+  bool enabled() const { return m_radius > 0.f; }
+
+  // Close pairs found by the last apply(), each counted once
+  size_t lastPairCount() const { return m_pairs; }
+
+private:
+  void buildGrid(ParticleSystem const &system, ThreadPool &pool);
+  size_t gatherCorrections(ParticleSystem const &system, size_t begin,
+                           size_t end);
+  unsigned rowHash(int y, int z) const;
+  static uint64_t rowKey(int y, int z);
+  size_t gatherRange(ParticleSystem const &system, unsigned i, uint64_t row,
+                     int firstX, unsigned begin, unsigned end,
+                     Vec3f &correction) const;
+
+private:
+  float m_radius;
+  size_t m_pairs;
+
+  // cell and bucket of every mass, and the masses sorted by bucket
+  struct Cell {
+    uint64_t row; // y and z
+    int x;
+  };
+  std::vector<Cell> m_cell;
+  std::vector<unsigned> m_bucket;
+  std::vector<unsigned> m_sorted;
+  // masses of bucket b are m_sorted[m_start[b]] .. m_sorted[m_start[b + 1]]
+  std::vector<unsigned> m_start;
+  std::unique_ptr<std::atomic<unsigned>[]> m_count;
+  size_t m_bucketCount;
+
+  std::vector<Vec3f> m_correction;
+};
+
+#endif // SELF_COLLISION_H
@@ -0,0 +1,50 @@
+#include "SimClock.h"
+
+#include <algorithm>
+#include <cassert>
+
+// ======================== CONSTRUCTORS ============================//
+SimClock::SimClock(float stepSize, int maxSteps)
+    : m_stepSize(stepSize), m_maxSteps(std::max(maxSteps, 1)),
+      m_accumulator(0), m_time(0), m_dropped(0) {
+  assert(stepSize > 0.f);
+}
+// ==========================================================================//
+
+int SimClock::advance(double wallSeconds) {
+  if (wallSeconds > 0)
+    m_accumulator += wallSeconds;
+
+  int steps = int(m_accumulator / m_stepSize);
+  if (steps > m_maxSteps) {
+    // can't catch up, keep only the partial step so alpha stays smooth
+    double keep = m_accumulator - steps * double(m_stepSize);
+    m_dropped += m_accumulator - keep - m_maxSteps * double(m_stepSize);
+    m_accumulator = keep + m_maxSteps * double(m_stepSize);
+    steps = m_maxSteps;
+  }
+
+  m_accumulator -= steps * double(m_stepSize);
+  m_time += steps * double(m_stepSize);
+  return steps;
+}
+
+void SimClock::reset() { m_accumulator = 0; }
+
+void SimClock::restore(double accumulator, double time, double droppedTime) {
+  m_accumulator = accumulator;
+  m_time = time;
+  m_dropped = droppedTime;
+}
+
+float SimClock::alpha() const {
+  float a = float(m_accumulator / m_stepSize);
+  return std::min(std::max(a, 0.f), 1.f);
+}
+
+void SimClock::setStepSize(float stepSize) {
+  assert(stepSize > 0.f);
+  m_stepSize = stepSize;
+}
+
+void SimClock::setMaxSteps(int maxSteps) { m_maxSteps = std::max(maxSteps, 1); }
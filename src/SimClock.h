@@ -0,0 +1,52 @@
+//
+//  SimClock.h
+//
+//	Fixed time step clock for real time playback.
+//
+//	Wall clock time is collected in an accumulator and spent in whole steps
+//	of stepSize(), so the simulation always advances by the same dt no
+//	matter the frame rate. At most maxSteps() are taken per advance(), any
+//	time beyond that is dropped so a slow frame can't make the next one
+//	even slower (spiral of death). The time left in the accumulator, as a
+//	fraction of a step, is the alpha to interpolate the displayed state
+//	between the last two steps.
+
+#ifndef SIM_CLOCK_H
+#define SIM_CLOCK_H
+
+class SimClock {
+public:
+  explicit SimClock(float stepSize = 0.001f, int maxSteps = 64);
+
+  // Adds wallSeconds of elapsed time, returns how many steps to take now
+  int advance(double wallSeconds);
+  // Forget any time not yet simulated, e.g. after pausing
+  void reset();
+
+  // Fraction of a step still in the accumulator, in [0, 1)
+  float alpha() const;
+
+  float stepSize() const { return m_stepSize; }
+  void setStepSize(float stepSize);
+  int maxSteps() const { return m_maxSteps; }
+  void setMaxSteps(int maxSteps);
+
+  // Simulated time covered by all steps handed out so far
+  double time() const { return m_time; }
+  // Wall time thrown away because a frame needed more than maxSteps()
+  double droppedTime() const { return m_dropped; }
+  // Wall time not yet spent on a step
+  double accumulator() const { return m_accumulator; }
+  // Picks up from a checkpoint of the values above
+  void restore(double accumulator, double time, double droppedTime);
+
+private:
+  float m_stepSize;
+  int m_maxSteps;
+
+  double m_accumulator;
+  double m_time;
+  double m_dropped;
+};
+
+#endif // SIM_CLOCK_H
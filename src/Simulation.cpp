@@ -0,0 +1,142 @@
+#include "Simulation.h"
+
+#include <algorithm>
+
+namespace {
+
+// how quickly a dragged mass follows its target, in radians per second
+float const DRAG_FREQUENCY = 20.f;
+
+} // namespace
+
+// ======================== CONSTRUCTORS ============================//
+Simulation::Simulation(ParticleSystem &system, int threadCount)
+    : m_system(system), m_pool(threadCount),
+      m_integrator(IntegratorType::SymplecticEuler), m_forcesValid(false),
+      m_forcesTopology(0), m_time(0), m_steps(0), m_dragMass(-1) {}
+// ==========================================================================//
+
+void Simulation::setThreadCount(int threadCount) {
+  m_pool.resize(threadCount);
+}
+
+int Simulation::threadCount() const { return m_pool.threadCount(); }
+
+void Simulation::setIntegrator(IntegratorType type) {
+  m_integrator = type;
+  m_forcesValid = false;
+}
+
+void Simulation::restore(double time, unsigned long steps,
+                         bool forcesValid) {
+  m_time = time;
+  m_steps = steps;
+  m_forcesValid = forcesValid;
+  m_forcesTopology = m_system.topologyVersion();
+}
+
+void Simulation::setDrag(int mass, Vec3f const &target) {
+  m_dragMass = mass;
+  m_dragTarget = target;
+}
+
+// The pull is integrated implicitly on its own, so it is stable for any
+// time step however stiff, and is added to the velocity before the step
+void Simulation::applyDrag(float dt) {
+  if (m_dragMass < 0 || size_t(m_dragMass) >= m_system.massCount())
+    return;
+
+  Vec3f &pos = m_system.positions()[m_dragMass];
+  if (m_system.inverseMasses()[m_dragMass] == 0.f) {
+    pos = m_dragTarget;
+    m_forcesValid = false;
+    return;
+  }
+
+  // x'' = w^2 (target - x) - 2 w x', backward Euler for the velocity
+  Vec3f &vel = m_system.velocities()[m_dragMass];
+  float const w = DRAG_FREQUENCY;
+  vel = (vel + (m_dragTarget - pos) * (w * w * dt)) /
+        (1.f + 2.f * w * dt + w * w * dt * dt);
+}
+
+void Simulation::prepare() { m_colors.update(m_system); }
+
+float Simulation::nextStepSize(float fixedDt) {
+  return m_stepControl.enabled() ? m_stepControl.next(m_system, m_integrator)
+                                 : fixedDt;
+}
+
+void Simulation::step(float dt) {
+  // may reorder the springs, so before anything looks at the topology
+  m_colors.update(m_system);
+
+  if (m_forcesTopology != m_system.topologyVersion()) {
+    m_forcesTopology = m_system.topologyVersion();
+    m_forcesValid = false;
+  }
+
+  applyDrag(dt);
+
+  switch (m_integrator) {
+  case IntegratorType::ExplicitEuler:
+    explicitEulerStep(m_system, dt, m_colors, m_pool);
+    break;
+  case IntegratorType::SymplecticEuler:
+    symplecticEulerStep(m_system, dt, m_colors, m_pool);
+    break;
+  case IntegratorType::VelocityVerlet:
+    velocityVerletStep(m_system, dt, m_colors, m_pool,
+                       m_forcesValid);
+    break;
+  case IntegratorType::BackwardEuler:
+    m_implicit.step(m_system, dt, m_pool);
+    break;
+  case IntegratorType::XPBD:
+    m_xpbd.step(m_system, dt, m_colors, m_pool);
+    break;
+  case IntegratorType::MultiRate:
+    m_multiRate.step(m_system, dt, m_colors, m_pool, m_forcesValid);
+    break;
+  }
+  // only Verlet and multi-rate leave the forces at the new positions behind
+  m_forcesValid = m_integrator == IntegratorType::VelocityVerlet ||
+                  m_integrator == IntegratorType::MultiRate;
+
+  // moved masses make those forces stale
+  if (m_collision.apply(m_system, dt, m_pool))
+    m_forcesValid = false;
+  // last, so nothing ends up inside the environment
+  if (m_obstacles.apply(m_system, dt, m_pool))
+    m_forcesValid = false;
+
+  // a dragged mass is given energy, which is not the step's doing
+  if (m_stepControl.enabled())
+    m_stepControl.observe(m_system, dt, m_integrator, m_dragMass >= 0,
+                          m_pool);
+
+  m_time += dt;
+  ++m_steps;
+}
+
+void Simulation::storePreviousState() {
+  Vec3f const *pos = m_system.positions();
+  m_prevPos.assign(pos, pos + m_system.massCount());
+}
+
+void Simulation::interpolatePositions(float alpha, Vec3f *out) {
+  Vec3f const *pos = m_system.positions();
+  size_t count = m_system.massCount();
+
+  // nothing to blend from, e.g. the scene was just rebuilt
+  if (m_prevPos.size() != count) {
+    std::copy(pos, pos + count, out);
+    return;
+  }
+
+  Vec3f const *prev = m_prevPos.data();
+  m_pool.parallelFor(count, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i)
+      out[i] = prev[i] + (pos[i] - prev[i]) * alpha;
+  });
+}
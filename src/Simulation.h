@@ -0,0 +1,117 @@
+//
+//  Simulation.h
+//
+//	Advances a ParticleSystem through time. Holds everything a step needs
+//	besides the particle data itself (worker threads, elapsed time), so the
+//	same stepping code runs in the viewer and in headless runs.
+
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <vector>
+
+#include "ParticleSystem.h"
+#include "ThreadPool.h"
+#include "Integrator.h"
+#include "BackwardEuler.h"
+#include "SpringColoring.h"
+#include "XPBD.h"
+#include "MultiRate.h"
+#include "SelfCollision.h"
+#include "Obstacles.h"
+#include "StepController.h"
+
+class Simulation {
+public:
+  explicit Simulation(ParticleSystem &system, int threadCount = 1);
+
+  void step(float dt);
+  // Builds what step() derives from the topology (the spring coloring may
+  // reorder the springs) now, so stepping on another thread afterwards
+  // leaves the topology alone
+  void prepare();
+
+  IntegratorType integrator() const { return m_integrator; }
+  void setIntegrator(IntegratorType type);
+  BackwardEulerSolver &implicitSolver() { return m_implicit; }
+  BackwardEulerSolver const &implicitSolver() const { return m_implicit; }
+  XPBDSolver &xpbdSolver() { return m_xpbd; }
+  XPBDSolver const &xpbdSolver() const { return m_xpbd; }
+  MultiRateSolver &multiRateSolver() { return m_multiRate; }
+  MultiRateSolver const &multiRateSolver() const { return m_multiRate; }
+  // Applied after every step, off until given a radius
+  SelfCollision &selfCollision() { return m_collision; }
+  SelfCollision const &selfCollision() const { return m_collision; }
+  // Static geometry masses collide with after every step, add meshes
+  // before stepping starts
+  Obstacles &obstacles() { return m_obstacles; }
+  Obstacles const &obstacles() const { return m_obstacles; }
+  // Picks the step size from the motion, off until enabled
+  StepController &stepControl() { return m_stepControl; }
+  StepController const &stepControl() const { return m_stepControl; }
+  // The step size the controller picks for the next step, fixedDt if it
+  // is off
+  float nextStepSize(float fixedDt);
+  // Call after changing positions or spring parameters outside of step()
+  void invalidateForces() {
+    m_forcesValid = false;
+    m_multiRate.invalidate();
+    m_stepControl.invalidate();
+  }
+
+  // Pulls one mass towards target every step as if by a stiff, critically
+  // damped spring, a pinned mass is moved there. A negative mass lets go.
+  void setDrag(int mass, Vec3f const &target);
+  int dragMass() const { return m_dragMass; }
+
+  // Remembers the current positions as the previous state, call it before
+  // the last step of a frame so the frame can be drawn in between
+  void storePreviousState();
+  // Writes lerp(previous, current, alpha) for every mass to out
+  void interpolatePositions(float alpha, Vec3f *out);
+
+  void setThreadCount(int threadCount);
+  int threadCount() const;
+
+  double time() const { return m_time; }
+  unsigned long stepCount() const { return m_steps; }
+  // Whether system().forces() are those at the current positions, for the
+  // integrators that reuse them
+  bool forcesValid() const { return m_forcesValid; }
+  // Picks up from a checkpoint of the values above, taken of a system with
+  // the topology the current one has
+  void restore(double time, unsigned long steps, bool forcesValid);
+
+  ParticleSystem &system() { return m_system; }
+  ParticleSystem const &system() const { return m_system; }
+
+private:
+  void applyDrag(float dt);
+
+private:
+  ParticleSystem &m_system;
+  ThreadPool m_pool;
+  IntegratorType m_integrator;
+  BackwardEulerSolver m_implicit;
+  XPBDSolver m_xpbd;
+  MultiRateSolver m_multiRate;
+  SelfCollision m_collision;
+  Obstacles m_obstacles;
+  StepController m_stepControl;
+  SpringColoring m_colors;
+
+  // system.forces() holds the forces at the current positions, only
+  // velocity Verlet and multi-rate reuse them
+  bool m_forcesValid;
+  unsigned m_forcesTopology;
+
+  std::vector<Vec3f> m_prevPos;
+
+  double m_time;
+  unsigned long m_steps;
+
+  int m_dragMass; // -1 if nothing is dragged
+  Vec3f m_dragTarget;
+};
+
+#endif // SIMULATION_H
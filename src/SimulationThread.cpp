@@ -0,0 +1,176 @@
+#include "SimulationThread.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+// how often a paused thread looks for play or stop
+std::chrono::milliseconds const PAUSED_POLL(5);
+
+} // namespace
+
+// ======== CONSTRUCTORS ====================================================//
+SimulationThread::SimulationThread(Simulation &simulation, SimClock &clock)
+    : m_simulation(simulation), m_clock(clock), m_recorder(nullptr),
+      m_checkpoints(nullptr), m_checkpointRequested(false), m_stop(false),
+      m_playing(false), m_dragMass(-1) {
+  setSnapshotBuffers(nullptr);
+}
+
+SimulationThread::~SimulationThread() { stop(); }
+// ==========================================================================//
+
+void SimulationThread::start() {
+  stop();
+
+  m_simulation.prepare();
+  // mass indices of the last scene mean nothing in this one
+  setDrag(-1, Vec3f());
+  m_simulation.setDrag(-1, Vec3f());
+  // and neither does what the step controller measured
+  m_simulation.stepControl().reset(m_clock.stepSize());
+
+  ParticleSystem const &system = m_simulation.system();
+  for (int b = 0; b < BUFFER_COUNT; ++b) {
+    if (m_external[b]) {
+      m_buffers[b] = m_external[b];
+    } else {
+      m_storage[b].resize(system.massCount());
+      m_buffers[b] = m_storage[b].data();
+    }
+  }
+
+  // every slot starts out as the current state, the reader's included
+  for (int i = 0; i < 3; ++i) {
+    Snapshot &s = m_snapshots.slot(i);
+    s.buffer = i;
+    s.positions = m_buffers[i];
+    std::copy(system.positions(), system.positions() + system.massCount(),
+              s.positions);
+    s.time = m_simulation.time();
+    s.steps = m_simulation.stepCount();
+  }
+  for (int r = 0; r < RETIRED_COUNT; ++r)
+    m_retired[r] = 3 + r;
+  if (m_recorder)
+    m_recorder->record(m_simulation.time(), system.positions());
+
+  m_stop = false;
+  m_thread = std::thread(&SimulationThread::run, this);
+}
+
+void SimulationThread::stop() {
+  if (!m_thread.joinable())
+    return;
+
+  m_stop = true;
+  m_thread.join();
+}
+
+void SimulationThread::setSnapshotBuffers(Vec3f *const *buffers) {
+  for (int b = 0; b < BUFFER_COUNT; ++b) {
+    m_external[b] = buffers ? buffers[b] : nullptr;
+    // the thread's own are not needed then
+    if (m_external[b])
+      std::vector<Vec3f>().swap(m_storage[b]);
+  }
+}
+
+void SimulationThread::setCheckpointWriter(CheckpointWriter *writer,
+                                           std::string const &path) {
+  m_checkpoints = writer;
+  m_checkpointPath = path;
+}
+
+void SimulationThread::setDrag(int mass, Vec3f const &target) {
+  std::lock_guard<std::mutex> lock(m_dragMutex);
+  m_dragMass = mass;
+  m_dragTarget = target;
+}
+
+void SimulationThread::run() {
+  Clock::time_point last = Clock::now();
+  bool wasPlaying = false;
+
+  while (!m_stop) {
+    Clock::time_point now = Clock::now();
+    double elapsed = std::chrono::duration<double>(now - last).count();
+    last = now;
+
+    // only the copy, the file is written on the writer's thread
+    if (m_checkpointRequested.exchange(false) && m_checkpoints) {
+      if (!m_checkpoints->save(m_checkpointPath, m_simulation, &m_clock))
+        std::cerr << "Still writing the last checkpoint" << std::endl;
+    }
+
+    bool playing = m_playing;
+    if (!playing) {
+      wasPlaying = false;
+      std::this_thread::sleep_for(PAUSED_POLL);
+      continue;
+    }
+
+    if (!wasPlaying) {
+      // resume from the paused state rather than blending back a step
+      m_clock.reset();
+      m_simulation.storePreviousState();
+      elapsed = 0;
+    }
+    wasPlaying = true;
+
+    {
+      std::lock_guard<std::mutex> lock(m_dragMutex);
+      m_simulation.setDrag(m_dragMass, m_dragTarget);
+    }
+
+    // simulated time follows the wall clock, in steps of the size the
+    // step controller picks (if on) for this batch
+    m_clock.setStepSize(m_simulation.nextStepSize(m_clock.stepSize()));
+    int steps = m_clock.advance(elapsed);
+    for (int i = 0; i < steps; ++i) {
+      if (i == steps - 1)
+        m_simulation.storePreviousState();
+      m_simulation.step(m_clock.stepSize());
+      if (m_recorder) {
+        m_recorder->record(m_simulation.time(),
+                           m_simulation.system().positions());
+      }
+    }
+    if (steps > 0)
+      publish();
+
+    // nothing to do until the next step is due
+    double wait = (1.f - m_clock.alpha()) * m_clock.stepSize();
+    std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+  }
+}
+
+bool SimulationThread::update() {
+  if (!m_snapshots.hasUpdate())
+    return false;
+
+  // the buffer drawn until now retires, the one retired longest goes back
+  // to the simulation thread in its place
+  Snapshot &front = m_snapshots.front();
+  int drawn = front.buffer;
+  front.buffer = m_retired[0];
+  front.positions = m_buffers[front.buffer];
+  for (int r = 0; r + 1 < RETIRED_COUNT; ++r)
+    m_retired[r] = m_retired[r + 1];
+  m_retired[RETIRED_COUNT - 1] = drawn;
+
+  return m_snapshots.update();
+}
+
+void SimulationThread::publish() {
+  Snapshot &s = m_snapshots.back();
+  m_simulation.interpolatePositions(m_clock.alpha(), s.positions);
+  s.time = m_simulation.time();
+  s.steps = m_simulation.stepCount();
+
+  m_snapshots.publish();
+}
@@ -0,0 +1,127 @@
+//
+//  SimulationThread.h
+//
+//	Runs a Simulation in real time on a thread of its own, so a slow frame
+//	does not hold up the physics and a slow step does not hold up input and
+//	drawing. Every batch of steps is published as a Snapshot through a
+//	TripleBuffer; the render thread picks up the newest one without ever
+//	waiting on the simulation.
+//
+//	Snapshot positions are written into one of BUFFER_COUNT buffers, which
+//	setSnapshotBuffers() can place in memory the GPU draws from (the
+//	viewer's persistently mapped StreamingBuffer regions), so the positions
+//	are interpolated straight into GL memory and never copied. The GPU
+//	still reads a snapshot for a while after the render thread moved on, so
+//	update() does not hand its buffer straight back to be written again:
+//	it retires behind RETIRED_COUNT others, and the render thread checks
+//	that the oldest retired one, retiringBuffer(), is no longer read before
+//	calling update(). Three buffers circulate in the triple buffer, the
+//	retired ones wait outside of it.
+//
+//	While the thread runs it owns the simulation, its ParticleSystem and the
+//	clock. The topology must stay fixed in that time (Simulation::prepare()
+//	is called before the thread starts), so the render thread may still read
+//	spring ends and rest lengths. Anything else goes through stop().
+//
+//	With the simulation's step controller on, the clock's step size is set
+//	to the controller's pick before every batch of steps.
+//
+//	A TrajectoryWriter given to setRecorder() is offered the state after
+//	every step (and the first one), on the simulation thread. A checkpoint
+//	asked for with requestCheckpoint() is handed to the CheckpointWriter
+//	between two batches of steps, also on the simulation thread.
+
+#ifndef SIMULATION_THREAD_H
+#define SIMULATION_THREAD_H
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Checkpoint.h"
+#include "Simulation.h"
+#include "SimClock.h"
+#include "Trajectory.h"
+#include "TripleBuffer.h"
+#include "Vec3f.h"
+
+class SimulationThread {
+public:
+  enum { RETIRED_COUNT = 2, BUFFER_COUNT = 3 + RETIRED_COUNT };
+
+  struct Snapshot {
+    Snapshot() : positions(nullptr), buffer(0), time(0), steps(0) {}
+
+    // one per mass, blended between the last two steps like
+    // SimClock::alpha() says
+    Vec3f *positions;
+    int buffer; // which of the BUFFER_COUNT positions is
+    double time;
+    unsigned long steps;
+  };
+
+public:
+  SimulationThread(Simulation &simulation, SimClock &clock);
+  ~SimulationThread();
+
+  SimulationThread(SimulationThread const &) = delete;
+  SimulationThread &operator=(SimulationThread const &) = delete;
+
+  // The current state becomes the first snapshot
+  void start();
+  void stop();
+  bool isRunning() const { return m_thread.joinable(); }
+
+  // Steps are only taken while playing, time spent paused is not caught up
+  void setPlaying(bool playing) { m_playing = playing; }
+  bool isPlaying() const { return m_playing; }
+
+  // Only while stopped: BUFFER_COUNT buffers of a position per mass of the
+  // scene start() is called for, nullptr for buffers of the thread's own
+  void setSnapshotBuffers(Vec3f *const *buffers);
+
+  // Only while stopped, nullptr records nothing
+  void setRecorder(TrajectoryWriter *recorder) { m_recorder = recorder; }
+  // Only while stopped, nullptr saves nothing
+  void setCheckpointWriter(CheckpointWriter *writer, std::string const &path);
+  // Any thread: saves a checkpoint before the next steps, playing or not
+  void requestCheckpoint() { m_checkpointRequested = true; }
+
+  // Any thread: handed to Simulation::setDrag() before the next steps
+  void setDrag(int mass, Vec3f const &target);
+
+  // Render thread: picks up the newest snapshot, returns whether there was
+  // a new one. Never blocks. The buffer of retiringBuffer() goes back to
+  // the simulation thread, nothing may read it any more.
+  bool update();
+  Snapshot const &snapshot() const { return m_snapshots.front(); }
+  int retiringBuffer() const { return m_retired[0]; }
+
+private:
+  void run();
+  void publish();
+
+  Simulation &m_simulation;
+  SimClock &m_clock;
+  TripleBuffer<Snapshot> m_snapshots;
+  Vec3f *m_external[BUFFER_COUNT]; // setSnapshotBuffers(), if given
+  std::vector<Vec3f> m_storage[BUFFER_COUNT]; // otherwise
+  Vec3f *m_buffers[BUFFER_COUNT];  // the ones used
+  int m_retired[RETIRED_COUNT];    // render thread, oldest first
+  TrajectoryWriter *m_recorder;
+  CheckpointWriter *m_checkpoints;
+  std::string m_checkpointPath;
+  std::atomic<bool> m_checkpointRequested;
+
+  std::thread m_thread;
+  std::atomic<bool> m_stop;
+  std::atomic<bool> m_playing;
+
+  std::mutex m_dragMutex;
+  int m_dragMass;
+  Vec3f m_dragTarget;
+};
+
+#endif // SIMULATION_THREAD_H
@@ -1,7 +1,7 @@
 #include "Spring.h"
 
 // ======================== CONSTRUCTORS ============================//
-Spring::Spring(float s, Mass* A, Mass* B, float  r) {
+Spring::Spring(float s, int A, int B, float  r) {
   stiffness = s;
   massA = A;
   massB = B;
@@ -11,7 +11,19 @@ Spring::Spring(float s, Mass* A, Mass* B, float  r) {
 // ==========================================================================//
 
 // ========================= OPERATORS ======================================//
-int Spring::getSize() {
-  return Springs.size();
+float Spring::getStiffness() const {
+  return stiffness;
+}
+
+int Spring::getMassA() const {
+  return massA;
+}
+
+int Spring::getMassB() const {
+  return massB;
+}
+
+float Spring::getRestLength() const {
+  return restLength;
 }
 // ==========================================================================//
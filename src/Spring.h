@@ -3,23 +3,27 @@
 
 #include <iostream>
 #include "Mass.h"
-#include <vector>
 
 using namespace std;
 
 // Defines the properties of a Spring
+//
+// The two ends are indices of masses in the owning ParticleSystem, so a
+// Spring stays valid when the mass arrays grow and reallocate.
 
 class Spring {
 public:
-  vector<Spring> Springs;
-  Spring() {};
-  Spring(float s, Mass* A, Mass* B, float r);
-  int getSize();
+  Spring() : stiffness(0.f), massA(-1), massB(-1), restLength(0.f) {};
+  Spring(float s, int A, int B, float r);
+  float getStiffness() const;
+  int getMassA() const;
+  int getMassB() const;
+  float getRestLength() const;
 
 private:
   float stiffness;
-  Mass* massA;
-  Mass* massB;
+  int massA;
+  int massB;
   float restLength;
 };
 
@@ -0,0 +1,55 @@
+#include "SpringColoring.h"
+
+#include <cstdint>
+
+void SpringColoring::update(ParticleSystem &system) {
+  if (m_built && m_topology == system.topologyVersion())
+    return;
+
+  size_t springCount = system.springCount();
+  ParticleSystem::SpringEnds const *ends = system.springEnds();
+
+  // color of every spring, MAX_COLORS for the left over ones
+  std::vector<uint64_t> used(system.massCount(), 0);
+  std::vector<unsigned char> color(springCount);
+  std::vector<size_t> colorSize(MAX_COLORS + 1, 0);
+
+  for (size_t s = 0; s < springCount; ++s) {
+    uint64_t taken = used[ends[s].a] | used[ends[s].b];
+    int c = MAX_COLORS;
+    if (~taken != 0) {
+      c = __builtin_ctzll(~taken);
+      used[ends[s].a] |= uint64_t(1) << c;
+      used[ends[s].b] |= uint64_t(1) << c;
+    }
+    color[s] = c;
+    ++colorSize[c];
+  }
+
+  // stable counting sort by color, empty colors are skipped
+  m_offsets.assign(1, 0);
+  std::vector<size_t> start(MAX_COLORS + 1);
+  for (int c = 0; c <= MAX_COLORS; ++c) {
+    start[c] = m_offsets.back();
+    if (colorSize[c] > 0)
+      m_offsets.push_back(m_offsets.back() + colorSize[c]);
+  }
+  m_hasSerial = colorSize[MAX_COLORS] > 0;
+
+  std::vector<unsigned> order(springCount);
+  bool sorted = true;
+  for (size_t s = 0; s < springCount; ++s) {
+    size_t slot = start[color[s]]++;
+    order[slot] = s;
+    sorted = sorted && slot == s;
+  }
+
+  // springs that are already in color order (a scene saved after coloring,
+  // which colors the same again) are left in place, so adopted spring
+  // arrays are not copied
+  if (!sorted)
+    system.permuteSprings(order);
+
+  m_topology = system.topologyVersion();
+  m_built = true;
+}
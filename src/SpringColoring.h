@@ -0,0 +1,51 @@
+//
+//  SpringColoring.h
+//
+//	Partitions the springs of a ParticleSystem into colors, batches of
+//	springs that share no mass. The springs of one color can add their
+//	forces to their masses from many threads at once without atomics, and
+//	colors run one after the other, so every mass sums its spring forces in
+//	the same order whatever the thread count.
+//
+//	Colors are found greedily (first color free at both ends) and the
+//	spring arrays of the system are reordered so each color is one
+//	contiguous range. Springs that find no free color among the first
+//	MAX_COLORS go to a final batch that is processed on a single thread.
+
+#ifndef SPRING_COLORING_H
+#define SPRING_COLORING_H
+
+#include <vector>
+#include <cstddef>
+
+#include "ParticleSystem.h"
+
+class SpringColoring {
+public:
+  enum { MAX_COLORS = 64 };
+
+public:
+  SpringColoring() : m_topology(0), m_built(false) {}
+
+  // Recolors and reorders the springs if the topology of the system changed
+  // since the last call
+  void update(ParticleSystem &system);
+
+  // Batches in processing order
+  size_t batchCount() const { return m_offsets.size() - 1; }
+  size_t batchBegin(size_t batch) const { return m_offsets[batch]; }
+  size_t batchEnd(size_t batch) const { return m_offsets[batch + 1]; }
+  // The batch of springs left over after MAX_COLORS, its springs may share
+  // masses
+  bool isSerialBatch(size_t batch) const {
+    return m_hasSerial && batch + 1 == batchCount();
+  }
+
+private:
+  unsigned m_topology;
+  bool m_built;
+  bool m_hasSerial;
+  std::vector<size_t> m_offsets;
+};
+
+#endif // SPRING_COLORING_H
@@ -0,0 +1,394 @@
+#include "SpringKernels.h"
+
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SPRING_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+static_assert(sizeof(Vec3f) == 3 * sizeof(float),
+              "kernels treat Vec3f arrays as packed floats");
+static_assert(sizeof(ParticleSystem::SpringEnds) == 2 * sizeof(unsigned),
+              "kernels treat spring ends as packed index pairs");
+
+namespace {
+
+// Everything a kernel touches, as flat arrays
+struct SpringArrays {
+  explicit SpringArrays(ParticleSystem &system)
+      : ends(reinterpret_cast<unsigned const *>(system.springEnds())),
+        stiffness(system.stiffnesses()), restLength(system.restLengths()),
+        pos(reinterpret_cast<float const *>(system.positions())),
+        force(reinterpret_cast<float *>(system.forces())) {}
+
+  unsigned const *ends;
+  float const *stiffness;
+  float const *restLength;
+  float const *pos;
+  float *force;
+};
+
+struct MassArrays {
+  explicit MassArrays(ParticleSystem &system)
+      : pos(reinterpret_cast<float *>(system.positions())),
+        vel(reinterpret_cast<float *>(system.velocities())),
+        force(reinterpret_cast<float const *>(system.forces())),
+        invMass(system.inverseMasses()),
+        gravity(system.gravity()), damping(system.damping()) {}
+
+  float *pos;
+  float *vel;
+  float const *force;
+  float const *invMass;
+  Vec3f gravity;
+  float damping;
+};
+
+// ========================= SCALAR =========================================//
+void springForcesScalar(SpringArrays const &s, size_t begin, size_t end) {
+  for (size_t i = begin; i < end; ++i) {
+    unsigned a = 3 * s.ends[2 * i];
+    unsigned b = 3 * s.ends[2 * i + 1];
+
+    float dx = s.pos[b] - s.pos[a];
+    float dy = s.pos[b + 1] - s.pos[a + 1];
+    float dz = s.pos[b + 2] - s.pos[a + 2];
+    float len = std::sqrt(dx * dx + dy * dy + dz * dz);
+    if (len <= 0.f)
+      continue;
+
+    float scale = s.stiffness[i] * (len - s.restLength[i]) / len;
+    float fx = dx * scale;
+    float fy = dy * scale;
+    float fz = dz * scale;
+
+    s.force[a] += fx;
+    s.force[a + 1] += fy;
+    s.force[a + 2] += fz;
+    s.force[b] -= fx;
+    s.force[b + 1] -= fy;
+    s.force[b + 2] -= fz;
+  }
+}
+
+void kickDriftScalar(MassArrays const &m, float kickDt, float driftDt,
+                     bool drift, size_t begin, size_t end) {
+  for (size_t i = begin; i < end; ++i) {
+    float w = m.invMass[i];
+    if (w == 0.f)
+      continue;
+
+    for (int c = 0; c < 3; ++c) {
+      size_t k = 3 * i + c;
+      float acc = m.force[k] * w + m.gravity[c] - m.vel[k] * m.damping;
+      m.vel[k] += acc * kickDt;
+      if (drift)
+        m.pos[k] += m.vel[k] * driftDt;
+    }
+  }
+}
+// ==========================================================================//
+
+#ifdef SPRING_KERNELS_X86
+
+// Adds the computed lane forces one lane after the other
+inline void scatterForces(SpringArrays const &s, unsigned const *a,
+                          unsigned const *b, float const *fx, float const *fy,
+                          float const *fz, int lanes) {
+  for (int l = 0; l < lanes; ++l) {
+    float *fa = s.force + 3 * a[l];
+    float *fb = s.force + 3 * b[l];
+    fa[0] += fx[l];
+    fa[1] += fy[l];
+    fa[2] += fz[l];
+    fb[0] -= fx[l];
+    fb[1] -= fy[l];
+    fb[2] -= fz[l];
+  }
+}
+
+// ========================= SSE ============================================//
+void springForcesSSE(SpringArrays const &s, size_t begin, size_t end) {
+  alignas(16) unsigned a[4], b[4];
+  alignas(16) float fx[4], fy[4], fz[4];
+
+  size_t i = begin;
+  for (; i + 4 <= end; i += 4) {
+    for (int l = 0; l < 4; ++l) {
+      a[l] = s.ends[2 * (i + l)];
+      b[l] = s.ends[2 * (i + l) + 1];
+    }
+
+    float const *p = s.pos;
+    __m128 dx = _mm_sub_ps(
+        _mm_setr_ps(p[3 * b[0]], p[3 * b[1]], p[3 * b[2]], p[3 * b[3]]),
+        _mm_setr_ps(p[3 * a[0]], p[3 * a[1]], p[3 * a[2]], p[3 * a[3]]));
+    __m128 dy = _mm_sub_ps(_mm_setr_ps(p[3 * b[0] + 1], p[3 * b[1] + 1],
+                                       p[3 * b[2] + 1], p[3 * b[3] + 1]),
+                           _mm_setr_ps(p[3 * a[0] + 1], p[3 * a[1] + 1],
+                                       p[3 * a[2] + 1], p[3 * a[3] + 1]));
+    __m128 dz = _mm_sub_ps(_mm_setr_ps(p[3 * b[0] + 2], p[3 * b[1] + 2],
+                                       p[3 * b[2] + 2], p[3 * b[3] + 2]),
+                           _mm_setr_ps(p[3 * a[0] + 2], p[3 * a[1] + 2],
+                                       p[3 * a[2] + 2], p[3 * a[3] + 2]));
+
+    __m128 len = _mm_sqrt_ps(
+        _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)),
+                   _mm_mul_ps(dz, dz)));
+    __m128 valid = _mm_cmpgt_ps(len, _mm_setzero_ps());
+
+    __m128 k = _mm_loadu_ps(s.stiffness + i);
+    __m128 rest = _mm_loadu_ps(s.restLength + i);
+    __m128 scale = _mm_div_ps(_mm_mul_ps(k, _mm_sub_ps(len, rest)), len);
+    scale = _mm_and_ps(scale, valid);
+
+    _mm_store_ps(fx, _mm_mul_ps(dx, scale));
+    _mm_store_ps(fy, _mm_mul_ps(dy, scale));
+    _mm_store_ps(fz, _mm_mul_ps(dz, scale));
+
+    scatterForces(s, a, b, fx, fy, fz, 4);
+  }
+
+  springForcesScalar(s, i, end);
+}
+
+// 4 masses are 12 packed floats, so every per mass value is spread over
+// three registers as  0 0 0 1 | 1 1 2 2 | 2 3 3 3
+void kickDriftSSE(MassArrays const &m, float kickDt, float driftDt,
+                  bool drift, size_t begin, size_t end) {
+  float gx = m.gravity.x(), gy = m.gravity.y(), gz = m.gravity.z();
+  __m128 const g[3] = {_mm_setr_ps(gx, gy, gz, gx), _mm_setr_ps(gy, gz, gx, gy),
+                       _mm_setr_ps(gz, gx, gy, gz)};
+  __m128 const damping = _mm_set1_ps(m.damping);
+  __m128 const kick = _mm_set1_ps(kickDt);
+  __m128 const driftStep = _mm_set1_ps(driftDt);
+  __m128 const zero = _mm_setzero_ps();
+
+  size_t i = begin;
+  for (; i + 4 <= end; i += 4) {
+    __m128 w4 = _mm_loadu_ps(m.invMass + i);
+    __m128 w[3] = {_mm_shuffle_ps(w4, w4, _MM_SHUFFLE(1, 0, 0, 0)),
+                   _mm_shuffle_ps(w4, w4, _MM_SHUFFLE(2, 2, 1, 1)),
+                   _mm_shuffle_ps(w4, w4, _MM_SHUFFLE(3, 3, 3, 2))};
+
+    for (int r = 0; r < 3; ++r) {
+      size_t k = 3 * i + 4 * r;
+      __m128 isFree = _mm_cmpneq_ps(w[r], zero);
+      __m128 v = _mm_loadu_ps(m.vel + k);
+
+      __m128 acc = _mm_sub_ps(
+          _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(m.force + k), w[r]), g[r]),
+          _mm_mul_ps(v, damping));
+      __m128 vNew = _mm_add_ps(v, _mm_mul_ps(acc, kick));
+      vNew = _mm_or_ps(_mm_and_ps(isFree, vNew), _mm_andnot_ps(isFree, v));
+      _mm_storeu_ps(m.vel + k, vNew);
+
+      if (drift) {
+        __m128 x = _mm_loadu_ps(m.pos + k);
+        __m128 xNew = _mm_add_ps(x, _mm_mul_ps(vNew, driftStep));
+        xNew = _mm_or_ps(_mm_and_ps(isFree, xNew), _mm_andnot_ps(isFree, x));
+        _mm_storeu_ps(m.pos + k, xNew);
+      }
+    }
+  }
+
+  kickDriftScalar(m, kickDt, driftDt, drift, i, end);
+}
+// ==========================================================================//
+
+// ========================= AVX2 ===========================================//
+__attribute__((target("avx2"))) void
+springForcesAVX2(SpringArrays const &s, size_t begin, size_t end) {
+  alignas(32) unsigned a[8], b[8];
+  alignas(32) float fx[8], fy[8], fz[8];
+
+  size_t i = begin;
+  for (; i + 8 <= end; i += 8) {
+    // a0 b0 a1 b1 ... a7 b7  ->  a0..a7, b0..b7
+    __m256i p0 = _mm256_loadu_si256(
+        reinterpret_cast<__m256i const *>(s.ends + 2 * i));
+    __m256i p1 = _mm256_loadu_si256(
+        reinterpret_cast<__m256i const *>(s.ends + 2 * i + 8));
+    p0 = _mm256_shuffle_epi32(p0, _MM_SHUFFLE(3, 1, 2, 0));
+    p1 = _mm256_shuffle_epi32(p1, _MM_SHUFFLE(3, 1, 2, 0));
+    p0 = _mm256_permute4x64_epi64(p0, _MM_SHUFFLE(3, 1, 2, 0));
+    p1 = _mm256_permute4x64_epi64(p1, _MM_SHUFFLE(3, 1, 2, 0));
+    __m256i ia = _mm256_permute2x128_si256(p0, p1, 0x20);
+    __m256i ib = _mm256_permute2x128_si256(p0, p1, 0x31);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(a), ia);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(b), ib);
+
+    // float offsets of the ends, 3 * index
+    ia = _mm256_add_epi32(_mm256_slli_epi32(ia, 1), ia);
+    ib = _mm256_add_epi32(_mm256_slli_epi32(ib, 1), ib);
+
+    __m256 dx = _mm256_sub_ps(_mm256_i32gather_ps(s.pos, ib, 4),
+                              _mm256_i32gather_ps(s.pos, ia, 4));
+    __m256 dy = _mm256_sub_ps(_mm256_i32gather_ps(s.pos + 1, ib, 4),
+                              _mm256_i32gather_ps(s.pos + 1, ia, 4));
+    __m256 dz = _mm256_sub_ps(_mm256_i32gather_ps(s.pos + 2, ib, 4),
+                              _mm256_i32gather_ps(s.pos + 2, ia, 4));
+
+    __m256 len = _mm256_sqrt_ps(_mm256_add_ps(
+        _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)),
+        _mm256_mul_ps(dz, dz)));
+    __m256 valid = _mm256_cmp_ps(len, _mm256_setzero_ps(), _CMP_GT_OQ);
+
+    __m256 k = _mm256_loadu_ps(s.stiffness + i);
+    __m256 rest = _mm256_loadu_ps(s.restLength + i);
+    __m256 scale =
+        _mm256_div_ps(_mm256_mul_ps(k, _mm256_sub_ps(len, rest)), len);
+    scale = _mm256_and_ps(scale, valid);
+
+    _mm256_store_ps(fx, _mm256_mul_ps(dx, scale));
+    _mm256_store_ps(fy, _mm256_mul_ps(dy, scale));
+    _mm256_store_ps(fz, _mm256_mul_ps(dz, scale));
+
+    scatterForces(s, a, b, fx, fy, fz, 8);
+  }
+
+  springForcesScalar(s, i, end);
+}
+
+// 8 masses are 24 packed floats, per mass values are spread over three
+// registers as  0 0 0 1 1 1 2 2 | 2 3 3 3 4 4 4 5 | 5 5 6 6 6 7 7 7
+__attribute__((target("avx2"))) void
+kickDriftAVX2(MassArrays const &m, float kickDt, float driftDt, bool drift,
+              size_t begin, size_t end) {
+  float gx = m.gravity.x(), gy = m.gravity.y(), gz = m.gravity.z();
+  __m256 const g[3] = {_mm256_setr_ps(gx, gy, gz, gx, gy, gz, gx, gy),
+                       _mm256_setr_ps(gz, gx, gy, gz, gx, gy, gz, gx),
+                       _mm256_setr_ps(gy, gz, gx, gy, gz, gx, gy, gz)};
+  __m256i const spread[3] = {_mm256_setr_epi32(0, 0, 0, 1, 1, 1, 2, 2),
+                             _mm256_setr_epi32(2, 3, 3, 3, 4, 4, 4, 5),
+                             _mm256_setr_epi32(5, 5, 6, 6, 6, 7, 7, 7)};
+  __m256 const damping = _mm256_set1_ps(m.damping);
+  __m256 const kick = _mm256_set1_ps(kickDt);
+  __m256 const driftStep = _mm256_set1_ps(driftDt);
+  __m256 const zero = _mm256_setzero_ps();
+
+  size_t i = begin;
+  for (; i + 8 <= end; i += 8) {
+    __m256 w8 = _mm256_loadu_ps(m.invMass + i);
+
+    for (int r = 0; r < 3; ++r) {
+      size_t k = 3 * i + 8 * r;
+      __m256 w = _mm256_permutevar8x32_ps(w8, spread[r]);
+      __m256 isFree = _mm256_cmp_ps(w, zero, _CMP_NEQ_UQ);
+      __m256 v = _mm256_loadu_ps(m.vel + k);
+
+      __m256 acc = _mm256_sub_ps(
+          _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(m.force + k), w), g[r]),
+          _mm256_mul_ps(v, damping));
+      __m256 vNew = _mm256_add_ps(v, _mm256_mul_ps(acc, kick));
+      vNew = _mm256_blendv_ps(v, vNew, isFree);
+      _mm256_storeu_ps(m.vel + k, vNew);
+
+      if (drift) {
+        __m256 x = _mm256_loadu_ps(m.pos + k);
+        __m256 xNew = _mm256_add_ps(x, _mm256_mul_ps(vNew, driftStep));
+        _mm256_storeu_ps(m.pos + k, _mm256_blendv_ps(x, xNew, isFree));
+      }
+    }
+  }
+
+  kickDriftScalar(m, kickDt, driftDt, drift, i, end);
+}
+// ==========================================================================//
+
+#endif // SPRING_KERNELS_X86
+
+SimdLevel detectSimdLevel() {
+#ifdef SPRING_KERNELS_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return SimdLevel::AVX2;
+  if (__builtin_cpu_supports("sse2"))
+    return SimdLevel::SSE;
+#endif
+  return SimdLevel::Scalar;
+}
+
+SimdLevel g_simdLevel = detectSimdLevel();
+
+} // namespace
+
+char const *simdLevelName(SimdLevel level) {
+  switch (level) {
+  case SimdLevel::AVX2:
+    return "avx2";
+  case SimdLevel::SSE:
+    return "sse";
+  case SimdLevel::Scalar:
+    break;
+  }
+  return "scalar";
+}
+
+bool parseSimdLevel(std::string const &name, SimdLevel &level, bool &isAuto) {
+  isAuto = name == "auto";
+  if (isAuto) {
+    level = supportedSimdLevel();
+    return true;
+  }
+
+  SimdLevel const levels[] = {SimdLevel::Scalar, SimdLevel::SSE,
+                              SimdLevel::AVX2};
+  for (SimdLevel l : levels) {
+    if (name == simdLevelName(l)) {
+      level = l;
+      return true;
+    }
+  }
+  return false;
+}
+
+SimdLevel supportedSimdLevel() {
+  static SimdLevel const supported = detectSimdLevel();
+  return supported;
+}
+
+SimdLevel simdLevel() { return g_simdLevel; }
+
+SimdLevel setSimdLevel(SimdLevel level) {
+  if (int(level) > int(supportedSimdLevel()))
+    level = supportedSimdLevel();
+  g_simdLevel = level;
+  return level;
+}
+
+void springForceKernel(ParticleSystem &system, size_t begin, size_t end) {
+  SpringArrays arrays(system);
+
+  switch (g_simdLevel) {
+#ifdef SPRING_KERNELS_X86
+  case SimdLevel::AVX2:
+    springForcesAVX2(arrays, begin, end);
+    return;
+  case SimdLevel::SSE:
+    springForcesSSE(arrays, begin, end);
+    return;
+#endif
+  default:
+    springForcesScalar(arrays, begin, end);
+  }
+}
+
+void kickDriftKernel(ParticleSystem &system, float kickDt, float driftDt,
+                     bool drift, size_t begin, size_t end) {
+  MassArrays arrays(system);
+
+  switch (g_simdLevel) {
+#ifdef SPRING_KERNELS_X86
+  case SimdLevel::AVX2:
+    kickDriftAVX2(arrays, kickDt, driftDt, drift, begin, end);
+    return;
+  case SimdLevel::SSE:
+    kickDriftSSE(arrays, kickDt, driftDt, drift, begin, end);
+    return;
+#endif
+  default:
+    kickDriftScalar(arrays, kickDt, driftDt, drift, begin, end);
+  }
+}
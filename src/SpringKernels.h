@@ -0,0 +1,41 @@
+//
+//  SpringKernels.h
+//
+//	Inner loops of the explicit integrators, in scalar, SSE (4 wide) and
+//	AVX2 (8 wide) versions. The best version the CPU supports is picked at
+//	run time, see setSimdLevel() to force one.
+//
+//	The vector versions do the same float operations in the same order as
+//	the scalar one (no FMA), so all levels give bit identical results.
+
+#ifndef SPRING_KERNELS_H
+#define SPRING_KERNELS_H
+
+#include <cstddef>
+#include <string>
+
+#include "ParticleSystem.h"
+
+enum class SimdLevel { Scalar, SSE, AVX2 };
+
+char const *simdLevelName(SimdLevel level);
+// "auto" picks the best supported level
+bool parseSimdLevel(std::string const &name, SimdLevel &level, bool &isAuto);
+
+SimdLevel supportedSimdLevel();
+SimdLevel simdLevel();
+// Clamped to what the CPU supports, returns the level now in use
+SimdLevel setSimdLevel(SimdLevel level);
+
+// Adds the Hooke force of springs [begin, end) to both of their masses.
+// Lanes are scattered one after the other, so springs in the range may
+// share masses, but ranges running concurrently must not.
+void springForceKernel(ParticleSystem &system, size_t begin, size_t end);
+
+// For the free masses in [begin, end)
+//   v += kickDt * (f / m + g - c v)
+//   x += driftDt * v   (skipped if drift is false)
+void kickDriftKernel(ParticleSystem &system, float kickDt, float driftDt,
+                     bool drift, size_t begin, size_t end);
+
+#endif // SPRING_KERNELS_H
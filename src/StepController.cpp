@@ -0,0 +1,223 @@
+#include "StepController.h"
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+
+#include "MultiRate.h"
+
+namespace {
+
+// of the stability limit actually used, the bound is already conservative
+// but collisions and dragging are not part of it
+float const SAFETY = 0.9f;
+// dt grows by at most this much per check
+float const MAX_GROWTH = 1.25f;
+// and shrinks by this much when energy grows
+float const ENERGY_SHRINK = 0.5f;
+// energy changes below this fraction of the total are rounding
+double const ENERGY_NOISE = 1e-6;
+
+size_t const MIN_CHUNK = 4096;
+
+bool isUnconditionallyStable(IntegratorType integrator) {
+  return integrator == IntegratorType::BackwardEuler ||
+         integrator == IntegratorType::XPBD;
+}
+
+} // namespace
+
+// ======== CONSTRUCTORS ====================================================//
+StepController::StepController()
+    : m_enabled(false), m_stepSize(0.001f), m_minStep(1e-6f),
+      m_maxStep(1.f / 60.f), m_strainPerStep(0.01f), m_energyTolerance(0.01f),
+      m_stabilityLimit(0.f), m_limitValid(false), m_limitSystem(nullptr),
+      m_limitTopology(0), m_limitDamping(0.f), m_stepsSinceCheck(0),
+      m_strainRate(0.f), m_energy(0.0), m_haveEnergy(false) {}
+// ==========================================================================//
+
+void StepController::reset(float stepSize) {
+  m_stepSize = stepSize;
+  m_stepsSinceCheck = 0;
+  m_strainRate = 0.f;
+  m_haveEnergy = false;
+}
+
+StepController::State StepController::state() const {
+  State state;
+  state.stepSize = m_stepSize;
+  state.stepsSinceCheck = m_stepsSinceCheck;
+  state.strainRate = m_strainRate;
+  state.energy = m_energy;
+  state.haveEnergy = m_haveEnergy;
+  return state;
+}
+
+void StepController::setState(State const &state) {
+  m_stepSize = state.stepSize;
+  m_stepsSinceCheck = state.stepsSinceCheck;
+  m_strainRate = state.strainRate;
+  m_energy = state.energy;
+  m_haveEnergy = state.haveEnergy;
+}
+
+void StepController::setLimits(float minStep, float maxStep) {
+  m_minStep = minStep;
+  m_maxStep = std::max(minStep, maxStep);
+}
+
+float StepController::next(ParticleSystem const &system,
+                           IntegratorType integrator) {
+  if (!m_limitValid || m_limitSystem != &system ||
+      m_limitTopology != system.topologyVersion() ||
+      m_limitDamping != system.damping()) {
+    updateStabilityLimit(system);
+  }
+
+  float limit = SAFETY * m_stabilityLimit;
+  if (integrator == IntegratorType::MultiRate)
+    limit *= float(1 << MultiRateSolver::MAX_LEVEL);
+
+  float dt = std::min(std::max(m_stepSize, m_minStep), m_maxStep);
+  if (m_stabilityLimit > 0.f && !isUnconditionallyStable(integrator))
+    dt = std::max(std::min(dt, limit), m_minStep);
+  return dt;
+}
+
+// Row sums of M^-1/2 K M^-1/2, taking every spring's stiffness matrix as k
+// along the spring (its norm)
+void stiffnessRows(ParticleSystem const &system, std::vector<double> &rows) {
+  ParticleSystem::SpringEnds const *ends = system.springEnds();
+  float const *stiffness = system.stiffnesses();
+  float const *invMass = system.inverseMasses();
+
+  rows.assign(system.massCount(), 0.0);
+  for (size_t s = 0; s < system.springCount(); ++s) {
+    double wa = invMass[ends[s].a], wb = invMass[ends[s].b];
+    double k = stiffness[s];
+    double cross = k * std::sqrt(wa * wb);
+    rows[ends[s].a] += k * wa + cross;
+    rows[ends[s].b] += k * wb + cross;
+  }
+}
+
+// leapfrog with linear drag c is stable for
+// dt < 2 (sqrt(omega^2 + c^2 / 4) - c / 2) / omega^2
+float stableStepSize(double omega2, float damping) {
+  if (!(omega2 > 0.0))
+    return 0.f;
+  double c = damping;
+  return float(2.0 * (std::sqrt(omega2 + 0.25 * c * c) - 0.5 * c) / omega2);
+}
+
+void StepController::updateStabilityLimit(ParticleSystem const &system) {
+  std::vector<double> rows;
+  stiffnessRows(system, rows);
+  double omega2 = 0.0;
+  for (double row : rows)
+    omega2 = std::max(omega2, row);
+  m_stabilityLimit = stableStepSize(omega2, system.damping());
+
+  m_limitValid = true;
+  m_limitSystem = &system;
+  m_limitTopology = system.topologyVersion();
+  m_limitDamping = system.damping();
+}
+
+void StepController::observe(ParticleSystem const &system, float dt,
+                             IntegratorType integrator, bool externalWork,
+                             ThreadPool &pool) {
+  if (++m_stepsSinceCheck < CHECK_INTERVAL)
+    return;
+  m_stepsSinceCheck = 0;
+
+  Vec3f const *pos = system.positions();
+  Vec3f const *vel = system.velocities();
+  float const *invMass = system.inverseMasses();
+  ParticleSystem::SpringEnds const *ends = system.springEnds();
+  float const *stiffness = system.stiffnesses();
+  float const *rest = system.restLengths();
+
+  // strain rate of a spring is d/dt (|d| / rest) = (v_b - v_a) . d / (|d| rest)
+  float maxRate = 0.f;
+  std::mutex maxMutex;
+  double springEnergy = pool.parallelSum(
+      system.springCount(),
+      [&](size_t begin, size_t end) {
+        // max of |(v_b - v_a) . d| / (|d| rest) without dividing per
+        // spring, as the largest (v_b - v_a) . d)^2 / (|d|^2 rest^2)
+        float rateNum = 0.f, rateDen = 1.f;
+        double energy = 0.0;
+        float blockEnergy = 0.f;
+        for (size_t s = begin; s < end; ++s) {
+          Vec3f d = pos[ends[s].b] - pos[ends[s].a];
+          float length2 = d.lengthSquared();
+          float stretch = std::sqrt(length2) - rest[s];
+          blockEnergy += stiffness[s] * stretch * stretch;
+
+          float dv = (vel[ends[s].b] - vel[ends[s].a]) * d;
+          float num = dv * dv, den = length2 * rest[s] * rest[s];
+          if (num * rateDen > rateNum * den) {
+            rateNum = num;
+            rateDen = den;
+          }
+          if ((s & 255) == 255) {
+            energy += 0.5 * blockEnergy;
+            blockEnergy = 0.f;
+          }
+        }
+        energy += 0.5 * blockEnergy;
+        float rate = rateDen > 0.f ? std::sqrt(rateNum / rateDen) : 0.f;
+        std::lock_guard<std::mutex> lock(maxMutex);
+        maxRate = std::max(maxRate, rate);
+        return energy;
+      },
+      MIN_CHUNK);
+
+  double kinetic = pool.parallelSum(
+      system.massCount(),
+      [&](size_t begin, size_t end) {
+        double energy = 0.0;
+        for (size_t i = begin; i < end; ++i) {
+          if (invMass[i] > 0.f)
+            energy += 0.5 * vel[i].lengthSquared() / invMass[i];
+        }
+        return energy;
+      },
+      MIN_CHUNK);
+
+  Vec3f const g = system.gravity();
+  double gravity = pool.parallelSum(
+      system.massCount(),
+      [&](size_t begin, size_t end) {
+        double energy = 0.0;
+        for (size_t i = begin; i < end; ++i) {
+          if (invMass[i] > 0.f)
+            energy -= (g * pos[i]) / invMass[i];
+        }
+        return energy;
+      },
+      MIN_CHUNK);
+
+  m_strainRate = maxRate;
+  double energy = kinetic + springEnergy + gravity;
+
+  float grown = m_stepSize * MAX_GROWTH;
+  if (maxRate > 0.f)
+    grown = std::min(grown, m_strainPerStep / maxRate);
+
+  bool energyGrew = false;
+  if (m_haveEnergy && !externalWork &&
+      integrator != IntegratorType::ExplicitEuler) {
+    double scale = kinetic + springEnergy;
+    double noise =
+        ENERGY_NOISE * (std::abs(kinetic) + springEnergy + std::abs(gravity));
+    energyGrew = energy - m_energy > m_energyTolerance * scale + noise;
+  }
+  if (energyGrew)
+    grown = std::min(grown, std::min(dt, m_stepSize) * ENERGY_SHRINK);
+
+  m_energy = energy;
+  m_haveEnergy = true;
+  m_stepSize = std::min(std::max(grown, m_minStep), m_maxStep);
+}
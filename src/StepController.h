@@ -0,0 +1,115 @@
+//
+//  StepController.h
+//
+//	Picks the time step from the state of the system, instead of one fixed
+//	dt small enough for the stiffest moment of any scene.
+//
+//	Explicit steps are only stable while dt * omega < 2 (less with
+//	damping) for the highest frequency omega of the spring network.
+//	Gershgorin's theorem on the mass weighted stiffness bounds omega^2 by
+//	the largest, over all masses i, sum over the springs of i of
+//	k (w_i + sqrt(w_i w_j)), w being inverse masses. That only depends on
+//	the springs and masses, so it is worked out again when the topology
+//	changes or after invalidate(). Implicit and XPBD steps are stable for
+//	any dt and have no such bound, multi-rate steps substep the springs
+//	that need it up to 2^MultiRateSolver::MAX_LEVEL times.
+//
+//	Below the bound dt follows the motion, measured every CHECK_INTERVAL
+//	steps. No spring should change its strain by more than strainPerStep()
+//	in a step, and if the total energy (kinetic, spring and gravity) grew
+//	by more than energyTolerance() of the kinetic plus spring energy since
+//	the last check, dt is halved at once. Growth is at most MAX_GROWTH per
+//	check, so a quiet scene works its way up to large steps while a
+//	transient shrinks them right away. Energy growth is not held against
+//	explicit Euler (which always gains energy) or while something does
+//	work on the system (a dragged mass).
+
+#ifndef STEP_CONTROLLER_H
+#define STEP_CONTROLLER_H
+
+#include <vector>
+
+#include "Integrator.h"
+#include "ParticleSystem.h"
+#include "ThreadPool.h"
+
+// Gershgorin bound of omega^2 at every mass: the sum over its springs of
+// k (w_i + sqrt(w_i w_j)), w being inverse masses
+void stiffnessRows(ParticleSystem const &system, std::vector<double> &rows);
+// Largest stable leapfrog step for omega^2 and linear drag, 0 for no bound
+float stableStepSize(double omega2, float damping);
+
+class StepController {
+public:
+  enum { CHECK_INTERVAL = 8 };
+
+  // What was measured so far, the settings aside
+  struct State {
+    float stepSize;
+    int stepsSinceCheck;
+    float strainRate;
+    double energy;
+    bool haveEnergy;
+  };
+
+public:
+  StepController();
+
+  bool enabled() const { return m_enabled; }
+  void setEnabled(bool enabled) { m_enabled = enabled; }
+
+  // Starts over from stepSize, forgetting what was measured
+  void reset(float stepSize);
+  // Call after changing masses or stiffnesses without changing the topology
+  void invalidate() { m_limitValid = false; }
+  // For checkpoints, carries on exactly where state was taken
+  State state() const;
+  void setState(State const &state);
+
+  // Step size for the next step of system with integrator
+  float next(ParticleSystem const &system, IntegratorType integrator);
+  // Measures the system after a step of dt, every CHECK_INTERVAL calls
+  void observe(ParticleSystem const &system, float dt,
+               IntegratorType integrator, bool externalWork,
+               ThreadPool &pool);
+
+  float minStep() const { return m_minStep; }
+  float maxStep() const { return m_maxStep; }
+  void setLimits(float minStep, float maxStep);
+  float strainPerStep() const { return m_strainPerStep; }
+  void setStrainPerStep(float strain) { m_strainPerStep = strain; }
+  float energyTolerance() const { return m_energyTolerance; }
+  void setEnergyTolerance(float tolerance) { m_energyTolerance = tolerance; }
+
+  // Largest stable explicit step of the system last given to next(),
+  // 0 if there is no bound (no springs)
+  float stabilityLimit() const { return m_stabilityLimit; }
+  // Of the last check: fastest strain change of any spring per second,
+  // and the total energy
+  float strainRate() const { return m_strainRate; }
+  double energy() const { return m_energy; }
+
+private:
+  void updateStabilityLimit(ParticleSystem const &system);
+
+private:
+  bool m_enabled;
+  float m_stepSize;
+  float m_minStep, m_maxStep;
+  float m_strainPerStep;
+  float m_energyTolerance;
+
+  float m_stabilityLimit;
+  bool m_limitValid;
+  // what m_stabilityLimit was worked out for
+  ParticleSystem const *m_limitSystem;
+  unsigned m_limitTopology;
+  float m_limitDamping;
+
+  int m_stepsSinceCheck;
+  float m_strainRate;
+  double m_energy;
+  bool m_haveEnergy; // m_energy is from an earlier check
+};
+
+#endif // STEP_CONTROLLER_H
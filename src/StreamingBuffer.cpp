@@ -0,0 +1,150 @@
+#include "StreamingBuffer.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace {
+
+// region offsets stay aligned for any attribute type and mapping
+size_t const REGION_ALIGNMENT = 256;
+
+// a frame in flight should never take this long
+GLuint64 const FENCE_TIMEOUT_NS = 1000000000ull;
+
+} // namespace
+
+// ======== CONSTRUCTORS ====================================================//
+StreamingBuffer::StreamingBuffer()
+    : m_buffer(0), m_regionSize(0), m_regionCount(REGION_COUNT), m_region(0),
+      m_mapped(nullptr) {
+  for (auto &fence : m_fences)
+    fence = 0;
+}
+// ==========================================================================//
+
+void StreamingBuffer::allocate(size_t regionSize, int regionCount) {
+  release();
+
+  m_regionCount = std::min(std::max(regionCount, 1), int(MAX_REGIONS));
+  m_regionSize = (regionSize + REGION_ALIGNMENT - 1) / REGION_ALIGNMENT *
+                 REGION_ALIGNMENT;
+  if (m_regionSize == 0)
+    m_regionSize = REGION_ALIGNMENT;
+  GLsizeiptr total = GLsizeiptr(m_regionSize * m_regionCount);
+
+  glGenBuffers(1, &m_buffer);
+  glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+
+  if (GLEW_ARB_buffer_storage) {
+    // readable so positions written there need no copy on the CPU
+    GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_WRITE_BIT |
+                       GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glBufferStorage(GL_ARRAY_BUFFER, total, nullptr, flags);
+    m_mapped = static_cast<char *>(
+        glMapBufferRange(GL_ARRAY_BUFFER, 0, total, flags));
+
+    if (!m_mapped) {
+      // immutable storage cannot be respecified, start over
+      std::cerr << "Persistent mapping failed, mapping per frame"
+                << std::endl;
+      glDeleteBuffers(1, &m_buffer);
+      glGenBuffers(1, &m_buffer);
+      glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+    }
+  }
+
+  if (!m_mapped)
+    glBufferData(GL_ARRAY_BUFFER, total, nullptr, GL_STREAM_DRAW);
+
+  // so the first beginWrite() starts at region 0
+  m_region = m_regionCount - 1;
+}
+
+void StreamingBuffer::release() {
+  for (auto &fence : m_fences) {
+    if (fence)
+      glDeleteSync(fence);
+    fence = 0;
+  }
+
+  if (m_buffer) {
+    if (m_mapped) {
+      glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+      glUnmapBuffer(GL_ARRAY_BUFFER);
+    }
+    glDeleteBuffers(1, &m_buffer);
+  }
+
+  m_buffer = 0;
+  m_mapped = nullptr;
+  m_regionSize = 0;
+}
+
+void *StreamingBuffer::beginWrite() {
+  m_region = (m_region + 1) % m_regionCount;
+  waitFor(m_region);
+
+  if (m_mapped)
+    return m_mapped + regionOffset();
+
+  glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+  return glMapBufferRange(GL_ARRAY_BUFFER, GLintptr(regionOffset()),
+                          GLsizeiptr(m_regionSize),
+                          GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT |
+                              GL_MAP_UNSYNCHRONIZED_BIT);
+}
+
+void StreamingBuffer::endWrite() {
+  // coherent persistent writes are seen by the GPU without a flush
+  if (m_mapped)
+    return;
+
+  glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+  if (glUnmapBuffer(GL_ARRAY_BUFFER) == GL_FALSE)
+    std::cerr << "Streaming buffer contents lost, redrawn next frame"
+              << std::endl;
+}
+
+void StreamingBuffer::fence() {
+  GLsync &fence = m_fences[m_region];
+  if (fence)
+    glDeleteSync(fence);
+  fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void *StreamingBuffer::regionData(int region) const {
+  return m_mapped ? m_mapped + region * m_regionSize : nullptr;
+}
+
+bool StreamingBuffer::isIdle(int region) {
+  GLsync &fence = m_fences[region];
+  if (!fence)
+    return true;
+
+  GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+  if (status == GL_TIMEOUT_EXPIRED)
+    return false;
+  if (status == GL_WAIT_FAILED)
+    std::cerr << "Waiting for a streaming buffer fence failed" << std::endl;
+
+  glDeleteSync(fence);
+  fence = 0;
+  return true;
+}
+
+void StreamingBuffer::waitFor(int region) {
+  GLsync &fence = m_fences[region];
+  if (!fence)
+    return;
+
+  GLenum status = GL_TIMEOUT_EXPIRED;
+  while (status == GL_TIMEOUT_EXPIRED) {
+    status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                              FENCE_TIMEOUT_NS);
+  }
+  if (status == GL_WAIT_FAILED)
+    std::cerr << "Waiting for a streaming buffer fence failed" << std::endl;
+
+  glDeleteSync(fence);
+  fence = 0;
+}
@@ -0,0 +1,77 @@
+//
+//  StreamingBuffer.h
+//
+//	Vertex data rewritten every frame, in a GL buffer split into
+//	REGION_COUNT (or as many as allocated) regions used round robin. The
+//	CPU writes one region while the GPU may still be drawing from the
+//	others, and a fence per region keeps it from overwriting one that is
+//	still in use, so uploads neither reallocate driver storage nor stall
+//	the pipeline.
+//
+//	With GL 4.4 / ARB_buffer_storage the buffer is mapped once, persistently
+//	and coherently, and beginWrite() only returns a pointer into it.
+//	Otherwise each region is mapped with glMapBufferRange unsynchronized
+//	(the fences do the synchronizing) and unmapped again in endWrite().
+//
+//	The persistent mapping can also be written from other threads, which
+//	pick regions themselves instead of beginWrite(): regionData() is where
+//	they write, select() makes a region the one drawn (and fenced) and
+//	isIdle() says whether the GPU is done with one. The mapping is readable
+//	too, so what was written there can be read back on the CPU (picking
+//	does) without keeping a copy of it.
+//
+//	All calls but regionData() need the GL context to be current.
+
+#ifndef STREAMING_BUFFER_H
+#define STREAMING_BUFFER_H
+
+#include <GL/glew.h>
+
+#include <cstddef>
+
+class StreamingBuffer {
+public:
+  enum { REGION_COUNT = 3, MAX_REGIONS = 8 };
+
+public:
+  StreamingBuffer();
+
+  // (Re)creates the buffer with regionCount (at most MAX_REGIONS) regions
+  // of at least regionSize bytes, orphaning any previous storage
+  void allocate(size_t regionSize, int regionCount = REGION_COUNT);
+  void release();
+
+  // Moves on to the next region, waiting for the GPU to be done with it,
+  // and returns where its regionSize bytes are written
+  void *beginWrite();
+  void endWrite();
+  // Call after the draws that read the current region were issued
+  void fence();
+
+  // Persistently mapped buffers only (nullptr otherwise): where region is
+  // written, from any thread, while the GPU is not reading it
+  void *regionData(int region) const;
+  // Makes region the current one, drawn from and fenced, without writing
+  void select(int region) { m_region = region; }
+  // Whether the draws fenced on region are done. Never waits.
+  bool isIdle(int region);
+
+  GLuint id() const { return m_buffer; }
+  // Byte offset of the current region, to point attributes at
+  size_t regionOffset() const { return m_region * m_regionSize; }
+  size_t regionSize() const { return m_regionSize; }
+  int regionCount() const { return m_regionCount; }
+  bool isPersistent() const { return m_mapped != nullptr; }
+
+private:
+  void waitFor(int region);
+
+  GLuint m_buffer;
+  size_t m_regionSize;
+  int m_regionCount;
+  int m_region;
+  char *m_mapped; // whole buffer when persistently mapped
+  GLsync m_fences[MAX_REGIONS];
+};
+
+#endif // STREAMING_BUFFER_H
@@ -0,0 +1,192 @@
+#include "TextOverlay.h"
+
+#include <cctype>
+
+#include "ShaderTools.h"
+
+namespace {
+
+int const GLYPH_WIDTH = 5;
+int const GLYPH_HEIGHT = 7;
+// font pixels from one character / line to the next
+int const ADVANCE = GLYPH_WIDTH + 1;
+int const LINE_HEIGHT = GLYPH_HEIGHT + 3;
+// font pixels between the text and the window corner
+int const MARGIN = 4;
+
+Vec3f const SHADOW_COLOR(0.f, 0.f, 0.f);
+
+// Rows from the top, bit 4 is the leftmost pixel
+struct Glyph {
+  char c;
+  unsigned char rows[GLYPH_HEIGHT];
+};
+
+Glyph const FONT[] = {
+    {'0', {0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E}},
+    {'1', {0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E}},
+    {'2', {0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F}},
+    {'3', {0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E}},
+    {'4', {0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02}},
+    {'5', {0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E}},
+    {'6', {0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E}},
+    {'7', {0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08}},
+    {'8', {0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E}},
+    {'9', {0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C}},
+    {'A', {0x0E, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11}},
+    {'B', {0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E}},
+    {'C', {0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E}},
+    {'D', {0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C}},
+    {'E', {0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F}},
+    {'F', {0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10}},
+    {'G', {0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F}},
+    {'H', {0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11}},
+    {'I', {0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E}},
+    {'J', {0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C}},
+    {'K', {0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11}},
+    {'L', {0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F}},
+    {'M', {0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11}},
+    {'N', {0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11}},
+    {'O', {0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E}},
+    {'P', {0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10}},
+    {'Q', {0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D}},
+    {'R', {0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11}},
+    {'S', {0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E}},
+    {'T', {0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04}},
+    {'U', {0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E}},
+    {'V', {0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04}},
+    {'W', {0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A}},
+    {'X', {0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11}},
+    {'Y', {0x11, 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04}},
+    {'Z', {0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F}},
+    {'.', {0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C}},
+    {',', {0x00, 0x00, 0x00, 0x00, 0x0C, 0x04, 0x08}},
+    {':', {0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00}},
+    {'-', {0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00}},
+    {'+', {0x00, 0x04, 0x04, 0x1F, 0x04, 0x04, 0x00}},
+    {'=', {0x00, 0x00, 0x1F, 0x00, 0x1F, 0x00, 0x00}},
+    {'_', {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1F}},
+    {'/', {0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00}},
+    {'%', {0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03}},
+    {'(', {0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02}},
+    {')', {0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08}},
+};
+
+Glyph const *findGlyph(char c) {
+  c = char(std::toupper(static_cast<unsigned char>(c)));
+  for (auto const &glyph : FONT) {
+    if (glyph.c == c)
+      return &glyph;
+  }
+  return nullptr;
+}
+
+} // namespace
+
+// ======== CONSTRUCTORS ====================================================//
+TextOverlay::TextOverlay()
+    : m_program(0), m_vao(0), m_buffer(0), m_dirty(false), m_vertexCount(0),
+      m_scale(2), m_color(1.f, 1.f, 1.f) {}
+// ==========================================================================//
+
+bool TextOverlay::allocate() {
+  release();
+
+  std::string vsSource = loadShaderStringfromFile("./shaders/overlay_vs.glsl");
+  std::string fsSource = loadShaderStringfromFile("./shaders/overlay_fs.glsl");
+  m_program = CreateShaderProgram(vsSource, fsSource);
+  if (m_program == 0)
+    return false;
+
+  glGenVertexArrays(1, &m_vao);
+  glGenBuffers(1, &m_buffer);
+
+  glBindVertexArray(m_vao);
+  glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+  glEnableVertexAttribArray(0); // match layout # in shader
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float),
+                        (void *)0);
+  glBindVertexArray(0);
+
+  m_dirty = true; // text set before allocate() still shows
+  return true;
+}
+
+void TextOverlay::release() {
+  if (m_program == 0)
+    return;
+
+  glDeleteProgram(m_program);
+  glDeleteVertexArrays(1, &m_vao);
+  glDeleteBuffers(1, &m_buffer);
+  m_program = m_vao = m_buffer = 0;
+  m_vertexCount = 0;
+}
+
+void TextOverlay::setText(std::vector<std::string> const &lines, int scale) {
+  m_scale = scale;
+  m_vertices.clear();
+
+  // two triangles per lit font pixel
+  auto square = [this](float x, float y) {
+    float const s = float(m_scale);
+    float const corners[] = {x, y,     x + s, y,     x + s, y + s,
+                             x, y,     x + s, y + s, x,     y + s};
+    m_vertices.insert(m_vertices.end(), corners, corners + 12);
+  };
+
+  for (size_t line = 0; line < lines.size(); ++line) {
+    int top = (MARGIN + int(line) * LINE_HEIGHT) * scale;
+    for (size_t i = 0; i < lines[line].size(); ++i) {
+      Glyph const *glyph = findGlyph(lines[line][i]);
+      if (!glyph)
+        continue;
+      int left = (MARGIN + int(i) * ADVANCE) * scale;
+      for (int r = 0; r < GLYPH_HEIGHT; ++r) {
+        for (int c = 0; c < GLYPH_WIDTH; ++c) {
+          if (glyph->rows[r] & (0x10 >> c))
+            square(float(left + c * scale), float(top + r * scale));
+        }
+      }
+    }
+  }
+
+  m_dirty = true;
+}
+
+void TextOverlay::draw(int framebufferWidth, int framebufferHeight) {
+  if (m_program == 0)
+    return;
+
+  if (m_dirty) {
+    glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * m_vertices.size(),
+                 m_vertices.data(), GL_DYNAMIC_DRAW);
+    m_vertexCount = GLsizei(m_vertices.size() / 2);
+    m_dirty = false;
+  }
+  if (m_vertexCount == 0)
+    return;
+
+  GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+  glDisable(GL_DEPTH_TEST);
+
+  glUseProgram(m_program);
+  glUniform2f(glGetUniformLocation(m_program, "viewSize"),
+              float(framebufferWidth), float(framebufferHeight));
+  GLint offset = glGetUniformLocation(m_program, "offset");
+  GLint color = glGetUniformLocation(m_program, "inputColor");
+
+  glBindVertexArray(m_vao);
+  // shadow one font pixel down and right, then the text
+  glUniform2f(offset, float(m_scale), float(m_scale));
+  glUniform3f(color, SHADOW_COLOR.x(), SHADOW_COLOR.y(), SHADOW_COLOR.z());
+  glDrawArrays(GL_TRIANGLES, 0, m_vertexCount);
+  glUniform2f(offset, 0.f, 0.f);
+  glUniform3f(color, m_color.x(), m_color.y(), m_color.z());
+  glDrawArrays(GL_TRIANGLES, 0, m_vertexCount);
+  glBindVertexArray(0);
+
+  if (depthTest)
+    glEnable(GL_DEPTH_TEST);
+}
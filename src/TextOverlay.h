@@ -0,0 +1,52 @@
+//
+//  TextOverlay.h
+//
+//	Lines of text drawn over the scene, for on screen statistics.
+//
+//	Uses a built in 5x7 pixel font of upper case letters (lower case is
+//	drawn as upper case), digits and some punctuation; anything else is a
+//	space. setText() turns every lit font pixel into a square of scale
+//	framebuffer pixels, so text only costs uploading a few triangles when
+//	it changes and one draw per frame. It is drawn with a dark shadow to
+//	stay readable over any background.
+//
+//	All calls but setText() need the GL context to be current.
+
+#ifndef TEXT_OVERLAY_H
+#define TEXT_OVERLAY_H
+
+#include <GL/glew.h>
+
+#include <string>
+#include <vector>
+
+#include "Vec3f.h"
+
+class TextOverlay {
+public:
+  TextOverlay();
+
+  // Loads the overlay shaders from ./shaders, returns false if they fail
+  bool allocate();
+  void release();
+
+  // Lines from the top left corner, scale framebuffer pixels per font pixel
+  void setText(std::vector<std::string> const &lines, int scale = 2);
+  // Draws over whatever is in the framebuffer of the given size
+  void draw(int framebufferWidth, int framebufferHeight);
+
+  Vec3f const &color() const { return m_color; }
+  void setColor(Vec3f const &color) { m_color = color; }
+
+private:
+  GLuint m_program;
+  GLuint m_vao;
+  GLuint m_buffer;
+  std::vector<float> m_vertices; // xy pixel positions of the triangles
+  bool m_dirty; // m_vertices not uploaded yet
+  GLsizei m_vertexCount; // uploaded
+  int m_scale;
+  Vec3f m_color;
+};
+
+#endif // TEXT_OVERLAY_H
@@ -0,0 +1,136 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+int ThreadPool::hardwareThreads() {
+  unsigned n = std::thread::hardware_concurrency();
+  return n > 0 ? int(n) : 1;
+}
+
+// ======================== CONSTRUCTORS ============================//
+ThreadPool::ThreadPool(int threadCount)
+    : m_func(nullptr), m_count(0), m_chunks(0), m_pending(0),
+      m_generation(0), m_stop(false) {
+  startWorkers(std::max(threadCount, 1) - 1);
+}
+
+ThreadPool::~ThreadPool() { stopWorkers(); }
+// ==========================================================================//
+
+int ThreadPool::threadCount() const { return int(m_workers.size()) + 1; }
+
+void ThreadPool::resize(int threadCount) {
+  threadCount = std::max(threadCount, 1);
+  if (threadCount == this->threadCount())
+    return;
+
+  stopWorkers();
+  startWorkers(threadCount - 1);
+}
+
+void ThreadPool::parallelFor(size_t count, RangeFunc const &func,
+                             size_t minChunk) {
+  if (count == 0)
+    return;
+
+  int chunks = chunkCount(count, minChunk);
+  if (chunks == 1) {
+    func(0, count);
+    return;
+  }
+
+  run(count, chunks,
+      [&func](int, size_t begin, size_t end) { func(begin, end); });
+}
+
+double ThreadPool::parallelSum(size_t count, SumFunc const &func,
+                               size_t minChunk) {
+  if (count == 0)
+    return 0;
+
+  int chunks = chunkCount(count, minChunk);
+  if (chunks == 1)
+    return func(0, count);
+
+  std::vector<double> sums(chunks, 0.0);
+  run(count, chunks, [&](int chunk, size_t begin, size_t end) {
+    sums[chunk] = func(begin, end);
+  });
+
+  double sum = 0;
+  for (double s : sums)
+    sum += s;
+  return sum;
+}
+
+int ThreadPool::chunkCount(size_t count, size_t minChunk) const {
+  size_t maxChunks = std::max<size_t>(count / std::max<size_t>(minChunk, 1), 1);
+  return int(std::min<size_t>(threadCount(), maxChunks));
+}
+
+void ThreadPool::run(size_t count, int chunks, ChunkFunc const &func) {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_func = &func;
+    m_count = count;
+    m_chunks = chunks;
+    m_pending = chunks - 1;
+    ++m_generation;
+  }
+  m_wake.notify_all();
+
+  runChunk(0);
+
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_done.wait(lock, [this] { return m_pending == 0; });
+  m_func = nullptr;
+}
+
+void ThreadPool::runChunk(int chunk) {
+  size_t begin = m_count * chunk / m_chunks;
+  size_t end = m_count * (chunk + 1) / m_chunks;
+  (*m_func)(chunk, begin, end);
+}
+
+// seen is the generation of the last job run before the worker started,
+// which it must not pick up
+void ThreadPool::workerLoop(int worker, unsigned long seen) {
+  int chunk = worker + 1; // chunk 0 belongs to the calling thread
+
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_wake.wait(lock, [&] { return m_stop || m_generation != seen; });
+      if (m_stop)
+        return;
+      seen = m_generation;
+      if (chunk >= m_chunks)
+        continue; // not enough work for this thread
+    }
+
+    runChunk(chunk);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (--m_pending == 0)
+      m_done.notify_one();
+  }
+}
+
+void ThreadPool::startWorkers(int workerCount) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_stop = false;
+  for (int i = 0; i < workerCount; ++i)
+    m_workers.emplace_back(&ThreadPool::workerLoop, this, i, m_generation);
+}
+
+void ThreadPool::stopWorkers() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_wake.notify_all();
+
+  for (auto &worker : m_workers)
+    worker.join();
+  m_workers.clear();
+}
@@ -0,0 +1,75 @@
+//
+//  ThreadPool.h
+//
+//	Small fixed size pool of worker threads used to split the per mass and
+//	per spring loops of a simulation step across cores.
+//
+//	parallelFor() hands every thread one contiguous chunk of the range, the
+//	calling thread works on the first chunk itself, and returns once all
+//	chunks are done. Chunk boundaries only depend on the range and the
+//	thread count, so a given configuration always splits work the same way,
+//	and parallelSum() adds the per chunk results in chunk order so sums are
+//	reproducible run to run.
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+class ThreadPool {
+public:
+  typedef std::function<void(size_t begin, size_t end)> RangeFunc;
+  typedef std::function<double(size_t begin, size_t end)> SumFunc;
+
+  static int hardwareThreads();
+
+public:
+  explicit ThreadPool(int threadCount = 1);
+  ~ThreadPool();
+
+  ThreadPool(ThreadPool const &) = delete;
+  ThreadPool &operator=(ThreadPool const &) = delete;
+
+  // Number of threads working on a range, including the caller
+  int threadCount() const;
+  void resize(int threadCount);
+
+  // Ranges shorter than minChunk per thread use fewer threads
+  void parallelFor(size_t count, RangeFunc const &func,
+                   size_t minChunk = 1024);
+  double parallelSum(size_t count, SumFunc const &func,
+                     size_t minChunk = 1024);
+
+private:
+  typedef std::function<void(int chunk, size_t begin, size_t end)> ChunkFunc;
+
+  int chunkCount(size_t count, size_t minChunk) const;
+  void run(size_t count, int chunks, ChunkFunc const &func);
+
+  void startWorkers(int workerCount);
+  void stopWorkers();
+  void workerLoop(int worker, unsigned long seen);
+  void runChunk(int chunk);
+
+private:
+  std::vector<std::thread> m_workers;
+
+  std::mutex m_mutex;
+  std::condition_variable m_wake;
+  std::condition_variable m_done;
+
+  // current job, guarded by m_mutex
+  ChunkFunc const *m_func;
+  size_t m_count;
+  int m_chunks;
+  int m_pending;
+  unsigned long m_generation;
+  bool m_stop;
+};
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,381 @@
+#include "Trajectory.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+static_assert(sizeof(TrajectoryHeader) == 64, "trajectory header layout");
+static_assert(sizeof(TrajectoryFrameHeader) == 16, "frame header layout");
+static_assert(sizeof(TrajectoryIndexEntry) == 16, "index entry layout");
+
+namespace {
+
+char const MAGIC[8] = {'M', 'S', 'T', 'R', 'A', 'J', '\0', '\0'};
+uint32_t const ENDIAN_TAG = 0x01020304;
+// longest varint of a residual, which fits in 35 bits
+size_t const MAX_VARINT_BYTES = 5;
+
+int32_t quantize(float x, double invQuantum) {
+  double q = std::round(double(x) * invQuantum);
+  if (!(q > -2147483647.0)) // NaN too
+    return q < 0.0 ? -2147483647 : 0;
+  return q < 2147483647.0 ? int32_t(q) : 2147483647;
+}
+
+// Of the value at k: 0 in keyframes, the last value in the frame after
+// one, else the last value plus the last change
+inline int64_t predict(std::vector<int32_t> const *q, size_t frameInSegment,
+                       size_t k) {
+  if (frameInSegment == 0)
+    return 0;
+  if (frameInSegment == 1)
+    return q[1][k];
+  return 2 * int64_t(q[1][k]) - q[2][k];
+}
+
+// Makes the frame before the oldest of q the newest, to be overwritten
+void rotate(std::vector<int32_t> *q) {
+  std::swap(q[2], q[1]);
+  std::swap(q[1], q[0]);
+}
+
+inline uint8_t *putVarint(uint8_t *out, int64_t value) {
+  uint64_t u = (uint64_t(value) << 1) ^ uint64_t(value >> 63); // zigzag
+  while (u >= 0x80) {
+    *out++ = uint8_t(u | 0x80);
+    u >>= 7;
+  }
+  *out++ = uint8_t(u);
+  return out;
+}
+
+// nullptr if the varint runs past end
+inline uint8_t const *getVarint(uint8_t const *in, uint8_t const *end,
+                                int64_t &value) {
+  uint64_t u = 0;
+  for (int shift = 0; in < end && shift < 64; shift += 7) {
+    uint8_t byte = *in++;
+    u |= uint64_t(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      value = int64_t(u >> 1) ^ -int64_t(u & 1);
+      return in;
+    }
+  }
+  return nullptr;
+}
+
+} // namespace
+
+// ======== CONSTRUCTORS ====================================================//
+TrajectoryWriter::TrajectoryWriter()
+    : m_massCount(0), m_period(0.0), m_nextTime(0.0), m_recorded(0),
+      m_dropped(0), m_buffers(0), m_closing(false), m_offset(0),
+      m_failed(false) {}
+
+TrajectoryWriter::~TrajectoryWriter() { close(); }
+
+TrajectoryReader::TrajectoryReader()
+    : m_massCount(0), m_quantum(0.f), m_keyframeInterval(1), m_decoded(-1) {}
+// ==========================================================================//
+
+bool TrajectoryWriter::open(std::string const &path, size_t massCount,
+                            float framesPerSecond, float quantum,
+                            int keyframeInterval) {
+  close();
+
+  m_file.open(path.c_str(), std::ios::binary | std::ios::trunc);
+  if (!m_file) {
+    std::cerr << "Could Not Open File " << path << std::endl;
+    return false;
+  }
+
+  std::memset(&m_header, 0, sizeof(m_header));
+  std::memcpy(m_header.magic, MAGIC, sizeof(MAGIC));
+  m_header.version = TRAJECTORY_VERSION;
+  m_header.byteOrder = ENDIAN_TAG;
+  m_header.massCount = massCount;
+  m_header.quantum = quantum;
+  m_header.keyframeInterval = uint32_t(std::max(keyframeInterval, 1));
+  // counts and index are filled in by close()
+  m_file.write(reinterpret_cast<char const *>(&m_header), sizeof(m_header));
+
+  m_path = path;
+  m_massCount = massCount;
+  m_period = framesPerSecond > 0.f ? 1.0 / framesPerSecond : 0.0;
+  m_nextTime = -std::numeric_limits<double>::infinity();
+  m_recorded = m_dropped = 0;
+  m_queue.clear();
+  m_free.clear();
+  m_buffers = 0;
+  m_closing = false;
+  m_index.clear();
+  for (auto &q : m_q)
+    q.assign(3 * massCount, 0);
+  m_payload.resize(3 * massCount * MAX_VARINT_BYTES);
+  m_offset = sizeof(m_header);
+  m_failed = !m_file;
+
+  m_thread = std::thread(&TrajectoryWriter::run, this);
+  return true;
+}
+
+bool TrajectoryWriter::close() {
+  if (!m_thread.joinable())
+    return !m_failed;
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_closing = true;
+  }
+  m_wake.notify_one();
+  m_thread.join();
+
+  m_header.frameCount = m_index.size();
+  m_header.indexOffset = m_offset;
+  m_file.write(reinterpret_cast<char const *>(m_index.data()),
+               m_index.size() * sizeof(TrajectoryIndexEntry));
+  m_offset += m_index.size() * sizeof(TrajectoryIndexEntry);
+  m_file.seekp(0);
+  m_file.write(reinterpret_cast<char const *>(&m_header), sizeof(m_header));
+  m_file.close();
+
+  if (m_failed || !m_file) {
+    std::cerr << "Could Not Write File " << m_path << std::endl;
+    m_failed = true;
+  }
+  m_free.clear();
+  return !m_failed;
+}
+
+void TrajectoryWriter::record(double time, Vec3f const *positions) {
+  if (!m_thread.joinable() || time < m_nextTime)
+    return;
+  // on the frame grid, unless steps are longer than frames
+  m_nextTime += m_period;
+  if (m_nextTime <= time)
+    m_nextTime = time + m_period;
+
+  Frame frame;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_free.empty()) {
+      frame = std::move(m_free.back());
+      m_free.pop_back();
+    } else if (m_buffers < MAX_PENDING) {
+      ++m_buffers;
+    } else {
+      ++m_dropped;
+      return;
+    }
+  }
+
+  frame.time = time;
+  frame.positions.assign(positions, positions + m_massCount);
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_queue.push_back(std::move(frame));
+  }
+  m_wake.notify_one();
+  ++m_recorded;
+}
+
+void TrajectoryWriter::run() {
+  for (;;) {
+    Frame frame;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_wake.wait(lock, [this]() { return !m_queue.empty() || m_closing; });
+      if (m_queue.empty())
+        return;
+      frame = std::move(m_queue.front());
+      m_queue.pop_front();
+    }
+
+    write(frame);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_free.push_back(std::move(frame));
+  }
+}
+
+void TrajectoryWriter::write(Frame const &frame) {
+  size_t const frameInSegment = m_index.size() % m_header.keyframeInterval;
+  double const invQuantum = 1.0 / m_header.quantum;
+
+  rotate(m_q);
+  float const *x = reinterpret_cast<float const *>(frame.positions.data());
+  int32_t *q = m_q[0].data();
+  uint8_t *out = m_payload.data();
+  for (size_t k = 0; k < 3 * m_massCount; ++k) {
+    q[k] = quantize(x[k], invQuantum);
+    out = putVarint(out, q[k] - predict(m_q, frameInSegment, k));
+  }
+
+  TrajectoryFrameHeader header;
+  header.payloadSize = uint32_t(out - m_payload.data());
+  header.flags = frameInSegment == 0 ? TRAJECTORY_KEYFRAME : 0;
+  header.time = frame.time;
+  m_file.write(reinterpret_cast<char const *>(&header), sizeof(header));
+  m_file.write(reinterpret_cast<char const *>(m_payload.data()),
+               header.payloadSize);
+  if (!m_file)
+    m_failed = true;
+
+  TrajectoryIndexEntry entry = {m_offset, frame.time};
+  m_index.push_back(entry);
+  m_offset += sizeof(header) + header.payloadSize;
+}
+
+bool TrajectoryReader::open(std::string const &path) {
+  close();
+  if (!m_file.open(path))
+    return false;
+
+  TrajectoryHeader header;
+  if (m_file.size() < sizeof(header)) {
+    std::cerr << "Not a trajectory file " << path << std::endl;
+    close();
+    return false;
+  }
+  std::memcpy(&header, m_file.data(), sizeof(header));
+  if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+      header.byteOrder != ENDIAN_TAG) {
+    std::cerr << "Not a trajectory file " << path << std::endl;
+    close();
+    return false;
+  }
+  if (header.version != TRAJECTORY_VERSION || !(header.quantum > 0.f) ||
+      header.keyframeInterval == 0 ||
+      header.massCount > m_file.size() / sizeof(Vec3f)) {
+    std::cerr << "Unsupported trajectory file " << path << std::endl;
+    close();
+    return false;
+  }
+
+  m_path = path;
+  m_massCount = size_t(header.massCount);
+  m_quantum = header.quantum;
+  m_keyframeInterval = int(header.keyframeInterval);
+  for (auto &q : m_q)
+    q.assign(3 * m_massCount, 0);
+  m_decoded = -1;
+
+  if (!buildIndex(header)) {
+    close();
+    return false;
+  }
+  return true;
+}
+
+void TrajectoryReader::close() {
+  m_file.close();
+  m_index.clear();
+  m_massCount = 0;
+  m_decoded = -1;
+}
+
+// From the index at the end, or if the writer never wrote one from the
+// frame headers, up to the first frame cut short
+bool TrajectoryReader::buildIndex(TrajectoryHeader const &header) {
+  uint64_t const size = m_file.size();
+  m_index.clear();
+
+  if (header.indexOffset != 0) {
+    if (header.indexOffset > size ||
+        header.frameCount > (size - header.indexOffset) /
+                                sizeof(TrajectoryIndexEntry)) {
+      std::cerr << "Broken index in trajectory file " << m_path << std::endl;
+      return false;
+    }
+    TrajectoryIndexEntry const *index =
+        reinterpret_cast<TrajectoryIndexEntry const *>(m_file.data() +
+                                                       header.indexOffset);
+    m_index.assign(index, index + header.frameCount);
+    return true;
+  }
+
+  uint64_t offset = sizeof(TrajectoryHeader);
+  while (size - offset >= sizeof(TrajectoryFrameHeader)) {
+    TrajectoryFrameHeader frame;
+    std::memcpy(&frame, m_file.data() + offset, sizeof(frame));
+    uint64_t end = offset + sizeof(frame) + frame.payloadSize;
+    if (end > size)
+      break;
+    TrajectoryIndexEntry entry = {offset, frame.time};
+    m_index.push_back(entry);
+    offset = end;
+  }
+  std::cerr << "Trajectory file " << m_path << " was not closed, found "
+            << m_index.size() << " frames" << std::endl;
+  return true;
+}
+
+size_t TrajectoryReader::frameAt(double time) const {
+  auto after = std::upper_bound(
+      m_index.begin(), m_index.end(), time,
+      [](double t, TrajectoryIndexEntry const &e) { return t < e.time; });
+  return after == m_index.begin() ? 0 : size_t(after - m_index.begin()) - 1;
+}
+
+bool TrajectoryReader::read(size_t frame, Vec3f *out) {
+  if (frame >= m_index.size()) {
+    std::cerr << "No frame " << frame << " in trajectory file " << m_path
+              << std::endl;
+    return false;
+  }
+
+  if (long(frame) != m_decoded) {
+    size_t key = frame - frame % m_keyframeInterval;
+    size_t first = m_decoded >= long(key) && m_decoded < long(frame)
+                       ? size_t(m_decoded) + 1
+                       : key;
+    for (size_t f = first; f <= frame; ++f) {
+      if (!decode(f)) {
+        m_decoded = -1;
+        std::cerr << "Broken frame " << f << " in trajectory file " << m_path
+                  << std::endl;
+        return false;
+      }
+      m_decoded = long(f);
+    }
+  }
+
+  double const quantum = m_quantum;
+  int32_t const *q = m_q[0].data();
+  for (size_t i = 0; i < m_massCount; ++i) {
+    out[i] = Vec3f(float(q[3 * i] * quantum), float(q[3 * i + 1] * quantum),
+                   float(q[3 * i + 2] * quantum));
+  }
+  return true;
+}
+
+// Into m_q[0], the two frames before frame in m_q[0] and m_q[1] unless it
+// is a keyframe
+bool TrajectoryReader::decode(size_t frame) {
+  uint64_t const offset = m_index[frame].offset;
+  if (offset > m_file.size() ||
+      m_file.size() - offset < sizeof(TrajectoryFrameHeader))
+    return false;
+  TrajectoryFrameHeader header;
+  std::memcpy(&header, m_file.data() + offset, sizeof(header));
+  if (header.payloadSize > m_file.size() - offset - sizeof(header))
+    return false;
+
+  uint8_t const *in = reinterpret_cast<uint8_t const *>(m_file.data()) +
+                      offset + sizeof(header);
+  uint8_t const *end = in + header.payloadSize;
+  size_t const frameInSegment = frame % m_keyframeInterval;
+
+  rotate(m_q);
+  int32_t *q = m_q[0].data();
+  for (size_t k = 0; k < 3 * m_massCount; ++k) {
+    int64_t residual;
+    in = getVarint(in, end, residual);
+    if (!in)
+      return false;
+    q[k] = int32_t(predict(m_q, frameInSegment, k) + residual);
+  }
+  return in == end;
+}
@@ -0,0 +1,173 @@
+//
+//  Trajectory.h
+//
+//	Recorded mass positions over time, streamed to a binary file while the
+//	simulation runs and played back later without simulating again.
+//
+//	Positions are stored as integer multiples of quantum() (rounded, so off
+//	by at most half of it). Every keyframeInterval() frames a keyframe
+//	stores them as they are, the frames in between only the difference to
+//	a prediction from the two frames before (x_t-1 + (x_t-1 - x_t-2)), so
+//	masses moving steadily or at rest cost about a byte per coordinate.
+//	Numbers are zigzag varints: small ones take few bytes, and decoding is
+//	a byte loop with no tables. Quantized values are decoded exactly, so
+//	the error never builds up between keyframes.
+//
+//	Layout (native little endian, version 1):
+//	  TrajectoryHeader       64 bytes, magic "MSTRAJ", counts, quantum
+//	  frames                 TrajectoryFrameHeader then its payload each
+//	  TrajectoryIndexEntry   one per frame, the seek index, at indexOffset
+//	A file whose writer never got to close() has no index (indexOffset 0)
+//	and is indexed by reading the frame headers instead.
+//
+//	The writer records from the stepping thread: a frame is a copy into a
+//	recycled buffer, and a thread of its own encodes and writes it. If
+//	MAX_PENDING frames are waiting already the frame is dropped (and
+//	counted) rather than holding up the steps.
+
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "MappedFile.h"
+#include "Vec3f.h"
+
+enum { TRAJECTORY_VERSION = 1 };
+
+struct TrajectoryHeader {
+  char magic[8]; // "MSTRAJ\0\0"
+  uint32_t version;
+  uint32_t byteOrder; // 0x01020304 as written
+  uint64_t massCount;
+  uint64_t frameCount;  // 0 until closed
+  uint64_t indexOffset; // 0 until closed
+  float quantum;
+  uint32_t keyframeInterval;
+  uint8_t reserved[16];
+};
+
+struct TrajectoryFrameHeader {
+  uint32_t payloadSize; // bytes following this header
+  uint32_t flags;       // TRAJECTORY_KEYFRAME
+  double time;          // simulated seconds
+};
+
+enum { TRAJECTORY_KEYFRAME = 1 };
+
+struct TrajectoryIndexEntry {
+  uint64_t offset; // of the frame header
+  double time;
+};
+
+class TrajectoryWriter {
+public:
+  enum { MAX_PENDING = 64 };
+
+public:
+  TrajectoryWriter();
+  ~TrajectoryWriter();
+
+  TrajectoryWriter(TrajectoryWriter const &) = delete;
+  TrajectoryWriter &operator=(TrajectoryWriter const &) = delete;
+
+  // A frame every 1 / framesPerSecond simulated seconds at most, 0 records
+  // every one given. Prints what went wrong to std::cerr and returns false
+  // on failure.
+  bool open(std::string const &path, size_t massCount, float framesPerSecond,
+            float quantum = 1e-4f, int keyframeInterval = 64);
+  // Waits for the frames still queued and writes the index, returns false
+  // if anything could not be written
+  bool close();
+  bool isOpen() const { return m_thread.joinable(); }
+
+  // Stepping thread: records massCount positions at time, if a frame is due
+  void record(double time, Vec3f const *positions);
+
+  // Frames recorded and dropped, and the size of the file once closed
+  unsigned long frameCount() const { return m_recorded; }
+  unsigned long droppedCount() const { return m_dropped; }
+  uint64_t fileSize() const { return m_offset; }
+
+private:
+  struct Frame {
+    double time;
+    std::vector<Vec3f> positions;
+  };
+
+  void run();
+  void write(Frame const &frame);
+
+private:
+  size_t m_massCount;
+  double m_period;
+  double m_nextTime;
+  unsigned long m_recorded;
+  unsigned long m_dropped;
+
+  std::mutex m_mutex;
+  std::condition_variable m_wake;
+  std::deque<Frame> m_queue;
+  std::vector<Frame> m_free; // recycled buffers
+  size_t m_buffers;          // queued, free or being written
+  bool m_closing;
+  std::thread m_thread;
+
+  // writer thread only, until it has been joined
+  std::string m_path;
+  std::ofstream m_file;
+  TrajectoryHeader m_header;
+  std::vector<TrajectoryIndexEntry> m_index;
+  std::vector<int32_t> m_q[3]; // this frame and the two before, quantized
+  std::vector<uint8_t> m_payload;
+  uint64_t m_offset;
+  bool m_failed;
+};
+
+class TrajectoryReader {
+public:
+  TrajectoryReader();
+
+  // Prints what went wrong to std::cerr and returns false on failure
+  bool open(std::string const &path);
+  void close();
+  bool isOpen() const { return m_file.isOpen(); }
+
+  size_t massCount() const { return m_massCount; }
+  size_t frameCount() const { return m_index.size(); }
+  float quantum() const { return m_quantum; }
+  int keyframeInterval() const { return m_keyframeInterval; }
+  double frameTime(size_t frame) const { return m_index[frame].time; }
+  // Last frame at or before time, the first one before it starts
+  size_t frameAt(double time) const;
+
+  // Writes the massCount() positions of frame to out. Reading the frame
+  // after the last one read decodes just that frame, any other first
+  // decodes the frames since its keyframe. Prints what went wrong to
+  // std::cerr and returns false if the frame is broken.
+  bool read(size_t frame, Vec3f *out);
+
+private:
+  bool decode(size_t frame);
+  bool buildIndex(TrajectoryHeader const &header);
+
+private:
+  std::string m_path;
+  MappedFile m_file;
+  size_t m_massCount;
+  float m_quantum;
+  int m_keyframeInterval;
+  std::vector<TrajectoryIndexEntry> m_index;
+
+  std::vector<int32_t> m_q[3]; // as in the writer
+  long m_decoded;              // frame m_q[0] holds, -1 for none
+};
+
+#endif // TRAJECTORY_H
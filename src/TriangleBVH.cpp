@@ -0,0 +1,611 @@
+#include "TriangleBVH.h"
+
+#include <algorithm>
+#include <limits>
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+namespace {
+
+int const MAX_LEAF_SIZE = 4;
+int const SAH_BINS = 16;
+// relative costs of visiting a node and testing a triangle
+float const TRAVERSAL_COST = 1.f;
+float const TRIANGLE_COST = 1.f;
+// deeper nodes are split at the median, which bounds the depth of the tree
+// (and the traversal stack) even for degenerate input
+int const MAX_SAH_DEPTH = 48;
+int const STACK_SIZE = 256;
+
+float const INF = std::numeric_limits<float>::infinity();
+
+struct Box {
+  Box() : min(INF, INF, INF), max(-INF, -INF, -INF) {}
+
+  void grow(Vec3f const &p) {
+    for (int a = 0; a < 3; ++a) {
+      min[a] = std::min(min[a], p[a]);
+      max[a] = std::max(max[a], p[a]);
+    }
+  }
+  void grow(Box const &b) {
+    grow(b.min);
+    grow(b.max);
+  }
+  float area() const {
+    if (min.x() > max.x())
+      return 0.f;
+    Vec3f d = max - min;
+    return 2.f * (d.x() * d.y() + d.y() * d.z() + d.z() * d.x());
+  }
+
+  Vec3f min, max;
+};
+
+// Ericson, Real-Time Collision Detection 5.1.5
+Vec3f closestOnTriangle(Vec3f const &p, Vec3f const &a, Vec3f const &b,
+                        Vec3f const &c) {
+  Vec3f ab = b - a;
+  Vec3f ac = c - a;
+  Vec3f ap = p - a;
+  float d1 = ab * ap;
+  float d2 = ac * ap;
+  if (d1 <= 0.f && d2 <= 0.f)
+    return a;
+
+  Vec3f bp = p - b;
+  float d3 = ab * bp;
+  float d4 = ac * bp;
+  if (d3 >= 0.f && d4 <= d3)
+    return b;
+
+  float vc = d1 * d4 - d3 * d2;
+  if (vc <= 0.f && d1 >= 0.f && d3 <= 0.f)
+    return a + ab * (d1 / (d1 - d3));
+
+  Vec3f cp = p - c;
+  float d5 = ab * cp;
+  float d6 = ac * cp;
+  if (d6 >= 0.f && d5 <= d6)
+    return c;
+
+  float vb = d5 * d2 - d1 * d6;
+  if (vb <= 0.f && d2 >= 0.f && d6 <= 0.f)
+    return a + ac * (d2 / (d2 - d6));
+
+  float va = d3 * d6 - d5 * d4;
+  if (va <= 0.f && d4 - d3 >= 0.f && d5 - d6 >= 0.f)
+    return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+  float denom = 1.f / (va + vb + vc);
+  return a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+float boxDistance2(Vec3f const &p, Vec3f const &min, Vec3f const &max) {
+  float d2 = 0.f;
+  for (int a = 0; a < 3; ++a) {
+    float d = std::max(std::max(min[a] - p[a], p[a] - max[a]), 0.f);
+    d2 += d * d;
+  }
+  return d2;
+}
+
+} // namespace
+
+struct TriangleBVH::BuildNode {
+  Box box;
+  int left, right; // -1 in leaves
+  int first, count;
+};
+
+// ======== CONSTRUCTORS ====================================================//
+TriangleBVH::TriangleBVH() {}
+// ==========================================================================//
+
+void TriangleBVH::clear() {
+  m_nodes.clear();
+  m_blocks.clear();
+  m_tris.clear();
+  m_min = m_max = Vec3f();
+}
+
+void TriangleBVH::build(Mesh::Vertices const &verts,
+                        Mesh::Triangles const &tris) {
+  clear();
+  if (tris.empty())
+    return;
+
+  size_t const count = tris.size();
+  std::vector<Box> boxes(count);
+  std::vector<Vec3f> centroids(count);
+  std::vector<int> order(count);
+  for (size_t i = 0; i < count; ++i) {
+    boxes[i].grow(verts[tris[i].a].pos);
+    boxes[i].grow(verts[tris[i].b].pos);
+    boxes[i].grow(verts[tris[i].c].pos);
+    centroids[i] = (boxes[i].min + boxes[i].max) * 0.5f;
+    order[i] = int(i);
+  }
+
+  std::vector<BuildNode> build;
+  build.reserve(2 * count);
+
+  struct Task {
+    int node, begin, end, depth;
+  };
+  std::vector<Task> tasks;
+  build.push_back(BuildNode());
+  tasks.push_back({0, 0, int(count), 0});
+
+  while (!tasks.empty()) {
+    Task task = tasks.back();
+    tasks.pop_back();
+
+    int const n = task.end - task.begin;
+    Box box, centroidBox;
+    for (int i = task.begin; i < task.end; ++i) {
+      box.grow(boxes[order[i]]);
+      centroidBox.grow(centroids[order[i]]);
+    }
+    build[task.node].box = box;
+    build[task.node].left = build[task.node].right = -1;
+    build[task.node].first = task.begin;
+    build[task.node].count = n;
+
+    // best binned split over all three axes
+    float bestCost = INF;
+    int bestAxis = -1, bestBin = 0;
+    if (task.depth < MAX_SAH_DEPTH) {
+      for (int axis = 0; axis < 3; ++axis) {
+        float extent = centroidBox.max[axis] - centroidBox.min[axis];
+        if (!(extent > 0.f))
+          continue;
+        float scale = SAH_BINS / extent * (1.f - 1e-6f);
+
+        Box binBox[SAH_BINS];
+        int binCount[SAH_BINS] = {};
+        for (int i = task.begin; i < task.end; ++i) {
+          int t = order[i];
+          int b = int((centroids[t][axis] - centroidBox.min[axis]) * scale);
+          b = std::min(std::max(b, 0), SAH_BINS - 1);
+          binBox[b].grow(boxes[t]);
+          ++binCount[b];
+        }
+
+        // area and count right of every split, then sweep from the left
+        float rightArea[SAH_BINS];
+        int rightCount[SAH_BINS];
+        Box right;
+        int rightN = 0;
+        for (int b = SAH_BINS - 1; b > 0; --b) {
+          right.grow(binBox[b]);
+          rightN += binCount[b];
+          rightArea[b] = right.area();
+          rightCount[b] = rightN;
+        }
+        Box left;
+        int leftN = 0;
+        for (int b = 1; b < SAH_BINS; ++b) {
+          left.grow(binBox[b - 1]);
+          leftN += binCount[b - 1];
+          if (leftN == 0 || rightCount[b] == 0)
+            continue;
+          float cost = left.area() * leftN + rightArea[b] * rightCount[b];
+          if (cost < bestCost) {
+            bestCost = cost;
+            bestAxis = axis;
+            bestBin = b;
+          }
+        }
+      }
+    }
+
+    float const area = box.area();
+    float splitCost =
+        bestAxis < 0
+            ? INF
+            : TRAVERSAL_COST +
+                  (area > 0.f ? bestCost / area : 0.f) * TRIANGLE_COST;
+    if (n <= MAX_LEAF_SIZE && n * TRIANGLE_COST <= splitCost)
+      continue;
+
+    int mid;
+    if (bestAxis >= 0) {
+      int axis = bestAxis;
+      float scale = SAH_BINS / (centroidBox.max[axis] -
+                                centroidBox.min[axis]) * (1.f - 1e-6f);
+      float minC = centroidBox.min[axis];
+      mid = int(std::partition(order.begin() + task.begin,
+                               order.begin() + task.end,
+                               [&](int t) {
+                                 int b = int((centroids[t][axis] - minC) *
+                                             scale);
+                                 return std::min(std::max(b, 0),
+                                                 SAH_BINS - 1) < bestBin;
+                               }) -
+                order.begin());
+    } else {
+      // no usable split (coincident centroids or too deep), halve by index
+      // along the longest axis
+      Vec3f extent = centroidBox.max - centroidBox.min;
+      int axis = extent.x() >= extent.y()
+                     ? (extent.x() >= extent.z() ? 0 : 2)
+                     : (extent.y() >= extent.z() ? 1 : 2);
+      mid = task.begin + n / 2;
+      std::nth_element(order.begin() + task.begin, order.begin() + mid,
+                       order.begin() + task.end, [&](int a, int b) {
+                         return centroids[a][axis] < centroids[b][axis];
+                       });
+    }
+
+    int left = int(build.size());
+    build.push_back(BuildNode());
+    build.push_back(BuildNode());
+    build[task.node].left = left;
+    build[task.node].right = left + 1;
+    tasks.push_back({left, task.begin, mid, task.depth + 1});
+    tasks.push_back({left + 1, mid, task.end, task.depth + 1});
+  }
+
+  m_tris.resize(count);
+  for (size_t i = 0; i < count; ++i) {
+    Mesh::Triangle const &tri = tris[order[i]];
+    Triangle &t = m_tris[i];
+    t.a = verts[tri.a].pos;
+    t.b = verts[tri.b].pos;
+    t.c = verts[tri.c].pos;
+    t.normal = ((t.b - t.a) ^ (t.c - t.a)).normalized();
+    t.index = order[i];
+  }
+  m_min = build[0].box.min;
+  m_max = build[0].box.max;
+
+  m_nodes.reserve(build.size() / 2 + 1);
+  collapse(build, 0);
+}
+
+// Turns the binary subtree at root into 4-wide nodes: the inner child with
+// the largest surface area is opened until there are four children
+int TriangleBVH::collapse(std::vector<BuildNode> const &build, int root) {
+  int lanes[4];
+  int laneCount = 0;
+  if (build[root].left < 0) {
+    lanes[laneCount++] = root;
+  } else {
+    lanes[laneCount++] = build[root].left;
+    lanes[laneCount++] = build[root].right;
+    while (laneCount < 4) {
+      int open = -1;
+      float openArea = -1.f;
+      for (int k = 0; k < laneCount; ++k) {
+        BuildNode const &child = build[lanes[k]];
+        if (child.left >= 0 && child.box.area() > openArea) {
+          open = k;
+          openArea = child.box.area();
+        }
+      }
+      if (open < 0)
+        break;
+      int opened = lanes[open];
+      lanes[open] = build[opened].left;
+      lanes[laneCount++] = build[opened].right;
+    }
+  }
+
+  int index = int(m_nodes.size());
+  m_nodes.push_back(Node());
+  for (int k = 0; k < 4; ++k) {
+    Node &node = m_nodes[index];
+    for (int a = 0; a < 3; ++a) {
+      node.min[a][k] = INF;
+      node.max[a][k] = -INF;
+    }
+    node.child[k] = -1;
+    node.count[k] = 0;
+    if (k >= laneCount)
+      continue;
+
+    BuildNode const &child = build[lanes[k]];
+    for (int a = 0; a < 3; ++a) {
+      node.min[a][k] = child.box.min[a];
+      node.max[a][k] = child.box.max[a];
+    }
+    if (child.left < 0) {
+      node.child[k] = addBlock(child.first, child.count);
+      node.count[k] = child.count;
+    } else {
+      // may grow m_nodes, so node is looked up again for the next lane
+      int c = collapse(build, lanes[k]);
+      m_nodes[index].child[k] = c;
+    }
+  }
+  return index;
+}
+
+int TriangleBVH::addBlock(int first, int count) {
+  TriangleBlock block = {};
+  block.first = first;
+  for (int k = 0; k < count; ++k) {
+    Triangle const &t = m_tris[first + k];
+    Vec3f const edges[3] = {t.b - t.a, t.c - t.b, t.a - t.c};
+    for (int axis = 0; axis < 3; ++axis) {
+      block.a[axis][k] = t.a[axis];
+      block.normal[axis][k] = t.normal[axis];
+      for (int e = 0; e < 3; ++e)
+        block.edge[e][axis][k] = edges[e][axis];
+    }
+    for (int e = 0; e < 3; ++e) {
+      float length2 = edges[e] * edges[e];
+      block.invLength2[e][k] = length2 > 0.f ? 1.f / length2 : 0.f;
+    }
+  }
+  m_blocks.push_back(block);
+  return int(m_blocks.size()) - 1;
+}
+
+// The distance to a triangle is the distance to its plane if p is above
+// the triangle (inside all three edges), otherwise the distance to the
+// nearest edge
+void TriangleBVH::testBlock(Vec3f const &p, int blockIndex, int count,
+                            float &distance2, int &triangle) const {
+  TriangleBlock const &block = m_blocks[blockIndex];
+  alignas(16) float d2[4];
+
+#if defined(__SSE__)
+  __m128 const zero = _mm_setzero_ps();
+  __m128 const one = _mm_set1_ps(1.f);
+  __m128 const nx = _mm_load_ps(block.normal[0]);
+  __m128 const ny = _mm_load_ps(block.normal[1]);
+  __m128 const nz = _mm_load_ps(block.normal[2]);
+
+  // from the start of each edge to p, starting with a
+  __m128 sx = _mm_sub_ps(_mm_set1_ps(p.x()), _mm_load_ps(block.a[0]));
+  __m128 sy = _mm_sub_ps(_mm_set1_ps(p.y()), _mm_load_ps(block.a[1]));
+  __m128 sz = _mm_sub_ps(_mm_set1_ps(p.z()), _mm_load_ps(block.a[2]));
+
+  __m128 nd = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, sx), _mm_mul_ps(ny, sy)),
+                         _mm_mul_ps(nz, sz));
+  __m128 plane = _mm_mul_ps(nd, nd);
+  __m128 inside = _mm_cmpgt_ps(
+      _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny)),
+                 _mm_mul_ps(nz, nz)),
+      zero);
+  __m128 edgeMin = _mm_set1_ps(INF);
+
+  for (int e = 0; e < 3; ++e) {
+    __m128 ex = _mm_load_ps(block.edge[e][0]);
+    __m128 ey = _mm_load_ps(block.edge[e][1]);
+    __m128 ez = _mm_load_ps(block.edge[e][2]);
+
+    // nearest point on the edge
+    __m128 t = _mm_mul_ps(
+        _mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, ex), _mm_mul_ps(sy, ey)),
+                   _mm_mul_ps(sz, ez)),
+        _mm_load_ps(block.invLength2[e]));
+    t = _mm_min_ps(_mm_max_ps(t, zero), one);
+    __m128 vx = _mm_sub_ps(sx, _mm_mul_ps(ex, t));
+    __m128 vy = _mm_sub_ps(sy, _mm_mul_ps(ey, t));
+    __m128 vz = _mm_sub_ps(sz, _mm_mul_ps(ez, t));
+    edgeMin = _mm_min_ps(
+        edgeMin,
+        _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)),
+                   _mm_mul_ps(vz, vz)));
+
+    // n x edge points into the triangle for counter clockwise winding
+    __m128 mx = _mm_sub_ps(_mm_mul_ps(ny, ez), _mm_mul_ps(nz, ey));
+    __m128 my = _mm_sub_ps(_mm_mul_ps(nz, ex), _mm_mul_ps(nx, ez));
+    __m128 mz = _mm_sub_ps(_mm_mul_ps(nx, ey), _mm_mul_ps(ny, ex));
+    __m128 side =
+        _mm_add_ps(_mm_add_ps(_mm_mul_ps(mx, sx), _mm_mul_ps(my, sy)),
+                   _mm_mul_ps(mz, sz));
+    inside = _mm_and_ps(inside, _mm_cmpge_ps(side, zero));
+
+    // on to the start of the next edge
+    sx = _mm_sub_ps(sx, ex);
+    sy = _mm_sub_ps(sy, ey);
+    sz = _mm_sub_ps(sz, ez);
+  }
+
+  _mm_store_ps(d2, _mm_or_ps(_mm_and_ps(inside, plane),
+                             _mm_andnot_ps(inside, edgeMin)));
+#else
+  for (int k = 0; k < count; ++k) {
+    Vec3f n(block.normal[0][k], block.normal[1][k], block.normal[2][k]);
+    Vec3f s = p - Vec3f(block.a[0][k], block.a[1][k], block.a[2][k]);
+    float nd = n * s;
+    bool inside = n * n > 0.f;
+    float edgeMin = INF;
+    for (int e = 0; e < 3; ++e) {
+      Vec3f edge(block.edge[e][0][k], block.edge[e][1][k],
+                 block.edge[e][2][k]);
+      float t = std::min(std::max(s * edge * block.invLength2[e][k], 0.f),
+                         1.f);
+      Vec3f v = s - edge * t;
+      edgeMin = std::min(edgeMin, v * v);
+      inside = inside && (n ^ edge) * s >= 0.f;
+      s -= edge;
+    }
+    d2[k] = inside ? nd * nd : edgeMin;
+  }
+#endif
+
+  for (int k = 0; k < count; ++k) {
+    if (d2[k] < distance2) {
+      distance2 = d2[k];
+      triangle = block.first + k;
+    }
+  }
+}
+
+bool TriangleBVH::finishHit(Vec3f const &p, int triangle, Hit &hit) const {
+  if (triangle < 0)
+    return false;
+
+  Triangle const &t = m_tris[triangle];
+  hit.point = closestOnTriangle(p, t.a, t.b, t.c);
+  hit.normal = t.normal;
+  hit.distance2 = (p - hit.point) * (p - hit.point);
+  hit.triangle = t.index;
+  return true;
+}
+
+bool TriangleBVH::closest(Vec3f const &p, float maxDistance, Hit &hit) const {
+  hit.distance2 = maxDistance * maxDistance;
+  hit.triangle = -1;
+  if (m_nodes.empty())
+    return false;
+
+  float best = hit.distance2;
+  int triangle = -1;
+
+  struct Entry {
+    int node;
+    float distance2;
+  };
+  Entry stack[STACK_SIZE];
+  int top = 0;
+  stack[top++] = {0, 0.f};
+
+#if defined(__SSE__)
+  __m128 const px = _mm_set1_ps(p.x());
+  __m128 const py = _mm_set1_ps(p.y());
+  __m128 const pz = _mm_set1_ps(p.z());
+  __m128 const zero = _mm_setzero_ps();
+#endif
+
+  while (top > 0) {
+    Entry entry = stack[--top];
+    if (entry.distance2 >= best)
+      continue;
+    Node const &node = m_nodes[entry.node];
+
+    // squared distance from p to each child box
+    alignas(16) float d2[4];
+#if defined(__SSE__)
+    __m128 dx = _mm_max_ps(
+        _mm_max_ps(_mm_sub_ps(_mm_load_ps(node.min[0]), px),
+                   _mm_sub_ps(px, _mm_load_ps(node.max[0]))),
+        zero);
+    __m128 dy = _mm_max_ps(
+        _mm_max_ps(_mm_sub_ps(_mm_load_ps(node.min[1]), py),
+                   _mm_sub_ps(py, _mm_load_ps(node.max[1]))),
+        zero);
+    __m128 dz = _mm_max_ps(
+        _mm_max_ps(_mm_sub_ps(_mm_load_ps(node.min[2]), pz),
+                   _mm_sub_ps(pz, _mm_load_ps(node.max[2]))),
+        zero);
+    _mm_store_ps(d2, _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx),
+                                           _mm_mul_ps(dy, dy)),
+                                _mm_mul_ps(dz, dz)));
+#else
+    for (int k = 0; k < 4; ++k) {
+      d2[k] = 0.f;
+      for (int a = 0; a < 3; ++a) {
+        float d = std::max(std::max(node.min[a][k] - p[a],
+                                    p[a] - node.max[a][k]),
+                           0.f);
+        d2[k] += d * d;
+      }
+    }
+#endif
+
+    // leaves are tested right away, inner nodes are pushed farthest first
+    // so the nearest is visited next and shrinks the search the most
+    Entry inner[4];
+    int innerCount = 0;
+    for (int k = 0; k < 4; ++k) {
+      if (!(d2[k] < best))
+        continue;
+      if (node.count[k] > 0) {
+        testBlock(p, node.child[k], node.count[k], best, triangle);
+      } else {
+        int j = innerCount++;
+        while (j > 0 && inner[j - 1].distance2 < d2[k]) {
+          inner[j] = inner[j - 1];
+          --j;
+        }
+        inner[j] = {node.child[k], d2[k]};
+      }
+    }
+    for (int j = 0; j < innerCount; ++j)
+      stack[top++] = inner[j];
+  }
+
+  return finishHit(p, triangle, hit);
+}
+
+bool TriangleBVH::overlappingLeaves(Vec3f const &min, Vec3f const &max,
+                                    std::vector<Leaf> &leaves,
+                                    size_t maxLeaves) const {
+  if (m_nodes.empty())
+    return true;
+
+  int stack[STACK_SIZE];
+  int top = 0;
+  stack[top++] = 0;
+
+#if defined(__SSE__)
+  __m128 const minX = _mm_set1_ps(min.x()), maxX = _mm_set1_ps(max.x());
+  __m128 const minY = _mm_set1_ps(min.y()), maxY = _mm_set1_ps(max.y());
+  __m128 const minZ = _mm_set1_ps(min.z()), maxZ = _mm_set1_ps(max.z());
+#endif
+
+  while (top > 0) {
+    Node const &node = m_nodes[stack[--top]];
+
+#if defined(__SSE__)
+    __m128 in = _mm_and_ps(
+        _mm_and_ps(_mm_cmple_ps(_mm_load_ps(node.min[0]), maxX),
+                   _mm_cmpge_ps(_mm_load_ps(node.max[0]), minX)),
+        _mm_and_ps(
+            _mm_and_ps(_mm_cmple_ps(_mm_load_ps(node.min[1]), maxY),
+                       _mm_cmpge_ps(_mm_load_ps(node.max[1]), minY)),
+            _mm_and_ps(_mm_cmple_ps(_mm_load_ps(node.min[2]), maxZ),
+                       _mm_cmpge_ps(_mm_load_ps(node.max[2]), minZ))));
+    int mask = _mm_movemask_ps(in);
+#else
+    int mask = 0;
+    for (int k = 0; k < 4; ++k) {
+      bool in = true;
+      for (int a = 0; a < 3; ++a)
+        in = in && node.min[a][k] <= max[a] && node.max[a][k] >= min[a];
+      mask |= int(in) << k;
+    }
+#endif
+
+    for (int k = 0; k < 4; ++k) {
+      if (!(mask & (1 << k)))
+        continue;
+      if (node.count[k] > 0) {
+        if (leaves.size() >= maxLeaves)
+          return false;
+        Leaf leaf;
+        leaf.min = Vec3f(node.min[0][k], node.min[1][k], node.min[2][k]);
+        leaf.max = Vec3f(node.max[0][k], node.max[1][k], node.max[2][k]);
+        leaf.block = node.child[k];
+        leaf.count = node.count[k];
+        leaves.push_back(leaf);
+      } else {
+        stack[top++] = node.child[k];
+      }
+    }
+  }
+  return true;
+}
+
+bool TriangleBVH::closest(Vec3f const &p, float maxDistance,
+                          Leaf const *leaves, size_t leafCount,
+                          Hit &hit) const {
+  hit.distance2 = maxDistance * maxDistance;
+  hit.triangle = -1;
+
+  float best = hit.distance2;
+  int triangle = -1;
+  for (size_t i = 0; i < leafCount; ++i) {
+    if (boxDistance2(p, leaves[i].min, leaves[i].max) < best)
+      testBlock(p, leaves[i].block, leaves[i].count, best, triangle);
+  }
+  return finishHit(p, triangle, hit);
+}
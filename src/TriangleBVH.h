@@ -0,0 +1,108 @@
+//
+//  TriangleBVH.h
+//
+//	Bounding volume hierarchy over static triangles, answering "closest
+//	triangle within a distance" for points.
+//
+//	Built top down with the surface area heuristic over binned triangle
+//	centroids, then collapsed into a 4-wide tree. Every node keeps the
+//	boxes of its four children as structure of arrays, so one point (or
+//	box) is tested against all four with a few SSE instructions, and leaves
+//	of at most four triangles are stored in their parent. The triangles of
+//	a leaf are kept together as structure of arrays too, and the distance
+//	to all of them is found at once without branching; only the closest
+//	triangle found gets its exact closest point worked out.
+
+#ifndef TRIANGLE_BVH_H
+#define TRIANGLE_BVH_H
+
+#include <cstddef>
+#include <vector>
+
+#include "Mesh.h"
+#include "Vec3f.h"
+
+class TriangleBVH {
+public:
+  struct Hit {
+    Vec3f point;    // on the triangle
+    Vec3f normal;   // of the triangle, by its winding
+    float distance2; // squared, from the query point
+    int triangle;   // in the order given to build()
+  };
+
+  // Up to four triangles and the box around them
+  struct Leaf {
+    Vec3f min, max;
+    int block, count;
+  };
+
+public:
+  TriangleBVH();
+
+  void build(Mesh::Vertices const &verts, Mesh::Triangles const &tris);
+  void clear();
+  bool empty() const { return m_tris.empty(); }
+
+  // Bounds of all triangles
+  Vec3f const &min() const { return m_min; }
+  Vec3f const &max() const { return m_max; }
+
+  // Closest triangle to p nearer than maxDistance, false if there is none
+  bool closest(Vec3f const &p, float maxDistance, Hit &hit) const;
+  // Appends the leaves whose box overlaps [min, max], returns false (and
+  // stops early) once more than maxLeaves were found
+  bool overlappingLeaves(Vec3f const &min, Vec3f const &max,
+                         std::vector<Leaf> &leaves, size_t maxLeaves) const;
+  // closest() restricted to the triangles of the given leaves
+  bool closest(Vec3f const &p, float maxDistance, Leaf const *leaves,
+               size_t leafCount, Hit &hit) const;
+
+  size_t nodeCount() const { return m_nodes.size(); }
+  size_t triangleCount() const { return m_tris.size(); }
+
+private:
+  // Four children, [axis][lane] box bounds. A lane with count > 0 is a leaf
+  // of count triangles in block child, count == 0 an inner node and
+  // child < 0 is empty (its box is inverted so nothing overlaps it)
+  struct alignas(16) Node {
+    float min[3][4];
+    float max[3][4];
+    int child[4];
+    int count[4];
+  };
+
+  // The triangles of one leaf, [axis][lane]. Edges are b - a, c - b and
+  // a - c, unused lanes are zero
+  struct alignas(16) TriangleBlock {
+    float a[3][4];
+    float edge[3][3][4];
+    float invLength2[3][4]; // of every edge, 0 if it has no length
+    float normal[3][4];     // unit length, 0 if degenerate
+    int first;              // in m_tris
+  };
+
+  struct Triangle {
+    Vec3f a, b, c;
+    Vec3f normal;
+    int index;
+  };
+
+  struct BuildNode;
+
+  int collapse(std::vector<BuildNode> const &build, int root);
+  int addBlock(int first, int count);
+  // Lowers distance2 and sets triangle (in m_tris) if a triangle of the
+  // block is nearer than distance2
+  void testBlock(Vec3f const &p, int block, int count, float &distance2,
+                 int &triangle) const;
+  bool finishHit(Vec3f const &p, int triangle, Hit &hit) const;
+
+private:
+  std::vector<Node> m_nodes;
+  std::vector<TriangleBlock> m_blocks;
+  std::vector<Triangle> m_tris;
+  Vec3f m_min, m_max;
+};
+
+#endif // TRIANGLE_BVH_H
@@ -0,0 +1,54 @@
+//
+//  TripleBuffer.h
+//
+//	Hands the newest value from one writer thread to one reader thread
+//	without locks or waiting. Of the three slots the writer owns one (back),
+//	the reader owns one (front) and the third (middle) is the most recently
+//	published one. Publishing and picking up are a single atomic exchange of
+//	the middle slot each, so neither side ever blocks the other; values the
+//	reader was too slow to see are simply skipped.
+
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+
+template <typename T> class TripleBuffer {
+public:
+  TripleBuffer() : m_front(0), m_middle(1), m_back(2) {}
+
+  // Writer side: fill back(), then publish() it
+  T &back() { return m_slots[m_back]; }
+  void publish() {
+    m_back = m_middle.exchange(m_back | FRESH, std::memory_order_acq_rel) &
+             INDEX;
+  }
+
+  // Reader side: update() swaps in the newest published value, if there is
+  // one the reader has not seen, and returns whether it did. hasUpdate()
+  // says whether it would, with front() still the reader's until then.
+  bool hasUpdate() const {
+    return (m_middle.load(std::memory_order_relaxed) & FRESH) != 0;
+  }
+  bool update() {
+    if (!(m_middle.load(std::memory_order_relaxed) & FRESH))
+      return false;
+    m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & INDEX;
+    return true;
+  }
+  T &front() { return m_slots[m_front]; }
+  T const &front() const { return m_slots[m_front]; }
+
+  // Only while neither thread is using the buffer
+  T &slot(int i) { return m_slots[i]; }
+
+private:
+  enum { INDEX = 3, FRESH = 4 };
+
+  T m_slots[3];
+  unsigned m_front;
+  std::atomic<unsigned> m_middle;
+  unsigned m_back;
+};
+
+#endif // TRIPLE_BUFFER_H
@@ -0,0 +1,100 @@
+#include "XPBD.h"
+
+#include <algorithm>
+
+// ======================== CONSTRUCTORS ============================//
+XPBDSolver::XPBDSolver() : m_iterations(10) {}
+// ==========================================================================//
+
+void XPBDSolver::step(ParticleSystem &system, float dt,
+                      SpringColoring const &colors, ThreadPool &pool) {
+  size_t massCount = system.massCount();
+  m_prevPos.resize(massCount);
+  m_lambda.assign(system.springCount(), 0.f);
+
+  Vec3f *pos = system.positions();
+  Vec3f *vel = system.velocities();
+  Vec3f *prev = m_prevPos.data();
+  float const *invMass = system.inverseMasses();
+  Vec3f const gravity = system.gravity();
+  float const damping = system.damping();
+
+  // predict with the external accelerations only
+  pool.parallelFor(massCount, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      prev[i] = pos[i];
+      if (invMass[i] == 0.f)
+        continue;
+
+      vel[i] += (gravity - vel[i] * damping) * dt;
+      pos[i] += vel[i] * dt;
+    }
+  });
+
+  float const invDt2 = 1.f / (dt * dt);
+  for (int it = 0; it < m_iterations; ++it) {
+    for (size_t c = 0; c < colors.batchCount(); ++c) {
+      size_t begin = colors.batchBegin(c);
+      size_t count = colors.batchEnd(c) - begin;
+
+      if (colors.isSerialBatch(c)) {
+        projectSprings(system, invDt2, begin, begin + count);
+        continue;
+      }
+
+      pool.parallelFor(count, [&](size_t b, size_t e) {
+        projectSprings(system, invDt2, begin + b, begin + e);
+      });
+    }
+  }
+
+  float const invDt = 1.f / dt;
+  pool.parallelFor(massCount, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      if (invMass[i] != 0.f)
+        vel[i] = (pos[i] - prev[i]) * invDt;
+    }
+  });
+}
+
+// C = |xb - xa| - rest,  dlambda = (-C - a~ lambda) / (wa + wb + a~)
+// with a~ = compliance / dt^2
+void XPBDSolver::projectSprings(ParticleSystem &system, float invDt2,
+                                size_t begin, size_t end) {
+  ParticleSystem::SpringEnds const *ends = system.springEnds();
+  float const *stiffness = system.stiffnesses();
+  float const *restLength = system.restLengths();
+  float const *invMass = system.inverseMasses();
+  Vec3f *pos = system.positions();
+  float *lambda = m_lambda.data();
+
+  for (size_t s = begin; s < end; ++s) {
+    // no stiffness is no force for the other integrators, so no
+    // constraint, not a rigid one
+    if (stiffness[s] <= 0.f)
+      continue;
+
+    unsigned a = ends[s].a;
+    unsigned b = ends[s].b;
+    float wa = invMass[a];
+    float wb = invMass[b];
+
+    float alpha = invDt2 / stiffness[s];
+    float wSum = wa + wb + alpha;
+    if (wSum <= 0.f)
+      continue;
+
+    Vec3f d = pos[b] - pos[a];
+    float len = d.length();
+    if (len <= 0.f)
+      continue;
+
+    float C = len - restLength[s];
+    float dLambda = (-C - alpha * lambda[s]) / wSum;
+    lambda[s] += dLambda;
+
+    Vec3f correction = d * (dLambda / len);
+    pos[a] -= correction * wa;
+    pos[b] += correction * wb;
+  }
+}
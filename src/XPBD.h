@@ -0,0 +1,49 @@
+//
+//  XPBD.h
+//
+//	Extended position based dynamics solver.
+//
+//	Instead of integrating spring forces, every spring is a distance
+//	constraint |xb - xa| = rest with compliance 1 / stiffness (none for a
+//	spring of stiffness 0, as it has no force either). A step
+//	predicts positions from velocity, gravity and drag, projects the
+//	constraints for a fixed number of iterations and derives the new
+//	velocities from the change in position. It stays stable at large time
+//	steps and costs the same every step.
+//
+//	Constraints are projected color by color (see SpringColoring.h), the
+//	springs of a color in parallel, so the Gauss-Seidel order and therefore
+//	the result does not depend on the thread count.
+
+#ifndef XPBD_H
+#define XPBD_H
+
+#include <vector>
+
+#include "ParticleSystem.h"
+#include "SpringColoring.h"
+#include "ThreadPool.h"
+
+class XPBDSolver {
+public:
+  XPBDSolver();
+
+  void step(ParticleSystem &system, float dt, SpringColoring const &colors,
+            ThreadPool &pool);
+
+  int iterations() const { return m_iterations; }
+  void setIterations(int iterations) { m_iterations = iterations; }
+
+private:
+  void projectSprings(ParticleSystem &system, float invDt2, size_t begin,
+                      size_t end);
+
+private:
+  int m_iterations;
+
+  std::vector<Vec3f> m_prevPos;
+  // accumulated Lagrange multiplier of every spring in this step
+  std::vector<float> m_lambda;
+};
+
+#endif // XPBD_H
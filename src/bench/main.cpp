@@ -0,0 +1,717 @@
+// Entry point of MassSpringBench, micro-benchmarks of the math library and
+// whole simulation steps.
+//
+// Every benchmark is repeated in growing batches until it has run for at
+// least --min-time seconds, then reported as ns per operation. --json FILE
+// also writes the results as JSON ("-" for stdout), so runs can be compared
+// to catch regressions.
+//
+//   MassSpringBench [--filter TEXT] [--min-time SECONDS] [--threads N]
+//                   [--max-masses N] [--json FILE]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Vec3f.h"
+#include "Mat4f.h"
+#include "Quat4f.h"
+#include "HomoVec4f.h"
+#include "OpenGLMatrixTools.h"
+#include "ParticleSystem.h"
+#include "Scenes.h"
+#include "Simulation.h"
+#include "Obstacles.h"
+#include "Picking.h"
+#include "Trajectory.h"
+#include "Checkpoint.h"
+#include "ImageSequence.h"
+#include "FrameProfiler.h"
+#include "SpringKernels.h"
+#include "ThreadPool.h"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+// Keeps the compiler from optimizing a result away
+template <typename T> inline void keep(T const &value) {
+  asm volatile("" : : "g"(&value) : "memory");
+}
+
+struct Result {
+  std::string name;
+  double nsPerOp;
+  unsigned long ops;
+  // cost of one mass for one step, simulation benchmarks only
+  double nsPerParticleStep;
+};
+
+struct BenchOptions {
+  BenchOptions()
+      : minTime(0.2), threads(ThreadPool::hardwareThreads()),
+        maxMasses(1000000) {}
+
+  std::string filter;
+  double minTime;
+  int threads;
+  unsigned long maxMasses;
+  std::string jsonPath;
+};
+
+class Bench {
+public:
+  explicit Bench(BenchOptions const &options) : m_options(options) {}
+
+  bool selected(std::string const &name) const {
+    return m_options.filter.empty() ||
+           name.find(m_options.filter) != std::string::npos;
+  }
+
+  // Runs op(n) (which must do n operations) until minTime has passed
+  template <typename Op> void run(std::string const &name, Op op) {
+    if (!selected(name))
+      return;
+
+    unsigned long batch = 1;
+    unsigned long ops = 0;
+    double seconds = 0;
+    while (seconds < m_options.minTime) {
+      Clock::time_point start = Clock::now();
+      op(batch);
+      seconds += std::chrono::duration<double>(Clock::now() - start).count();
+      ops += batch;
+      if (batch < (1ul << 30))
+        batch *= 2;
+    }
+
+    report(name, seconds * 1e9 / ops, ops, 0);
+  }
+
+  void report(std::string const &name, double nsPerOp, unsigned long ops,
+              double nsPerParticleStep) {
+    Result result = {name, nsPerOp, ops, nsPerParticleStep};
+    m_results.push_back(result);
+
+    cout.width(40);
+    cout << std::left << name << " ";
+    cout.width(14);
+    cout << std::right << nsPerOp << " ns/op";
+    if (nsPerParticleStep > 0)
+      cout << "  " << nsPerParticleStep << " ns/particle-step";
+    cout << endl;
+  }
+
+  void writeJson(std::ostream &out) const {
+    out << "{\n  \"simd\": \"" << simdLevelName(simdLevel()) << "\",\n"
+        << "  \"threads\": " << m_options.threads << ",\n"
+        << "  \"benchmarks\": [";
+    for (size_t i = 0; i < m_results.size(); ++i) {
+      Result const &r = m_results[i];
+      out << (i ? "," : "") << "\n    {\"name\": \"" << r.name
+          << "\", \"ns_per_op\": " << r.nsPerOp << ", \"ops\": " << r.ops;
+      if (r.nsPerParticleStep > 0)
+        out << ", \"ns_per_particle_step\": " << r.nsPerParticleStep;
+      out << "}";
+    }
+    out << "\n  ]\n}" << endl;
+  }
+
+  BenchOptions const &options() const { return m_options; }
+
+private:
+  BenchOptions m_options;
+  std::vector<Result> m_results;
+};
+
+// Deterministic pseudo random floats in [-1, 1)
+std::vector<Vec3f> randomVectors(size_t count) {
+  std::vector<Vec3f> v(count);
+  unsigned seed = 12345;
+  auto next = [&seed] {
+    seed = seed * 1664525u + 1013904223u;
+    return float(seed >> 8) / float(1 << 23) - 1.f;
+  };
+  for (auto &vec : v)
+    vec = Vec3f(next(), next(), next());
+  return v;
+}
+
+void benchVec3f(Bench &bench) {
+  std::vector<Vec3f> const v = randomVectors(1024);
+  size_t const mask = v.size() - 1;
+
+  bench.run("Vec3f/add", [&](unsigned long n) {
+    Vec3f sum;
+    for (unsigned long i = 0; i < n; ++i)
+      sum = sum + v[i & mask];
+    keep(sum);
+  });
+  bench.run("Vec3f/scale", [&](unsigned long n) {
+    Vec3f sum;
+    for (unsigned long i = 0; i < n; ++i)
+      sum += v[i & mask] * 1.0001f;
+    keep(sum);
+  });
+  bench.run("Vec3f/dot", [&](unsigned long n) {
+    float sum = 0;
+    for (unsigned long i = 0; i < n; ++i)
+      sum += v[i & mask] * v[(i + 1) & mask];
+    keep(sum);
+  });
+  bench.run("Vec3f/cross", [&](unsigned long n) {
+    Vec3f sum;
+    for (unsigned long i = 0; i < n; ++i)
+      sum += v[i & mask] ^ v[(i + 1) & mask];
+    keep(sum);
+  });
+  bench.run("Vec3f/length", [&](unsigned long n) {
+    float sum = 0;
+    for (unsigned long i = 0; i < n; ++i)
+      sum += v[i & mask].length();
+    keep(sum);
+  });
+  bench.run("Vec3f/normalized", [&](unsigned long n) {
+    Vec3f sum;
+    for (unsigned long i = 0; i < n; ++i)
+      sum += v[i & mask].normalized();
+    keep(sum);
+  });
+}
+
+void benchMat4f(Bench &bench) {
+  Mat4f const a = PerspectiveProjection(60, 4.f / 3.f, 0.01f, 1000.f);
+  Mat4f const b =
+      LookAtMatrix(Vec3f(0, 0, 50), Vec3f(0, 0, 0), Vec3f(0, 1, 0));
+  std::vector<Vec3f> const v = randomVectors(1024);
+  size_t const mask = v.size() - 1;
+
+  bench.run("Mat4f/multiply", [&](unsigned long n) {
+    for (unsigned long i = 0; i < n; ++i) {
+      Mat4f c = a * b;
+      keep(c);
+    }
+  });
+  bench.run("Mat4f/multiply-chain-PVM", [&](unsigned long n) {
+    Mat4f const m = IdentityMatrix();
+    for (unsigned long i = 0; i < n; ++i) {
+      Mat4f mvp = a * b * m;
+      keep(mvp);
+    }
+  });
+  bench.run("Mat4f/transposed", [&](unsigned long n) {
+    for (unsigned long i = 0; i < n; ++i) {
+      Mat4f t = a.transposed();
+      keep(t);
+    }
+  });
+  bench.run("Mat4f/copy", [&](unsigned long n) {
+    for (unsigned long i = 0; i < n; ++i) {
+      Mat4f c(a);
+      keep(c);
+    }
+  });
+  bench.run("Mat4f/transform-HomoVec4f", [&](unsigned long n) {
+    Vec3f sum;
+    for (unsigned long i = 0; i < n; ++i)
+      sum += (a * HomoVec4f(v[i & mask])).perspectiveDivided();
+    keep(sum);
+  });
+}
+
+void benchQuat4f(Bench &bench) {
+  std::vector<Vec3f> const v = randomVectors(1024);
+  size_t const mask = v.size() - 1;
+
+  bench.run("Quat4f/rotateAround", [&](unsigned long n) {
+    Vec3f sum;
+    for (unsigned long i = 0; i < n; ++i)
+      sum += rotateAround(v[i & mask], v[(i + 1) & mask], 0.3f);
+    keep(sum);
+  });
+  bench.run("Quat4f/slerp", [&](unsigned long n) {
+    Quat4f const q0 = Quat4f(1, 0, 0, 0);
+    Quat4f const q1 = Quat4f(0.7071f, 0, 0.7071f, 0);
+    Quat4f sum;
+    for (unsigned long i = 0; i < n; ++i)
+      sum += slerp(q0, q1, float(i & mask) / mask);
+    keep(sum);
+  });
+}
+
+void benchMatrixTools(Bench &bench) {
+  std::vector<Vec3f> const v = randomVectors(1024);
+  size_t const mask = v.size() - 1;
+
+  bench.run("OpenGLMatrixTools/LookAtMatrix", [&](unsigned long n) {
+    for (unsigned long i = 0; i < n; ++i) {
+      Mat4f view = LookAtMatrix(v[i & mask] * 50.f, Vec3f(0, 0, 0),
+                                Vec3f(0, 1, 0));
+      keep(view);
+    }
+  });
+  bench.run("OpenGLMatrixTools/PerspectiveProjection", [&](unsigned long n) {
+    for (unsigned long i = 0; i < n; ++i) {
+      Mat4f proj = PerspectiveProjection(60.f + (i & 7), 4.f / 3.f, 0.01f,
+                                         1000.f);
+      keep(proj);
+    }
+  });
+}
+
+void benchSimulation(Bench &bench) {
+  unsigned long const sizes[] = {1000, 100000, 1000000};
+  IntegratorType const integrators[] = {
+      IntegratorType::SymplecticEuler, IntegratorType::VelocityVerlet,
+      IntegratorType::BackwardEuler, IntegratorType::XPBD};
+
+  for (unsigned long size : sizes) {
+    if (size > bench.options().maxMasses)
+      continue;
+
+    for (IntegratorType type : integrators) {
+      std::string name = std::string("Simulation/step/") +
+                         integratorName(type) + "/" + std::to_string(size);
+      if (!bench.selected(name))
+        continue;
+
+      // square cloth of about size masses
+      SceneParams params;
+      params.width = params.height = int(std::sqrt(double(size)));
+      ParticleSystem particles;
+      buildCloth(particles, params);
+      Simulation sim(particles, bench.options().threads);
+      sim.setIntegrator(type);
+      sim.step(0.001f); // coloring, adjacency and warm up
+
+      unsigned long steps = 0;
+      double seconds = 0;
+      while (seconds < bench.options().minTime) {
+        Clock::time_point start = Clock::now();
+        sim.step(0.001f);
+        seconds += std::chrono::duration<double>(Clock::now() - start).count();
+        ++steps;
+      }
+
+      double nsPerStep = seconds * 1e9 / steps;
+      bench.report(name, nsPerStep, steps, nsPerStep / particles.massCount());
+    }
+  }
+}
+
+// One 60 Hz frame of the cloth with a stiff rope, each integrator at the
+// largest step the step controller allows it
+void benchMultiRate(Bench &bench) {
+  unsigned long const sizes[] = {1000, 100000};
+  IntegratorType const integrators[] = {IntegratorType::VelocityVerlet,
+                                        IntegratorType::MultiRate};
+  float const FRAME = 1.f / 60.f;
+
+  for (unsigned long size : sizes) {
+    if (size > bench.options().maxMasses)
+      continue;
+
+    for (IntegratorType type : integrators) {
+      std::string name = std::string("Simulation/rope/") +
+                         integratorName(type) + "/" + std::to_string(size);
+      if (!bench.selected(name))
+        continue;
+
+      SceneParams params;
+      params.width = params.height = int(std::sqrt(double(size)));
+      ParticleSystem particles;
+      buildClothRope(particles, params);
+      Simulation sim(particles, bench.options().threads);
+      sim.setIntegrator(type);
+      sim.stepControl().reset(FRAME);
+      float const dt = sim.stepControl().next(particles, type);
+      int const stepsPerFrame = int(std::ceil(FRAME / dt));
+      sim.step(FRAME / stepsPerFrame); // coloring, levels and warm up
+
+      unsigned long frames = 0;
+      double seconds = 0;
+      while (seconds < bench.options().minTime) {
+        Clock::time_point start = Clock::now();
+        for (int i = 0; i < stepsPerFrame; ++i)
+          sim.step(FRAME / stepsPerFrame);
+        seconds += std::chrono::duration<double>(Clock::now() - start).count();
+        ++frames;
+      }
+
+      double nsPerFrame = seconds * 1e9 / frames;
+      bench.report(name, nsPerFrame, frames,
+                   nsPerFrame / stepsPerFrame / particles.massCount());
+    }
+  }
+}
+
+// Every mass resting on a finely tessellated sphere, so each one has a
+// contact to resolve
+void benchObstacles(Bench &bench) {
+  unsigned long const sizes[] = {1000, 100000, 1000000};
+  float const RADIUS = 10.f;
+
+  for (unsigned long size : sizes) {
+    std::string name = "Obstacles/sphere/" + std::to_string(size);
+    if (size > bench.options().maxMasses || !bench.selected(name))
+      continue;
+
+    SceneParams params;
+    params.width = params.height = int(std::sqrt(double(size)));
+    ParticleSystem particles;
+    buildCloth(particles, params);
+    Obstacles obstacles;
+    obstacles.add(makeSphereMesh(Vec3f(), RADIUS, 128, 64));
+    ThreadPool pool(bench.options().threads);
+
+    // the cloth grid wrapped around the upper half of the sphere, inside
+    // the contact thickness
+    float const shell = RADIUS + 0.5f * obstacles.thickness();
+    std::vector<Vec3f> start(particles.massCount());
+    for (int r = 0; r < params.height; ++r) {
+      for (int c = 0; c < params.width; ++c) {
+        float theta = 1.5f * (r + 0.5f) / params.height;
+        float phi = 6.2831853f * c / params.width;
+        start[r * params.width + c] =
+            Vec3f(std::sin(theta) * std::cos(phi), std::cos(theta),
+                  std::sin(theta) * std::sin(phi)) *
+            shell;
+      }
+    }
+
+    unsigned long calls = 0;
+    double seconds = 0;
+    while (seconds < bench.options().minTime) {
+      std::copy(start.begin(), start.end(), particles.positions());
+      Clock::time_point begin = Clock::now();
+      obstacles.apply(particles, 0.001f, pool);
+      seconds += std::chrono::duration<double>(Clock::now() - begin).count();
+      ++calls;
+    }
+
+    double nsPerCall = seconds * 1e9 / calls;
+    bench.report(name, nsPerCall, calls, nsPerCall / particles.massCount());
+  }
+}
+
+// Changing the thread count between jobs, then running one across all of
+// them. Workers started after a job must wait for the next one rather than
+// run the old one again, which a wrong sum would show.
+void benchThreadPool(Bench &bench) {
+  size_t const COUNT = 4096;
+  ThreadPool pool(2);
+  pool.parallelFor(COUNT, [](size_t, size_t) {}, 1);
+
+  bool ok = true;
+  bench.run("ThreadPool/resize+parallelSum", [&](unsigned long n) {
+    for (unsigned long i = 0; i < n; ++i) {
+      pool.resize(2 + int(i % 2));
+      double sum = pool.parallelSum(
+          COUNT, [](size_t begin, size_t end) { return double(end - begin); },
+          1);
+      ok = ok && sum == COUNT;
+    }
+  });
+  if (!ok)
+    cerr << "ThreadPool/resize+parallelSum: wrong sum" << endl;
+}
+
+// One pick among size masses spread through the view
+void benchPicking(Bench &bench) {
+  unsigned long const sizes[] = {1000, 100000, 1000000};
+  Viewport const view = {800.f, 600.f};
+  Mat4f const mvp =
+      PerspectiveProjection(60.f, view.width / view.height, 0.01f, 1000.f) *
+      LookAtMatrix(Vec3f(0.f, 0.f, 3.f), Vec3f(), Vec3f(0.f, 1.f, 0.f));
+  ThreadPool pool(bench.options().threads);
+
+  for (unsigned long size : sizes) {
+    std::string name = "Picking/" + std::to_string(size);
+    if (size > bench.options().maxMasses || !bench.selected(name))
+      continue;
+
+    std::vector<Vec3f> positions = randomVectors(size);
+    bench.run(name, [&](unsigned long n) {
+      for (unsigned long i = 0; i < n; ++i)
+        keep(pickProjected(positions.data(), positions.size(), mvp, view,
+                           400.f + i % 7, 300.f, 20.f, pool));
+    });
+  }
+}
+
+// Writing a recording and playing it back, per frame of size masses on a
+// rolling wave
+void benchTrajectory(Bench &bench) {
+  unsigned long const sizes[] = {1000, 100000};
+  int const FRAMES = 32; // few enough that the writer never drops any
+  char const *const PATH = "bench_trajectory.tmp";
+
+  for (unsigned long size : sizes) {
+    std::string encodeName = "Trajectory/record+write/" + std::to_string(size);
+    std::string decodeName = "Trajectory/read/" + std::to_string(size);
+    if (size > bench.options().maxMasses ||
+        !(bench.selected(encodeName) || bench.selected(decodeName)))
+      continue;
+
+    std::vector<Vec3f> const base = randomVectors(size);
+    std::vector<std::vector<Vec3f>> frames(FRAMES, base);
+    for (int f = 0; f < FRAMES; ++f) {
+      for (size_t i = 0; i < size; ++i)
+        frames[f][i] += Vec3f(0.f, 0.1f * std::sin(0.1f * f + base[i].x()),
+                              0.f);
+    }
+
+    // the stepping thread's share and the writer thread's, to the file
+    // being closed
+    TrajectoryWriter writer;
+    unsigned long written = 0;
+    double seconds = 0;
+    do {
+      Clock::time_point start = Clock::now();
+      if (!writer.open(PATH, size, 0.f))
+        return;
+      for (int f = 0; f < FRAMES; ++f)
+        writer.record(f / 60.0, frames[f].data());
+      writer.close();
+      seconds += std::chrono::duration<double>(Clock::now() - start).count();
+      written += FRAMES;
+    } while (seconds < bench.options().minTime);
+    if (bench.selected(encodeName))
+      bench.report(encodeName, seconds * 1e9 / written, written, 0);
+
+    TrajectoryReader reader;
+    if (!reader.open(PATH))
+      return;
+    std::vector<Vec3f> out(size);
+    bench.run(decodeName, [&](unsigned long n) {
+      for (unsigned long i = 0; i < n; ++i)
+        keep(reader.read(i % FRAMES, out.data()));
+    });
+    reader.close();
+    std::remove(PATH);
+  }
+}
+
+// What a checkpoint holds up the steps for, next to copying its arrays,
+// and restoring one of an implicit cloth
+void benchCheckpoint(Bench &bench) {
+  unsigned long const sizes[] = {1000, 100000, 1000000};
+  char const *const PATH = "bench_checkpoint.tmp";
+
+  for (unsigned long size : sizes) {
+    std::string saveName = "Checkpoint/save/" + std::to_string(size);
+    std::string copyName = "Checkpoint/memcpy/" + std::to_string(size);
+    std::string restoreName = "Checkpoint/restore/" + std::to_string(size);
+    if (size > bench.options().maxMasses ||
+        !(bench.selected(saveName) || bench.selected(copyName) ||
+          bench.selected(restoreName)))
+      continue;
+
+    SceneParams params;
+    params.width = params.height = int(std::sqrt(double(size)));
+    ParticleSystem particles;
+    buildCloth(particles, params);
+    Simulation sim(particles, bench.options().threads);
+    sim.setIntegrator(IntegratorType::BackwardEuler);
+    sim.step(0.001f); // coloring and a warm start
+
+    // the save alone, the file is written before the next one, and the
+    // first one allocates the buffer
+    CheckpointWriter writer;
+    writer.save(PATH, sim);
+    writer.wait();
+    unsigned long saves = 0;
+    double seconds = 0;
+    do {
+      Clock::time_point start = Clock::now();
+      writer.save(PATH, sim);
+      seconds += std::chrono::duration<double>(Clock::now() - start).count();
+      writer.wait();
+      ++saves;
+    } while (seconds < bench.options().minTime);
+    if (bench.selected(saveName))
+      bench.report(saveName, seconds * 1e9 / saves, saves, 0);
+
+    // positions, velocities, forces and the warm start, inverse masses and
+    // the three spring arrays
+    size_t bytes = particles.massCount() * (4 * sizeof(Vec3f) + sizeof(float)) +
+                   particles.springCount() *
+                       (sizeof(ParticleSystem::SpringEnds) + 2 * sizeof(float));
+    std::vector<char> from(bytes, 1), to(bytes);
+    bench.run(copyName, [&](unsigned long n) {
+      for (unsigned long i = 0; i < n; ++i) {
+        std::memcpy(to.data(), from.data(), bytes);
+        keep(to[i % bytes]);
+      }
+    });
+
+    ParticleSystem restored;
+    Simulation restoredSim(restored);
+    bench.run(restoreName, [&](unsigned long n) {
+      for (unsigned long i = 0; i < n; ++i)
+        keep(loadCheckpoint(PATH, restoredSim));
+    });
+    std::remove(PATH);
+  }
+}
+
+// Encoding and writing rendered frames, per frame: a black background with
+// a shaded band across the middle, roughly what the cloth scene reads back
+void benchImageSequence(Bench &bench) {
+  char const *const patterns[] = {"bench_image_%02d.ppm",
+                                  "bench_image_%02d.png"};
+  int const WIDTH = 800, HEIGHT = 600;
+  int const FRAMES = 16;
+
+  std::vector<unsigned char> rgba(size_t(4) * WIDTH * HEIGHT, 0);
+  for (int y = HEIGHT / 4; y < 3 * HEIGHT / 4; ++y) {
+    for (int x = WIDTH / 8; x < 7 * WIDTH / 8; ++x) {
+      unsigned char *p = &rgba[size_t(4) * (WIDTH * y + x)];
+      p[0] = (x * 7 + y * 3) & 0x7f;
+      p[1] = (x ^ y) & 0x3f;
+      p[2] = 0xff - ((x + y) & 0x3f);
+      p[3] = 0xff;
+    }
+  }
+
+  for (char const *pattern : patterns) {
+    ImageFormat format = ImageFormat::PPM;
+    imageFormat(pattern, format);
+    std::string name = std::string("Image/") +
+                       (format == ImageFormat::PNG ? "png/" : "ppm/") +
+                       std::to_string(WIDTH) + "x" + std::to_string(HEIGHT);
+    if (!bench.selected(name))
+      continue;
+
+    // the rendering thread's copy and the writer thread's encoding, to the
+    // last file being written
+    ImageSequenceWriter writer;
+    unsigned long written = 0;
+    double seconds = 0;
+    do {
+      Clock::time_point start = Clock::now();
+      if (!writer.open(pattern, WIDTH, HEIGHT))
+        return;
+      for (int f = 0; f < FRAMES; ++f)
+        writer.write(f, rgba.data());
+      writer.close();
+      seconds += std::chrono::duration<double>(Clock::now() - start).count();
+      written += FRAMES;
+    } while (seconds < bench.options().minTime);
+    bench.report(name, seconds * 1e9 / written, written, 0);
+
+    for (int f = 0; f < FRAMES; ++f) {
+      std::string file;
+      if (imageFileName(pattern, f, file))
+        std::remove(file.c_str());
+    }
+  }
+}
+
+// What instrumenting the viewer's frames costs
+void benchProfiler(Bench &bench) {
+  FrameProfiler profiler;
+  FrameProfiler::Phase phases[5];
+  for (int p = 0; p < 5; ++p)
+    phases[p] = profiler.addPhase("phase" + std::to_string(p));
+
+  bench.run("FrameProfiler/ScopedTimer", [&](unsigned long n) {
+    profiler.beginFrame();
+    for (unsigned long i = 0; i < n; ++i)
+      FrameProfiler::ScopedTimer timer(profiler, phases[i % 5]);
+    profiler.endFrame();
+  });
+  bench.run("FrameProfiler/frame", [&](unsigned long n) {
+    for (unsigned long i = 0; i < n; ++i) {
+      profiler.beginFrame();
+      for (auto phase : phases)
+        FrameProfiler::ScopedTimer timer(profiler, phase);
+      profiler.endFrame();
+    }
+  });
+  bench.run("FrameProfiler/summaryLines", [&](unsigned long n) {
+    for (unsigned long i = 0; i < n; ++i)
+      keep(profiler.summaryLines());
+  });
+}
+
+bool parseArgs(int argc, char **argv, BenchOptions &options) {
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      cerr << "Missing value for " << arg << endl;
+      return false;
+    }
+    std::string value = argv[++i];
+
+    if (arg == "--filter") {
+      options.filter = value;
+    } else if (arg == "--min-time") {
+      options.minTime = std::atof(value.c_str());
+    } else if (arg == "--threads") {
+      options.threads = std::max(1, std::atoi(value.c_str()));
+    } else if (arg == "--max-masses") {
+      options.maxMasses = std::strtoul(value.c_str(), nullptr, 10);
+    } else if (arg == "--json") {
+      options.jsonPath = value;
+    } else {
+      cerr << "Unknown option " << arg << endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  BenchOptions options;
+  if (!parseArgs(argc, argv, options)) {
+    cerr << "Usage: " << argv[0]
+         << " [--filter TEXT] [--min-time SECONDS] [--threads N]"
+            " [--max-masses N] [--json FILE]"
+         << endl;
+    return EXIT_FAILURE;
+  }
+
+  Bench bench(options);
+  cout << "simd: " << simdLevelName(simdLevel())
+       << "  threads: " << options.threads << endl;
+
+  benchVec3f(bench);
+  benchMat4f(bench);
+  benchQuat4f(bench);
+  benchMatrixTools(bench);
+  benchSimulation(bench);
+  benchMultiRate(bench);
+  benchObstacles(bench);
+  benchPicking(bench);
+  benchThreadPool(bench);
+  benchTrajectory(bench);
+  benchCheckpoint(bench);
+  benchImageSequence(bench);
+  benchProfiler(bench);
+
+  if (options.jsonPath == "-") {
+    bench.writeJson(cout);
+  } else if (!options.jsonPath.empty()) {
+    std::ofstream file(options.jsonPath.c_str());
+    if (!file) {
+      cerr << "Could Not Open File " << options.jsonPath << endl;
+      return EXIT_FAILURE;
+    }
+    bench.writeJson(file);
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,24 @@
+// Entry point of MassSpringSimHeadless, the simulation without any
+// GLFW/OpenGL dependency for render-less batch machines.
+//
+// MassSpringSim --headless runs the same driver, but needs the GL libraries
+// installed to start at all.
+
+#include <cstdlib>
+
+#include "CommandLine.h"
+#include "Headless.h"
+
+int main(int argc, char **argv) {
+  SimOptions options;
+  if (!parseCommandLine(argc, argv, options)) {
+    printUsage(std::cerr, argv[0]);
+    return EXIT_FAILURE;
+  }
+  if (options.help) {
+    printUsage(std::cout, argv[0]);
+    return EXIT_SUCCESS;
+  }
+
+  return runHeadless(options);
+}
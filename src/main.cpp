@@ -18,44 +18,132 @@
 #include <cmath>
 #include <chrono>
 #include <limits>
+#include <algorithm>
+#include <memory>
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
 #include "Mesh.h"
 #include "ShaderTools.h"
+#include "StreamingBuffer.h"
+#include "FrameProfiler.h"
+#include "GpuTimer.h"
+#include "TextOverlay.h"
 #include "Vec3f.h"
 #include "Mat4f.h"
 #include "OpenGLMatrixTools.h"
 #include "Camera.h"
-#include "HomoVec4f.h"
+#include "Picking.h"
 #include "Mass.h"
 #include "Spring.h"
+#include "ParticleSystem.h"
+#include "Simulation.h"
+#include "SimClock.h"
+#include "SimulationThread.h"
+#include "Scenes.h"
+#include "SceneFile.h"
+#include "Trajectory.h"
+#include "Checkpoint.h"
+#include "OffscreenContext.h"
+#include "PixelReadback.h"
+#include "ImageSequence.h"
+#include "CommandLine.h"
+#include "Headless.h"
 
 bool g_cursorLocked;
 float g_cursorX, g_cursorY;
+// Ctrl + left button held on a mass, which is pulled towards the cursor
+bool g_dragging = false;
+float g_dragDepth; // of the dragged mass along the view direction
 
 using std::cout;
 using std::endl;
 using std::cerr;
 
 GLuint vaoID;
-GLuint basicProgramID, loadColorProgramID;
+GLuint pointVaoID; // the mass positions as points, to highlight one
+GLuint springVaoID; // the mass positions indexed by spring ends, as lines
+GLuint obstacleVaoID; // static environment the masses collide with
+GLuint basicProgramID, loadColorProgramID, springProgramID, obstacleProgramID;
 
 // Could store these two in an array GLuint[]
 GLuint vertBufferID;
 GLuint triangleIndexBufferID;
+// position of every mass, written straight into mapped GL memory
+StreamingBuffer instanceStream;
+
+// Spring ends and rest lengths only change with the topology (coloring
+// reorders the springs once), so they are uploaded then and not per frame
+GLuint springIndexBufferID;
+GLuint restLengthBufferID, restLengthTextureID;
+unsigned springTopology; // topology the spring buffers hold
+
+GLuint obstacleVertBufferID, obstacleIndexBufferID;
+size_t obstacleIndexCount;
+
+enum class SpringDrawMode { Strain, Plain, Hidden };
+SpringDrawMode springDrawMode = SpringDrawMode::Strain;
+float const STRAIN_COLOR_SCALE = 0.1f; // full red / blue at 10% strain
 
 Mat4f MVP;
 Mat4f M;
 Mat4f V;
 Mat4f P;
 
-Mesh massSpringSys;
-Mass m;
-Spring s;
+Mesh massGlyph; // drawn once per mass
+ParticleSystem particles;
+Simulation simulation(particles);
+SimClock simClock;
+// steps the simulation in real time while the main thread draws
+SimulationThread simThread(simulation, simClock);
+// projects the masses on a pick, started by the first one: runs that never
+// pick (offscreen, or no mouse) should not keep its threads around. The
+// simulation's own pool is busy on the stepping thread.
+std::unique_ptr<ThreadPool> pickPool;
+float const PICK_RADIUS = 20.f; // pixels
+SceneParams sceneParams;
+std::string sceneFile; // loaded instead of a named scene if set
 int sampleID = -1;
 
+// the steps are recorded to recordFile if set
+TrajectoryWriter recorder;
+std::string recordFile;
+float recordFps, recordQuantum;
+// drawn instead of simulating if open, from the scene it was recorded from
+TrajectoryReader player;
+std::vector<Vec3f> playerPositions; // of the frame drawn
+size_t playerFrame;
+double playerTime; // simulated seconds the recording is played to
+
+// F5 saves the simulation to checkpointFile if set, restoreFile is resumed
+// instead of the scene if set
+CheckpointWriter checkpoints;
+std::string checkpointFile;
+std::string restoreFile;
+
+// rendering to image files: the simulation is stepped frame by frame on
+// this thread instead of the simulation thread
+bool g_offscreen = false;
+int const OFFSCREEN_SAMPLES = 4; // as the window asks for
+
+// where the time of every frame goes, shown with p and written at exit
+FrameProfiler profiler;
+FrameProfiler::Phase uploadPhase = profiler.addPhase("upload");
+FrameProfiler::Phase drawPhase = profiler.addPhase("draw");
+FrameProfiler::Phase gpuPhase = profiler.addPhase("gpu"); // a few frames late
+FrameProfiler::Phase swapPhase = profiler.addPhase("swap");
+FrameProfiler::Phase eventsPhase = profiler.addPhase("events");
+GpuTimer gpuTimer; // around displayFunc()
+TextOverlay overlay;
+bool g_showOverlay = false;
+int const OVERLAY_REFRESH_FRAMES = 30; // about twice a second, to be readable
+
+// Each mass is an instance of a MASS_QUAD_SIZE x MASS_QUAD_SIZE grid of
+// vertices
+int const MASS_QUAD_SIZE = 2;
+float const MASS_QUAD_SCALE = 1.f; // 0.075f;
+
 Camera camera;
 int g_moveUpDown = 0;
 int g_moveLeftRight = 0;
@@ -80,19 +168,88 @@ void generateIDs();
 void deleteIDs();
 void setupVAO();
 void loadBuffer();
+bool updatePlayback(double elapsed);
 void reloadProjectionMatrix();
 void loadModelViewMatrix();
 void setupModelViewProjectionTransform();
 void reloadMVPUniform();
 std::string GL_ERROR();
-// Sets up the initial scene of a mass on a spring
-void setUpMassOnSpring();
+// Builds the named scene (see Scenes.h) and loads it to the GPU
+bool setUpScene(std::string const &name);
+// Renders frames into image files without a window
+int runOffscreen(SimOptions const &options);
 int main(int, char **);
 // function declarations
 
+// Whether the simulation steps on simThread, whose snapshots are then
+// written straight into the regions of instanceStream (if persistently
+// mapped), rather than copied there
+bool simulationThreaded() { return !player.isOpen() && !g_offscreen; }
+
+// Uploads the spring ends and rest lengths if the springs changed
+void loadSpringBuffers() {
+  if (springTopology == particles.topologyVersion())
+    return;
+
+  // the element array binding belongs to the bound VAO, so bind the one
+  // that uses it rather than replace the index buffer of whichever is bound
+  glBindVertexArray(springVaoID);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, springIndexBufferID);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+               sizeof(ParticleSystem::SpringEnds) *
+                   particles.springCount(), // two indices per spring
+               particles.springEnds(),      // pointer to the index pairs
+               GL_STATIC_DRAW);             // Usage pattern of GPU buffer
+
+  glBindBuffer(GL_TEXTURE_BUFFER, restLengthBufferID);
+  glBufferData(GL_TEXTURE_BUFFER, sizeof(float) * particles.springCount(),
+               particles.restLengths(), GL_STATIC_DRAW);
+  glBindTexture(GL_TEXTURE_BUFFER, restLengthTextureID);
+  glTexBuffer(GL_TEXTURE_BUFFER, GL_R32F, restLengthBufferID);
+
+  springTopology = particles.topologyVersion();
+}
+
+void displaySprings() {
+  if (springDrawMode == SpringDrawMode::Hidden || particles.springCount() == 0)
+    return;
+
+  loadSpringBuffers();
+
+  glUseProgram(springProgramID);
+  glUniform1i(glGetUniformLocation(springProgramID, "colorByStrain"),
+              springDrawMode == SpringDrawMode::Strain);
+
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_BUFFER, restLengthTextureID);
+
+  glBindVertexArray(springVaoID);
+  glDrawElements(GL_LINES,                             // mode
+                 GLsizei(2 * particles.springCount()), // count
+                 GL_UNSIGNED_INT,                      // type
+                 (void *)0 // element array buffer offset
+                 );
+}
+
+void displayObstacles() {
+  if (obstacleIndexCount == 0)
+    return;
+
+  glUseProgram(obstacleProgramID);
+  glBindVertexArray(obstacleVaoID);
+  glDrawElements(GL_TRIANGLES,               // mode
+                 GLsizei(obstacleIndexCount), // count
+                 GL_UNSIGNED_INT,            // type
+                 (void *)0                   // element array buffer offset
+                 );
+}
+
 void displayFunc() {
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+  displayObstacles();
+  displaySprings();
+
   // Use our shader
   glUseProgram(basicProgramID);
 
@@ -100,39 +257,86 @@ void displayFunc() {
   // and attribute config of buffers
   glBindVertexArray(vaoID);
 
-  glDrawElements(GL_TRIANGLES,               // mode
-                 massSpringSys.indiceCount(), // count
-                 GL_UNSIGNED_INT,            // type
-                 (void *)0                   // element array buffer offset
-                 );
+  glDrawElementsInstanced(GL_TRIANGLES,           // mode
+                          massGlyph.indiceCount(), // count
+                          GL_UNSIGNED_INT,         // type
+                          (void *)0, // element array buffer offset
+                          GLsizei(particles.massCount()) // instances
+                          );
 
   if (sampleID != -1) {
     glUseProgram(loadColorProgramID);
+    glBindVertexArray(pointVaoID);
     glDrawArrays(GL_POINTS, sampleID, 1);
   }
+
+  // the region drawn from is not written again until these draws are done
+  instanceStream.fence();
+}
+
+void displayOverlay() {
+  if (!g_showOverlay)
+    return;
+
+  if (profiler.frameCount() % OVERLAY_REFRESH_FRAMES == 0)
+    overlay.setText(profiler.summaryLines());
+  overlay.draw(FB_WIDTH, FB_HEIGHT);
 }
 
 void generateIDs() {
-  std::string vsSource = loadShaderStringfromFile("./shaders/phong_vs.glsl");
+  std::string vsSource = loadShaderStringfromFile("./shaders/mass_vs.glsl");
   std::string fsSource = loadShaderStringfromFile("./shaders/phong_fs.glsl");
-  std::string gsSource = loadShaderStringfromFile("./shaders/phong_gs.glsl");
-  basicProgramID = CreateShaderProgram(vsSource, gsSource, fsSource);
+  basicProgramID = CreateShaderProgram(vsSource, fsSource);
 
   fsSource = loadShaderStringfromFile("./shaders/basic_fs.glsl");
   vsSource = loadShaderStringfromFile("./shaders/loadColor_vs.glsl");
   loadColorProgramID = CreateShaderProgram(vsSource, fsSource);
 
+  vsSource = loadShaderStringfromFile("./shaders/spring_vs.glsl");
+  std::string gsSource = loadShaderStringfromFile("./shaders/spring_gs.glsl");
+  springProgramID = CreateShaderProgram(vsSource, gsSource, fsSource);
+
+  vsSource = loadShaderStringfromFile("./shaders/phong_vs.glsl");
+  gsSource = loadShaderStringfromFile("./shaders/phong_gs.glsl");
+  fsSource = loadShaderStringfromFile("./shaders/phong_fs.glsl");
+  obstacleProgramID = CreateShaderProgram(vsSource, gsSource, fsSource);
+
   // load IDs given from OpenGL
   glGenVertexArrays(1, &vaoID);
+  glGenVertexArrays(1, &pointVaoID);
+  glGenVertexArrays(1, &springVaoID);
+  glGenVertexArrays(1, &obstacleVaoID);
   glGenBuffers(1, &vertBufferID);
   glGenBuffers(1, &triangleIndexBufferID);
+  instanceStream.allocate(sizeof(Vec3f) * particles.massCount(),
+                          simulationThreaded()
+                              ? int(SimulationThread::BUFFER_COUNT)
+                              : int(StreamingBuffer::REGION_COUNT));
+  glGenBuffers(1, &springIndexBufferID);
+  glGenBuffers(1, &restLengthBufferID);
+  glGenTextures(1, &restLengthTextureID);
+  glGenBuffers(1, &obstacleVertBufferID);
+  glGenBuffers(1, &obstacleIndexBufferID);
+  springTopology = particles.topologyVersion() - 1; // upload on first draw
 }
 
 void deleteIDs() {
   glDeleteProgram(basicProgramID);
   glDeleteVertexArrays(1, &vaoID);
+  glDeleteVertexArrays(1, &pointVaoID);
+  glDeleteVertexArrays(1, &springVaoID);
+  glDeleteVertexArrays(1, &obstacleVaoID);
+  glDeleteProgram(loadColorProgramID);
+  glDeleteProgram(springProgramID);
+  glDeleteProgram(obstacleProgramID);
+  glDeleteBuffers(1, &obstacleVertBufferID);
+  glDeleteBuffers(1, &obstacleIndexBufferID);
+  glDeleteBuffers(1, &springIndexBufferID);
+  glDeleteBuffers(1, &restLengthBufferID);
+  glDeleteTextures(1, &restLengthTextureID);
   glDeleteBuffers(1, &vertBufferID);
   glDeleteBuffers(1, &triangleIndexBufferID);
+  instanceStream.release();
 }
 
 void reloadProjectionMatrix() {
@@ -194,6 +398,25 @@ void reloadMVPUniform() {
                      GL_TRUE,   // transpose matrix, Mat4f is row major
                      MVP.data() // pointer to data in Mat4f
                      );
+
+  id = glGetUniformLocation(springProgramID, "MVP");
+
+  glUseProgram(springProgramID);
+  glUniformMatrix4fv(id,        // ID
+                     1,         // only 1 matrix
+                     GL_TRUE,   // transpose matrix, Mat4f is row major
+                     MVP.data() // pointer to data in Mat4f
+                     );
+
+  // the obstacles are already in world space, M is the identity as for the
+  // masses
+  glUseProgram(obstacleProgramID);
+  glUniformMatrix4fv(glGetUniformLocation(obstacleProgramID, "MVP"), 1,
+                     GL_TRUE, MVP.data());
+  glUniformMatrix4fv(glGetUniformLocation(obstacleProgramID, "V"), 1, GL_TRUE,
+                     V.data());
+  glUniformMatrix4fv(glGetUniformLocation(obstacleProgramID, "M"), 1, GL_TRUE,
+                     M.data());
 }
 
 void setupVAO() {
@@ -220,8 +443,55 @@ void setupVAO() {
                         (void *)Mesh::Vertex::rgbOffset() // array buffer offset
                         );
 
+  // advances once per instance instead of once per vertex
+  glEnableVertexAttribArray(2); // match layout # in shader
+  glVertexAttribDivisor(2, 1);
+
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, triangleIndexBufferID);
 
+  // the same positions read one per vertex, for GL_POINTS
+  glBindVertexArray(pointVaoID);
+  glEnableVertexAttribArray(0); // match layout # in shader
+
+  // and once more as the line ends of every spring
+  glBindVertexArray(springVaoID);
+  glEnableVertexAttribArray(0); // match layout # in shader
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, springIndexBufferID);
+
+  glBindVertexArray(obstacleVaoID);
+  glBindBuffer(GL_ARRAY_BUFFER, obstacleVertBufferID);
+  glEnableVertexAttribArray(0); // match layout # in shader
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Mesh::Vertex),
+                        (void *)Mesh::Vertex::positionOffset());
+  glEnableVertexAttribArray(1); // match layout # in shader
+  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Mesh::Vertex),
+                        (void *)Mesh::Vertex::rgbOffset());
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, obstacleIndexBufferID);
+
+  glBindVertexArray(0); // reset to default
+}
+
+// Points the instance attributes at the streaming region written last
+void bindInstanceRegion() {
+  void *offset = (void *)instanceStream.regionOffset();
+
+  glBindBuffer(GL_ARRAY_BUFFER, instanceStream.id());
+
+  glBindVertexArray(vaoID);
+  glVertexAttribPointer(2,             // attribute layout # above
+                        3,             // # of components (ie XYZ )
+                        GL_FLOAT,      // type of components
+                        GL_FALSE,      // need to be normalized?
+                        sizeof(Vec3f), // stride
+                        offset         // array buffer offset
+                        );
+
+  glBindVertexArray(pointVaoID);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vec3f), offset);
+
+  glBindVertexArray(springVaoID);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vec3f), offset);
+
   glBindVertexArray(0); // reset to default
 }
 
@@ -231,108 +501,139 @@ void setPickingColor() {
   glUniform3f(id, 1, 0, 0);
 }
 
-void loadmassSpringSys(float t) {
-//  float sinHeight = 1;
-//  float cosHeight = 4;
-
-  for (auto &vert : massSpringSys.vertices()) {
-    auto &pos = vert.pos;
-    auto &rgb = vert.rgb;
-  //  float radius = pos.x() * pos.x() + pos.y() * pos.y();
-  //  float r = (radius + t) * 0.05;
+void setSpringUniforms() {
+  glUseProgram(springProgramID);
+  glUniform1i(glGetUniformLocation(springProgramID, "restLengths"), 0);
+  glUniform1f(glGetUniformLocation(springProgramID, "strainScale"),
+              STRAIN_COLOR_SCALE);
+}
 
-//    float z = (sinHeight * std::sin(r) + cosHeight * std::cos(0.5f * r));
-//    float i = (z + 3) / (6); // just to get a changing color...
+Vec3f massQuadOffset(int r, int c) {
+  float x = (c - (MASS_QUAD_SIZE - 1) * 0.5f) * MASS_QUAD_SCALE;
+  float y = (r - (MASS_QUAD_SIZE - 1) * 0.5f) * MASS_QUAD_SCALE;
+  return Vec3f(x, y, 0);
+}
 
-    pos.x(pos.x() + t);
-    pos.y(pos.y() + t);
+// Where every mass is drawn, one position per mass: the newest simulation
+// snapshot, the state offscreen rendering stepped to, or the frame of the
+// recording being played
+Vec3f const *drawnPositions() {
+  if (player.isOpen())
+    return playerPositions.data();
+  return g_offscreen ? particles.positions() : simThread.snapshot().positions;
+}
 
-//    pos.z(z);
-//    rgb.x(i);
-//    rgb.y(1. - i);
+// Points the glyph instances at the drawn positions. A simulation snapshot
+// in a region of the streaming buffer already is drawn from there, any
+// other positions are copied into its next region.
+void loadmassSpringSys() {
+  if (simulationThreaded() && instanceStream.isPersistent()) {
+    instanceStream.select(simThread.snapshot().buffer);
+  } else {
+    Vec3f const *positions = drawnPositions();
+    Vec3f *pos = static_cast<Vec3f *>(instanceStream.beginWrite());
+    if (pos)
+      std::copy(positions, positions + particles.massCount(), pos);
+    instanceStream.endWrite();
   }
+
+  bindInstanceRegion();
 }
 
-void reloadVertexBuffer() {
-  glBindBuffer(GL_ARRAY_BUFFER, vertBufferID);
-  glBufferData(
-      GL_ARRAY_BUFFER,
-      sizeof(Mesh::Vertex) *
-          massSpringSys.vertexCount(), // byte size of Vec3f, 4 of them
-      massSpringSys.vertexData(),      // pointer (Vec3f*) to contents of verts
-      GL_DYNAMIC_DRAW);               // Usage pattern of GPU buffer
+// Picks up the newest simulation snapshot, once the buffer given back for
+// it is not drawn from any more, and returns whether there was one. Never
+// waits for the simulation or the GPU.
+bool updateSnapshot() {
+  if (instanceStream.isPersistent() &&
+      !instanceStream.isIdle(simThread.retiringBuffer()))
+    return false;
+  return simThread.update();
 }
 
 void loadBuffer() {
-  reloadVertexBuffer(); // called every frame
+  // the positions are loaded with loadmassSpringSys(), every new snapshot
+  // or played frame, the glyph is only needed once here
+  glBindBuffer(GL_ARRAY_BUFFER, vertBufferID);
+  glBufferData(
+      GL_ARRAY_BUFFER,
+      sizeof(Mesh::Vertex) * massGlyph.vertexCount(), // byte size of verts
+      massGlyph.vertexData(), // pointer (Vertex*) to contents of verts
+      GL_STATIC_DRAW);        // Usage pattern of GPU buffer
 
-  // but this is only needed once here
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, triangleIndexBufferID);
   glBufferData(
       GL_ELEMENT_ARRAY_BUFFER,
-      sizeof(Mesh::Triangle) *
-          massSpringSys.triangleCount(), // byte size of Vec3f, 4 of them
-      massSpringSys.triangleData(),      // pointer (Vec3f*) to contents of verts
-      GL_STATIC_DRAW);                  // Usage pattern of GPU buffer
+      sizeof(Mesh::Triangle) * massGlyph.triangleCount(), // byte size of tris
+      massGlyph.triangleData(), // pointer (Triangle*) to contents of tris
+      GL_STATIC_DRAW);          // Usage pattern of GPU buffer
+
+  // the obstacles never move
+  Mesh obstacles = simulation.obstacles().mesh();
+  glBindBuffer(GL_ARRAY_BUFFER, obstacleVertBufferID);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(Mesh::Vertex) * obstacles.vertexCount(),
+               obstacles.vertexData(), GL_STATIC_DRAW);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, obstacleIndexBufferID);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+               sizeof(Mesh::Triangle) * obstacles.triangleCount(),
+               obstacles.triangleData(), GL_STATIC_DRAW);
+  obstacleIndexCount = obstacles.indiceCount();
+}
+
+// Moves the recording on by elapsed wall clock seconds while playing, in
+// simulated time, and returns whether there is a new frame to draw
+bool updatePlayback(double elapsed) {
+  if (!g_play || player.frameCount() == 0)
+    return false;
+
+  double end = player.frameTime(player.frameCount() - 1);
+  playerTime = std::min(playerTime + elapsed, end);
+  size_t frame = player.frameAt(playerTime);
+  if (frame == playerFrame)
+    return false;
+
+  playerFrame = frame;
+  return player.read(frame, playerPositions.data());
 }
 
-// Creates triangle and vertex information for each spring and mass
+// Creates the glyph every mass is drawn with, a grid of vertices around
+// the origin in the xy plane
 void initSysMesh() {
   Mesh::Vertices verts;
   Mesh::Triangles tris;
 
-  for (int i = 0; i < m.Masses.size(); i++) {
-    cout << "the index number is " << i << endl;
-    int size = 2;
-    float scale = 1.f; //0.075f;
-
-    // Used to make sin function
-     for (int r = 0; r < size; ++r) {
-       for (int c = 0; c < size; ++c) {
-         // push back Vertex( position, rgb )
-         float x = (c - size * 0.5) * scale;
-         float y = (r - size * 0.5) * scale;
-
-         x = x + m.Masses[i].getPos().x();
-         y = y + m.Masses[i].getPos().y();
-cout << "a vert is being pushed back" << endl;
-         verts.emplace_back(Vec3f(x, y, 0),
-                            Vec3f((r) / float(size), (c) / float(size), 1));
-       }
-     }
-
-    // helper lambda function to get array id from row, column
-    auto id = [size](int r, int c) { return (size)*r + c; };
-
-    // c----d
-    // |\   |
-    // | \  |
-    // |  \ |
-    // |   \|
-    // a----b
-
-    for (int row = 0; row < size - 1; ++row) {
-      for (int col = 0; col < size - 1; ++col) {
-        int a = id(row, col);
-        int b = id(row, col + 1);
-        int c = id(row + 1, col);
-        int d = id(row + 1, col + 1);
-
-        cout << "triangle a is " << a << endl;
-        cout << "triangle b is " << a << endl;
-        cout << "triangle c is " << a << endl;
-        cout << "triangle d is " << a << endl;
-
-
-        tris.emplace_back(a, b, c);
-        tris.emplace_back(c, b, d);
-      }
+  int const size = MASS_QUAD_SIZE;
+
+  for (int r = 0; r < size; ++r) {
+    for (int c = 0; c < size; ++c) {
+      // push back Vertex( position, rgb )
+      verts.emplace_back(massQuadOffset(r, c),
+                         Vec3f((r) / float(size), (c) / float(size), 1));
     }
   }
 
-  massSpringSys = Mesh(verts, tris);
-  printf("Triangle count %zu",massSpringSys.triangleCount());
+  // helper lambda function to get array id from row, column
+  auto id = [size](int r, int c) { return (size)*r + c; };
+
+  // c----d
+  // |\   |
+  // | \  |
+  // |  \ |
+  // |   \|
+  // a----b
+
+  for (int row = 0; row < size - 1; ++row) {
+    for (int col = 0; col < size - 1; ++col) {
+      int a = id(row, col);
+      int b = id(row, col + 1);
+      int c = id(row + 1, col);
+      int d = id(row + 1, col + 1);
+
+      tris.emplace_back(a, b, c);
+      tris.emplace_back(c, b, d);
+    }
+  }
 
+  massGlyph = Mesh(verts, tris);
 }
 
 void init() {
@@ -342,15 +643,14 @@ void init() {
   camera = Camera(Vec3f{0, 0, 50}, Vec3f{0, 0, -1}, Vec3f{0, 1, 0});
 
   // SETUP SHADERS, BUFFERS, VAOs
-cout << "coming into init" << endl;
   initSysMesh();
-  loadmassSpringSys(0);
 
   generateIDs();
   setupVAO();
   loadBuffer();
 
   setPickingColor();
+  setSpringUniforms();
 
   loadModelViewMatrix();
   reloadProjectionMatrix();
@@ -375,35 +675,30 @@ void windowSetFramebufferSizeFunc(GLFWwindow *window, int width, int height) {
   glViewport(0, 0, FB_WIDTH, FB_HEIGHT);
 }
 
-int getClosestProjectedPointTo(int x, int y) {
-  HomoVec4f vHomo;
-  Vec3f v;
-  Mesh::Vertices const &verts = massSpringSys.vertices();
-  float screenX, screenY;
-
-  int foundID = -1;
-  float minDist = std::numeric_limits<float>::max();
-  for (int i = 0; i < verts.size(); ++i) {
-    vHomo = HomoVec4f(verts[i].pos);
-
-    vHomo = MVP * vHomo;
-    v = vHomo.perspectiveDivided(); // Now in NDC
-    if (std::abs(v.x()) <= 1 && std::abs(v.y()) <= 1 && std::abs(v.z()) <= 1) {
-      screenX = FB_WIDTH * (v.x() + 1) * 0.5;
-      screenY = FB_HEIGHT * (1 - v.y()) * 0.5;
-
-      float distSqrd =
-          (x - screenX) * (x - screenX) + (y - screenY) * (y - screenY);
+// The cursor is in window coordinates, which differ from the framebuffer's
+// on high density displays
+Viewport windowViewport(GLFWwindow *window) {
+  int width, height;
+  glfwGetWindowSize(window, &width, &height);
+  Viewport view = {float(std::max(width, 1)), float(std::max(height, 1))};
+  return view;
+}
 
-      if (distSqrd < minDist && distSqrd < 20) // 20 pxl radius
-      {
-        minDist = distSqrd;
-        foundID = i;
-      }
-    }
-  }
+int getClosestProjectedPointTo(GLFWwindow *window, double x, double y) {
+  if (!pickPool)
+    pickPool.reset(new ThreadPool(simulation.threadCount()));
+  // the positions being drawn, the simulation's belong to its thread
+  return pickProjected(drawnPositions(), particles.massCount(), MVP,
+                       windowViewport(window), float(x), float(y),
+                       PICK_RADIUS, *pickPool);
+}
 
-  return foundID;
+// Moves the drag target under the cursor, keeping its distance from the
+// camera
+void updateDragTarget(GLFWwindow *window, double x, double y) {
+  Vec3f target = unprojectAtDepth(camera, WIN_FOV, windowViewport(window),
+                                  float(x), float(y), g_dragDepth);
+  simThread.setDrag(sampleID, target);
 }
 
 void windowMouseButtonFunc(GLFWwindow *window, int button, int action,
@@ -416,19 +711,34 @@ void windowMouseButtonFunc(GLFWwindow *window, int button, int action,
         double x, y;
         glfwGetCursorPos(window, &x, &y);
 
-        int foundID = getClosestProjectedPointTo(x, y);
+        int foundID = getClosestProjectedPointTo(window, x, y);
         if (foundID != -1) {
           sampleID = foundID;
           std::cout << " found " << foundID << std::endl;
         }
+        // held down, the mass follows the cursor, a recording plays as is
+        if (foundID != -1 && !player.isOpen()) {
+          Vec3f const &picked = drawnPositions()[foundID];
+          g_dragDepth =
+              (picked - camera.position()) * camera.forward().normalized();
+          g_dragging = true;
+          updateDragTarget(window, x, y);
+        }
       }
     } else {
       g_cursorLocked = GL_FALSE;
+      if (g_dragging) {
+        g_dragging = false;
+        simThread.setDrag(-1, Vec3f());
+      }
     }
   }
 }
 
 void windowMouseMotionFunc(GLFWwindow *window, double x, double y) {
+  if (g_dragging)
+    updateDragTarget(window, x, y);
+
   if (g_cursorLocked) {
     float deltaX = (x - g_cursorX) * 0.01;
     float deltaY = (y - g_cursorY) * 0.01;
@@ -514,36 +824,152 @@ void windowKeyFunc(GLFWwindow *window, int key, int scancode, int action,
   case GLFW_KEY_SPACE:
     g_play = set ? !g_play : g_play;
     break;
+  case GLFW_KEY_HOME:
+    // back to the first frame of the recording
+    if (action == GLFW_PRESS && player.frameCount() > 0 &&
+        player.read(0, playerPositions.data())) {
+      playerFrame = 0;
+      playerTime = player.frameTime(0);
+      loadmassSpringSys();
+    }
+    break;
+  case GLFW_KEY_F5:
+    if (action == GLFW_PRESS && !checkpointFile.empty() && !player.isOpen())
+      simThread.requestCheckpoint();
+    break;
+  case GLFW_KEY_P:
+    if (action == GLFW_PRESS) {
+      g_showOverlay = !g_showOverlay;
+      overlay.setText(profiler.summaryLines());
+    }
+    break;
+  case GLFW_KEY_L:
+    // strain colored -> plain -> hidden springs
+    if (action == GLFW_PRESS)
+      springDrawMode = SpringDrawMode((int(springDrawMode) + 1) % 3);
+    break;
   case GLFW_KEY_1:
-//    setUpMassOnSpring();
+//    setUpScene("spring");
   default:
     break;
   }
 }
 
-void setUpMassOnSpring() {
-  Mass *massA = new Mass(100.f, Vec3f(0, 20, 0));
-  Mass *massB = new Mass(100.f, Vec3f(0, 0, 0));
-  Spring *spring1 = new Spring(5.f, massA, massB, 20.0f);
-
-  m.Masses.push_back(*massA);
-  m.Masses.push_back(*massB);
-  s.Springs.push_back(*spring1);
+bool setUpScene(std::string const &name) {
+  simThread.stop();
+
+  bool ok;
+  if (!restoreFile.empty())
+    ok = loadCheckpoint(restoreFile, simulation, &simClock);
+  else if (sceneFile.empty())
+    ok = buildScene(name, particles, sceneParams);
+  else
+    ok = loadSceneFile(sceneFile, particles);
+  if (!ok)
+    return false;
+
+  if (player.isOpen()) {
+    // the springs and glyphs come from the scene, the positions from the
+    // recording
+    if (player.massCount() != particles.massCount()) {
+      std::cerr << "The recording has " << player.massCount()
+                << " masses, the scene " << particles.massCount()
+                << std::endl;
+      return false;
+    }
+    playerPositions.resize(player.massCount());
+    playerFrame = 0;
+    playerTime = player.frameCount() > 0 ? player.frameTime(0) : 0.0;
+    if (player.frameCount() > 0 && !player.read(0, playerPositions.data()))
+      return false;
+  } else {
+    if (!recordFile.empty() &&
+        !recorder.open(recordFile, particles.massCount(), recordFps,
+                       recordQuantum))
+      return false;
+    if (g_offscreen) {
+      // what the simulation thread would do on start()
+      simulation.prepare();
+      simulation.stepControl().reset(simClock.stepSize());
+      recorder.record(simulation.time(), particles.positions());
+    }
+  }
 
   init();
+  // the snapshots are written into the streaming buffer init() allocated
+  if (simulationThreaded()) {
+    Vec3f *buffers[SimulationThread::BUFFER_COUNT];
+    for (int b = 0; b < SimulationThread::BUFFER_COUNT; ++b)
+      buffers[b] = static_cast<Vec3f *>(instanceStream.regionData(b));
+    simThread.setSnapshotBuffers(instanceStream.isPersistent() ? buffers
+                                                               : nullptr);
+    simThread.start();
+  }
+  loadmassSpringSys();
+  return true;
 }
 
 
 int main(int argc, char **argv) {
   GLFWwindow *window;
 
+  SimOptions options;
+  if (!parseCommandLine(argc, argv, options)) {
+    printUsage(std::cerr, argv[0]);
+    exit(EXIT_FAILURE);
+  }
+  if (options.help) {
+    printUsage(std::cout, argv[0]);
+    exit(EXIT_SUCCESS);
+  }
+  // no window or GL context needed to run the simulation alone
+  if (options.headless) {
+    return runHeadless(options);
+  }
+
+  std::vector<std::string> const scenes = sceneNames();
+  if (options.sceneFile.empty() &&
+      std::find(scenes.begin(), scenes.end(), options.scene) == scenes.end()) {
+    std::cerr << "Unknown scene " << options.scene << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  sceneParams = options.sceneParams;
+  sceneFile = options.sceneFile;
+  simulation.setThreadCount(options.threads);
+  setSimdLevel(options.simd);
+  simulation.setIntegrator(options.integrator);
+  simulation.implicitSolver().setTolerance(options.cgTolerance);
+  simulation.implicitSolver().setMaxIterations(options.cgIterations);
+  simulation.xpbdSolver().setIterations(options.xpbdIterations);
+  simulation.selfCollision().setRadius(options.collisionRadius);
+  if (!addObstacles(options, simulation.obstacles()))
+    exit(EXIT_FAILURE);
+  simulation.stepControl().setEnabled(options.adaptive);
+  simulation.stepControl().setLimits(options.minDt, options.maxDt);
+  simulation.stepControl().setStrainPerStep(options.strainPerStep);
+  simulation.stepControl().setEnergyTolerance(options.energyTolerance);
+  simClock.setStepSize(options.dt);
+  simClock.setMaxSteps(options.maxSubsteps);
+  recordFile = options.recordFile;
+  recordFps = options.recordFps;
+  recordQuantum = options.recordQuantum;
+  simThread.setRecorder(&recorder);
+  checkpointFile = options.checkpointFile;
+  restoreFile = options.restoreFile;
+  simThread.setCheckpointWriter(&checkpoints, checkpointFile);
+  if (!options.playFile.empty() && !player.open(options.playFile))
+    exit(EXIT_FAILURE);
+  // no window either, the frames go to image files
+  if (!options.offscreenPattern.empty())
+    return runOffscreen(options);
+
   if (!glfwInit()) {
     exit(EXIT_FAILURE);
   }
 
   glfwWindowHint(GLFW_SAMPLES, 4);
   glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3); // instancing, #version 330
   glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
   glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
@@ -560,6 +986,7 @@ int main(int argc, char **argv) {
   glfwSetFramebufferSizeCallback(window, windowSetFramebufferSizeFunc);
   glfwSetInputMode(window, GLFW_STICKY_KEYS, GL_TRUE);
   glfwGetFramebufferSize(window, &WIN_WIDTH, &WIN_HEIGHT);
+  glfwGetFramebufferSize(window, &FB_WIDTH, &FB_HEIGHT);
   glfwSetKeyCallback(window, windowKeyFunc);
   glfwSetCursorPosCallback(window, windowMouseMotionFunc);
   glfwSetMouseButtonCallback(window, windowMouseButtonFunc);
@@ -572,34 +999,191 @@ int main(int argc, char **argv) {
   cout << "GL Version: :" << glGetString(GL_VERSION) << endl;
   cout << GL_ERROR() << endl;
 
-//  init(); // our own initialize stuff func
-  setUpMassOnSpring();
+  gpuTimer.allocate();
+  if (!overlay.allocate())
+    std::cerr << "No frame timing overlay" << std::endl;
+  g_showOverlay = options.overlay;
 
-  float const deltaT = 0.001f;
-  float t = 0;
+//  init(); // our own initialize stuff func
+  if (!setUpScene(options.scene)) {
+    glfwTerminate();
+    exit(EXIT_FAILURE);
+  }
 
+  double lastFrameTime = glfwGetTime();
   while (glfwGetKey(window, GLFW_KEY_ESCAPE) != GLFW_PRESS &&
          !glfwWindowShouldClose(window)) {
+    profiler.beginFrame();
+    double frameTime = glfwGetTime();
+
+    {
+      FrameProfiler::ScopedTimer timer(profiler, uploadPhase);
+      if (player.isOpen()) {
+        if (updatePlayback(frameTime - lastFrameTime))
+          loadmassSpringSys();
+      } else {
+        simThread.setPlaying(g_play);
+        // never waits, the last snapshot is drawn again if there is no new
+        // one
+        if (updateSnapshot())
+          loadmassSpringSys();
+      }
+    }
+    lastFrameTime = frameTime;
+
+    {
+      FrameProfiler::ScopedTimer timer(profiler, drawPhase);
+      gpuTimer.begin();
+      displayFunc();
+      gpuTimer.end();
+      displayOverlay();
+    }
 
-    if (g_play) {
-      t += deltaT;
-      loadmassSpringSys(t);
-      reloadVertexBuffer();
+    {
+      FrameProfiler::ScopedTimer timer(profiler, swapPhase);
+      glfwSwapBuffers(window);
     }
 
-    displayFunc();
-    moveCamera();
+    {
+      FrameProfiler::ScopedTimer timer(profiler, eventsPhase);
+      moveCamera();
+      glfwPollEvents();
+    }
 
-    glfwSwapBuffers(window);
-    glfwPollEvents();
+    double gpuMilliseconds;
+    if (gpuTimer.read(gpuMilliseconds))
+      profiler.record(gpuPhase, gpuMilliseconds);
+    profiler.endFrame();
   }
 
   // clean up after loop
+  simThread.stop();
+  checkpoints.wait();
+  if (recorder.isOpen()) {
+    recorder.close();
+    if (recorder.droppedCount() > 0)
+      std::cerr << "Recording dropped " << recorder.droppedCount()
+                << " frames" << std::endl;
+  }
+  gpuTimer.release();
+  overlay.release();
   deleteIDs();
 
+  if (!options.profileCsv.empty())
+    profiler.writeCsv(options.profileCsv);
+  if (!options.profileJson.empty())
+    profiler.writeJson(options.profileJson);
+
   return 0;
 }
 
+// Moves the simulation on by seconds of simulated time, in steps the size
+// the step controller picks (if on) like the simulation thread does
+void stepOffscreen(double seconds) {
+  simClock.setStepSize(simulation.nextStepSize(simClock.stepSize()));
+  int steps = simClock.advance(seconds);
+  for (int i = 0; i < steps; ++i) {
+    simulation.step(simClock.stepSize());
+    recorder.record(simulation.time(), particles.positions());
+  }
+}
+
+// Every frame moves the scene (or the recording played) on by
+// 1 / offscreenFps simulated seconds, however long it takes to render,
+// and is drawn into the offscreen framebuffer. Its pixels are only read
+// back PixelReadback::RING_SIZE - 1 frames later, while the frames in
+// between are simulated and drawn, and encoded on the image writer's
+// thread.
+int runOffscreen(SimOptions const &options) {
+  typedef std::chrono::steady_clock Clock;
+
+  g_offscreen = true;
+  WIN_WIDTH = FB_WIDTH = options.offscreenWidth;
+  WIN_HEIGHT = FB_HEIGHT = options.offscreenHeight;
+
+  OffscreenContext context;
+  if (!context.create(FB_WIDTH, FB_HEIGHT, OFFSCREEN_SAMPLES))
+    return EXIT_FAILURE;
+  cout << "GL Version: :" << glGetString(GL_VERSION)
+       << "  renderer: " << glGetString(GL_RENDERER) << endl;
+
+  // simulated time is never dropped, however many steps a frame takes
+  simClock.setMaxSteps(std::numeric_limits<int>::max());
+  if (!setUpScene(options.scene))
+    return EXIT_FAILURE;
+  g_play = true;
+
+  PixelReadback readback;
+  readback.allocate(FB_WIDTH, FB_HEIGHT);
+  ImageSequenceWriter writer;
+  if (!writer.open(options.offscreenPattern, FB_WIDTH, FB_HEIGHT))
+    return EXIT_FAILURE;
+
+  // frames come back in the order they were read, numbered by readFrame;
+  // one that cannot be mapped is counted, its file is missing, and the
+  // files after it keep their numbers
+  unsigned long readFrame = 0, dropped = 0;
+  auto writeOldest = [&]() {
+    unsigned char const *pixels = readback.mapOldest();
+    if (pixels)
+      writer.write(readFrame, pixels);
+    else
+      ++dropped;
+    ++readFrame;
+    readback.unmapOldest();
+  };
+
+  double const frameSeconds = 1.0 / options.offscreenFps;
+  double simulateSeconds = 0;
+  Clock::time_point start = Clock::now();
+  for (unsigned long frame = 0; frame < options.offscreenFrames; ++frame) {
+    if (frame > 0) {
+      Clock::time_point simulateStart = Clock::now();
+      if (player.isOpen()) {
+        if (updatePlayback(frameSeconds))
+          loadmassSpringSys();
+      } else {
+        stepOffscreen(frameSeconds);
+        loadmassSpringSys();
+      }
+      simulateSeconds +=
+          std::chrono::duration<double>(Clock::now() - simulateStart).count();
+    }
+
+    context.bindForDrawing();
+    displayFunc();
+    context.bindForReading();
+    if (readback.pendingCount() == PixelReadback::RING_SIZE)
+      writeOldest();
+    readback.read();
+  }
+  while (readback.pendingCount() > 0)
+    writeOldest();
+  bool ok = writer.close();
+  if (dropped > 0) {
+    std::cerr << dropped << " of " << options.offscreenFrames
+              << " frames could not be read back" << std::endl;
+    ok = false;
+  }
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+  unsigned long frames = options.offscreenFrames;
+  cout << "frames: " << frames << "  written: " << writer.frameCount()
+       << "  dropped: " << dropped << "  " << FB_WIDTH << "x" << FB_HEIGHT
+       << "  samples: " << context.samples() << "  files: "
+       << writer.bytesWritten() / 1e6 << " MB" << endl;
+  cout << "wall: " << seconds << " s  frames/s: "
+       << (seconds > 0 ? frames / seconds : 0.0) << "  simulate ms/frame: "
+       << (frames > 0 ? simulateSeconds * 1e3 / frames : 0.0)
+       << "  waited for the writer: " << writer.waitSeconds() << " s" << endl;
+
+  readback.release();
+  deleteIDs();
+  if (recorder.isOpen() && !recorder.close())
+    ok = false;
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
 std::string GL_ERROR() {
   GLenum code = glGetError();
 